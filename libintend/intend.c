@@ -60,6 +60,10 @@
 intend_ctx intend_new_ctx(int argc, char **argv)
 {
     intend_state *state = state_alloc();
+    intend_state *prev;
+
+    state->slab = slab_new();
+    prev = state_enter(state);
 
     symtab_stack_init(state);
 
@@ -73,7 +77,10 @@ intend_ctx intend_new_ctx(int argc, char **argv)
     state->stdin_backup = -1;
     state->stdout_backup = -1;
     state->stderr_backup = -1;
+    // Run scripts on the bytecode engine by default
+    state->engine = ENGINE_VM;
 
+    state_leave(prev);
     return state;
 }
 
@@ -83,9 +90,12 @@ intend_ctx intend_new_ctx(int argc, char **argv)
 void intend_init_ctx(intend_ctx ctx, int argc, char **argv)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     stdlib_init(state, argc, argv);
     module_preload(state);
+
+    state_leave(prev);
 }
 
 /*
@@ -94,15 +104,20 @@ void intend_init_ctx(intend_ctx ctx, int argc, char **argv)
 void intend_free_ctx(intend_ctx ctx)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
+    slab *sl = state->slab;
 
     intend_free_script(ctx);
     parser_teardown(state);
     symtab_stack_teardown(state);
-    eval_free_floats(state);
+    eval_free_args(state);
     module_preload_teardown(state);
     module_teardown(state);
     sandbox_free(state);
+
+    state_leave(prev);
     state_free(state);
+    slab_release(sl);
 }
 
 /*
@@ -111,8 +126,11 @@ void intend_free_ctx(intend_ctx ctx)
 void intend_inhibit_ctx(intend_ctx ctx, const char *name)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     symtab_stack_delete(state, name);
+
+    state_leave(prev);
 }
 
 /*
@@ -247,6 +265,44 @@ int intend_safe_mode_get(intend_ctx ctx)
     return safe_mode_get(state);
 }
 
+/*
+ * Select the evaluation engine used to execute scripts: the
+ * bytecode virtual machine or the tree-walking evaluator
+ */
+void intend_engine_set(intend_ctx ctx, int engine)
+{
+    intend_state *state = ctx;
+
+    sanity(engine == INTEND_ENGINE_TREE || engine == INTEND_ENGINE_VM);
+
+    state->engine = (engine == INTEND_ENGINE_VM) ? ENGINE_VM : ENGINE_TREE;
+}
+
+/*
+ * Get evaluation engine from context
+ */
+int intend_engine_get(intend_ctx ctx)
+{
+    intend_state *state = ctx;
+
+    return (state->engine == ENGINE_VM) ? INTEND_ENGINE_VM : INTEND_ENGINE_TREE;
+}
+
+/*
+ * Get inline cache statistics from context
+ *
+ * Stores the number of call and method lookups answered by the
+ * inline caches and the number of lookups done by name.
+ */
+void intend_cache_stats(intend_ctx ctx, unsigned long *hits,
+                        unsigned long *misses)
+{
+    intend_state *state = ctx;
+
+    if (hits) *hits = state->cache_hits;
+    if (misses) *misses = state->cache_misses;
+}
+
 /*
  * Add a sandbox to context
  */
@@ -401,11 +457,14 @@ void intend_register_source_callback(intend_ctx ctx, intend_source_callback func
 int intend_parse_script_file(intend_ctx ctx, char *path)
 {
     intend_state *state = ctx;
+    intend_state *prev;
     FILE *file;
     int res = 0;
 
     // If path is available and not empty
     if (path && strlen(path) > 0) {
+        prev = state_enter(state);
+
         // If path is sandboxed, use normal source get routine,
         // otherwise open path directly, to allow running scripts
         // not sandboxed by the application while in safe mode.
@@ -417,6 +476,7 @@ int intend_parse_script_file(intend_ctx ctx, char *path)
         if (!file) {
             state->source_line = 0;
             fatal(state, "could not open input source");
+            state_leave(prev);
             return 0;
         }
 
@@ -427,6 +487,7 @@ int intend_parse_script_file(intend_ctx ctx, char *path)
         res = parser_run(state, file);
 
         fclose(file);
+        state_leave(prev);
     }
 
     return res;
@@ -438,6 +499,7 @@ int intend_parse_script_file(intend_ctx ctx, char *path)
 int intend_parse_script_buffer(intend_ctx ctx, char *script)
 {
     intend_state *state = ctx;
+    intend_state *prev;
     int size = strlen(script);
     FILE *file;
     int res;
@@ -453,7 +515,9 @@ int intend_parse_script_buffer(intend_ctx ctx, char *script)
     state->source_line = 1;
     state->source_col  = 0;
 
+    prev = state_enter(state);
     res = parser_run(state, file);
+    state_leave(prev);
 
     fclose(file);
 
@@ -470,8 +534,14 @@ void intend_free_script(intend_ctx ctx)
     sanity(state);
 
     stmt_list *list = state->script;
+    intend_state *prev = state_enter(state);
 
     if (list) stmt_list_free(list);
+    state->script = NULL;
+
+    eval_code_teardown(state);
+
+    state_leave(prev);
 }
 
 /*
@@ -480,6 +550,7 @@ void intend_free_script(intend_ctx ctx)
 int intend_execute_script(intend_ctx ctx)
 {
     intend_state *state = ctx;
+    intend_state *prev;
     stmt_list *list = state->script;
 
     // Return -1 if no parsed script in the context
@@ -494,7 +565,9 @@ int intend_execute_script(intend_ctx ctx)
     state->source_line = 1;
     state->source_col  = 0;
 
-    eval_stmt_list(state, list, 0);
+    prev = state_enter(state);
+    eval_run_list(state, list, 0);
+    state_leave(prev);
 
     return state->exit_value;
 }
@@ -507,8 +580,11 @@ void intend_dump_script(intend_ctx ctx)
     intend_state *state = ctx;
 
     stmt_list *list = state->script;
+    intend_state *prev = state_enter(state);
 
     stmt_list_dump(state, list, 0);
+
+    state_leave(prev);
 }
 
 /*
@@ -521,6 +597,7 @@ intend_value intend_execute_function(intend_ctx ctx, const char *name, ...)
     char *proto;
     symtab_entry *entry;
     va_list ap;
+    intend_state *prev;
     int i, argc = 0;
     value **argv, *res;
 
@@ -546,6 +623,7 @@ intend_value intend_execute_function(intend_ctx ctx, const char *name, ...)
         return NULL;
     }
 
+    prev = state_enter(state);
     va_start(ap, name);
     while (*proto) {
         switch (*proto) {
@@ -582,6 +660,7 @@ intend_value intend_execute_function(intend_ctx ctx, const char *name, ...)
         value_free(argv[i]);
     }
     free(argv);
+    state_leave(prev);
 
     return res;
 }
@@ -592,6 +671,7 @@ intend_value intend_execute_function(intend_ctx ctx, const char *name, ...)
 intend_value intend_call_function_list(intend_ctx ctx, const char *name, int argc, intend_value *argv)
 {
     intend_state *state = ctx;
+    intend_state *prev;
     value *res;
 
     // Save global streams
@@ -600,9 +680,11 @@ intend_value intend_call_function_list(intend_ctx ctx, const char *name, int arg
     // Set global safe mode vars
     safe_mode_vars(state);
 
+    prev = state_enter(state);
     symtab_stack_enter(state);
     res = call_named_function(state, name, argc, (value **)argv);
     symtab_stack_leave(state);
+    state_leave(prev);
 
     return res;
 }
@@ -613,6 +695,7 @@ intend_value intend_call_function_list(intend_ctx ctx, const char *name, int arg
 intend_value intend_call_function(intend_ctx ctx, const char *name, int argc, ...)
 {
     intend_state *state = ctx;
+    intend_state *prev;
     value *res;
     va_list ap;
     value **argv;
@@ -626,9 +709,11 @@ intend_value intend_call_function(intend_ctx ctx, const char *name, int argc, ..
     }
 
     // Call the function
+    prev = state_enter(state);
     symtab_stack_enter(state);
     res = call_named_function(state, name, argc, argv);
     symtab_stack_leave(state);
+    state_leave(prev);
 
     // Free argument list
     free(argv);
@@ -706,6 +791,7 @@ int intend_except_try(intend_ctx ctx)
 intend_value intend_except_catch(intend_ctx ctx)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
     intend_value ex;
 
     ex = (intend_value)except_catch(state);
@@ -713,6 +799,7 @@ intend_value intend_except_catch(intend_ctx ctx)
     if (!ex)
         ex = intend_create_value(INTEND_TYPE_VOID, NULL);
 
+    state_leave(prev);
     return ex;
 }
 
@@ -732,8 +819,11 @@ int intend_value_type(intend_value val)
 void intend_value_dump(intend_ctx ctx, intend_value val, int depth, int skip_flag)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     value_dump(state, (value *)val, depth, skip_flag);
+
+    state_leave(prev);
 }
 
 /*
@@ -873,6 +963,45 @@ int intend_array_count(intend_value val)
     return ARRLEN_OF(in);
 }
 
+/*
+ * Get the element type of array of function argument
+ * or result
+ */
+intend_array_type intend_array_elements(intend_value val)
+{
+    value *in = val;
+
+    switch (ARRKIND_OF(in)) {
+        case ARRAY_KIND_INT:
+            return INTEND_ARRAY_INT;
+        case ARRAY_KIND_FLOAT:
+            return INTEND_ARRAY_FLOAT;
+        default:
+            return INTEND_ARRAY_MIXED;
+    }
+}
+
+/*
+ * Get the raw elements of typed array of function argument
+ * or result
+ * The buffer is shared with all copies of the array and must
+ * not be changed or freed. Returns NULL for arrays that are not
+ * typed, otherwise the size in bytes is stored in size.
+ */
+void *intend_array_data(intend_value val, int *size)
+{
+    value *in = val;
+
+    if (ARRKIND_OF(in) == ARRAY_KIND_VALUE) {
+        return NULL;
+    }
+    if (size) {
+        *size = ARRLEN_OF(in) * (ARRKIND_OF(in) == ARRAY_KIND_INT ?
+                                 sizeof(int) : sizeof(double));
+    }
+    return in->value_u.array_val->data;
+}
+
 /*
  * Get the name of the function pointed by argument or result
  */
@@ -1061,8 +1190,13 @@ intend_value intend_struct_call(intend_ctx ctx, const char *name, const char *me
                                 unsigned int argc, intend_value *argv)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
+    value *res;
+
+    res = value_call_struct_method(state, name, method, argc, (value **)argv);
 
-    return value_call_struct_method(state, name, method, argc, (value **)argv);
+    state_leave(prev);
+    return res;
 }
 
 /*
@@ -1081,8 +1215,13 @@ void intend_free_value(intend_value val)
 intend_value intend_get_variable(intend_ctx ctx, char *name)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
+    value *res;
 
-    return (intend_value)symtab_stack_get_variable(state, name);
+    res = symtab_stack_get_variable(state, name);
+
+    state_leave(prev);
+    return (intend_value)res;
 }
 
 /*
@@ -1091,8 +1230,11 @@ intend_value intend_get_variable(intend_ctx ctx, char *name)
 void intend_set_variable(intend_ctx ctx, char *name, intend_value val)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     symtab_stack_add_variable(state, name, (value *)val);
+
+    state_leave(prev);
 }
 
 /*
@@ -1102,8 +1244,11 @@ void intend_register_class(intend_ctx ctx, char *name, intend_function vector,
                            unsigned int args, char *proto)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     register_class(state, name, vector, args, proto);
+
+    state_leave(prev);
 }
 
 /*
@@ -1114,8 +1259,11 @@ void intend_register_function(intend_ctx ctx, char *name, intend_function vector
 {
     intend_state *state = ctx;
     call_func func = (call_func) vector;
+    intend_state *prev = state_enter(state);
 
     register_function(state, name, func, args, proto, rettype);
+
+    state_leave(prev);
 }
 
 /*
@@ -1124,8 +1272,11 @@ void intend_register_function(intend_ctx ctx, char *name, intend_function vector
 void intend_register_function_data(intend_ctx ctx, intend_function_data *fdata)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     register_function_data(state, (register_func_data *)fdata);
+
+    state_leave(prev);
 }
 
 /*
@@ -1134,8 +1285,11 @@ void intend_register_function_data(intend_ctx ctx, intend_function_data *fdata)
 void intend_register_function_array(intend_ctx ctx, intend_function_data *farray)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     register_function_array(state, (register_func_data *)farray);
+
+    state_leave(prev);
 }
 
 /*
@@ -1144,8 +1298,11 @@ void intend_register_function_array(intend_ctx ctx, intend_function_data *farray
 void intend_register_variable(intend_ctx ctx, char *name, intend_type type, void *value)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     register_variable(state, name, (value_type)type, value);
+
+    state_leave(prev);
 }
 
 /*
@@ -1154,8 +1311,11 @@ void intend_register_variable(intend_ctx ctx, char *name, intend_type type, void
 void intend_register_variable_data(intend_ctx ctx, intend_variable_data *vdata)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     register_variable_data(state, (register_var_data *)vdata);
+
+    state_leave(prev);
 }
 
 /*
@@ -1164,8 +1324,11 @@ void intend_register_variable_data(intend_ctx ctx, intend_variable_data *vdata)
 void intend_register_variable_array(intend_ctx ctx, intend_variable_data *varray)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     register_variable_array(state, (register_var_data *)varray);
+
+    state_leave(prev);
 }
 
 /*
@@ -1174,8 +1337,11 @@ void intend_register_variable_array(intend_ctx ctx, intend_variable_data *varray
 void intend_unregister_symbol(intend_ctx ctx, char *symbol)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     unregister_symbol(state, symbol);
+
+    state_leave(prev);
 }
 
 /*
@@ -1184,8 +1350,11 @@ void intend_unregister_symbol(intend_ctx ctx, char *symbol)
 void intend_unregister_function_array(intend_ctx ctx, intend_function_data *farray)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     unregister_function_array(state, (register_func_data *)farray);
+
+    state_leave(prev);
 }
 
 /*
@@ -1194,8 +1363,11 @@ void intend_unregister_function_array(intend_ctx ctx, intend_function_data *farr
 void intend_unregister_variable_array(intend_ctx ctx, intend_variable_data *varray)
 {
     intend_state *state = ctx;
+    intend_state *prev = state_enter(state);
 
     unregister_variable_array(state, (register_var_data *)varray);
+
+    state_leave(prev);
 }
 
 /*
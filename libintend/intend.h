@@ -64,6 +64,14 @@ void intend_module_add_preload(intend_ctx ctx, char *name);
 void intend_safe_mode_set(intend_ctx ctx, int safe_mode);
 int intend_safe_mode_get(intend_ctx ctx);
 
+#define INTEND_ENGINE_TREE      0
+#define INTEND_ENGINE_VM        1
+
+void intend_engine_set(intend_ctx ctx, int engine);
+int intend_engine_get(intend_ctx ctx);
+
+void intend_cache_stats(intend_ctx ctx, unsigned long *hits, unsigned long *misses);
+
 #define INTEND_SANDBOX_NONE 0
 #define INTEND_SANDBOX_RO   1
 #define INTEND_SANDBOX_RW   2
@@ -134,6 +142,15 @@ typedef enum {
     INTEND_TYPE_RES     = 8
 } intend_type;
 
+/*
+ * Intend array element types
+ */
+typedef enum {
+    INTEND_ARRAY_MIXED  = 0,
+    INTEND_ARRAY_INT    = 1,
+    INTEND_ARRAY_FLOAT  = 2
+} intend_array_type;
+
 /*
  * Intend pointer type for registered functions
  */
@@ -149,6 +166,8 @@ void intend_array_add(intend_value arr, intend_value val);
 intend_value intend_array_get(intend_value val, const int pos);
 void intend_array_set(intend_value arr, const int pos, intend_value val);
 intend_value intend_array_delete(intend_value val, const int pos);
+intend_array_type intend_array_elements(intend_value val);
+void *intend_array_data(intend_value val, int *size);
 
 void intend_resource_value_set(intend_value val, void *data);
 void *intend_resource_value(intend_value val);
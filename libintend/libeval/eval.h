@@ -44,15 +44,109 @@
 #include "../libruntime/runtime.h"
 #include "../libparser/parser.h"
 
+/*
+ * Number of argument slots in a chunk of the argument stack
+ */
+#define ARG_CHUNK_SIZE  1024
+
+/*
+ * Number of reference arguments of a call kept without allocation
+ */
+#define REF_LOCAL       4
+
+/*
+ * Reference argument of a call in progress
+ */
+typedef struct {
+    unsigned int    arg;        /* argument position */
+    int             len;        /* length of reference expression */
+    int             bound;      /* storage bound to the call */
+} call_ref;
+
+/*
+ * Reference arguments of a call in progress
+ *
+ * Arguments passed by reference are stored back after the call,
+ * longest reference first. Arrays and structs stay bound to the
+ * storage they were read from while the call runs, see
+ * bind_call_args().
+ */
+typedef struct {
+    unsigned int    count;      /* number of reference arguments */
+    call_ref        *list;      /* reference arguments in store order */
+    call_ref        local[REF_LOCAL];
+} call_refs;
+
+/*
+ * Assignment target under update
+ *
+ * Filled by eval_lvalue() and completed by eval_lvalue_store().
+ * Typed arrays store raw numbers, so an element of one is loaded
+ * into elem for the update and written back to its array at the
+ * end. Nothing is evaluated in between.
+ */
+typedef struct {
+    value           *root;      /* outer array to store locally, or NULL */
+    value           *array;     /* typed array of elem, or NULL */
+    int             pos;        /* position of elem in its array */
+    value           elem;       /* element of typed array under update */
+} lvalue;
+
+/*
+ * Number of distinct return checks of a chain of tail calls
+ */
+#define TAIL_CHECKS     4
+
+/*
+ * Return check of a function left by a tail call
+ */
+typedef struct {
+    char            *name;      /* function name */
+    char            rettype;    /* return type character */
+    unsigned char   retcheck;   /* compiled return type check */
+} tail_check;
+
+/*
+ * Tail call of a running user-defined function
+ *
+ * A return statement that returns the result of a call to another
+ * user-defined function leaves the call pending here instead of
+ * making it. The running function then makes the call in its own
+ * local symbol table once its body has unwound, see run_func().
+ */
+typedef struct {
+    int             depth;      /* local table depth of the function */
+    int             pending;    /* call left by a return statement */
+    tail_check      ret;        /* return check of the called function */
+    char            **names;    /* parameter names of the called function */
+    stmt            *body;      /* body of the called function */
+    unsigned int    args;       /* parameters of the called function */
+    unsigned int    argc;       /* number of arguments */
+    unsigned int    size;       /* allocated argument slots */
+    value           **argv;     /* arguments, owned by the tail call */
+    unsigned int    kept;       /* arguments of the call made in place */
+    unsigned int    keep_size;
+    value           **keep;
+    unsigned int    nchecks;    /* return checks of left functions */
+    tail_check      checks[TAIL_CHECKS];
+} tail_call;
+
 /*
  * Helper functions
  */
-void eval_free_floats(intend_state *s);
+void eval_free_args(intend_state *s);
 void eval_call_args(intend_state *s, unsigned int argc, expr **args,
                     value ***argv);
 void free_call_args(intend_state *s, unsigned int argc, value ***argv);
-void update_call_args(intend_state *s, signature *sig, unsigned int argc,
-                      expr **args);
+void bind_call_args(intend_state *s, signature *sig, unsigned int argc,
+                    expr **args, value **argv, call_refs *refs);
+void update_call_args(intend_state *s, signature *sig, expr **args,
+                      value **argv, call_refs *refs, symtab *sym);
+signature *eval_call_lookup(intend_state *s, expr *ex);
+value *eval_call_values(intend_state *s, expr *ex, signature *sig,
+                        value **argv);
+int eval_tail_values(intend_state *s, expr *ex, signature *sig,
+                     value **argv);
 
 /*
  * Simple expressions
@@ -62,6 +156,13 @@ value *eval_const_bool(expr *ex);
 value *eval_const_int(expr *ex);
 value *eval_const_float(expr *ex);
 value *eval_const_string(intend_state *s, expr *ex);
+value *eval_expr_borrow(intend_state *s, expr *ex);
+void eval_release(expr *ex, value *val);
+value *eval_expr_cell(intend_state *s, expr *ex, value *cell);
+void eval_release_cell(expr *ex, value *val);
+value *eval_box(expr *ex, value *val);
+void eval_cast_borrowed(intend_state *s, expr *ex, value **val,
+                        value_type type);
 value *eval_cast(intend_state *s, expr *ex);
 value *eval_assign(intend_state *s, expr *ex);
 value *eval_assign_array(intend_state *s, expr *ex);
@@ -69,6 +170,7 @@ value *eval_ref(intend_state *s, expr *ex);
 value *eval_ref_array(intend_state *s, expr *ex);
 value *eval_ref_index(intend_state *s, expr *ex);
 value *eval_call(intend_state *s, expr *ex);
+value *eval_tail_call(intend_state *s, expr *ex);
 value *eval_new(intend_state *s, expr *ex);
 value *eval_static(intend_state *s, expr *ex);
 value *eval_method(intend_state *s, expr *ex);
@@ -78,8 +180,48 @@ value *eval_postfix(intend_state *s, expr *ex);
 value *eval_infix(intend_state *s, expr *ex);
 value *eval_lambda(intend_state *s, expr *ex);
 
-void eval_assign_array_direct(intend_state *s, const char *name,
-                              int argc, expr **index, value *val);
+void eval_assign_array_direct(intend_state *s, expr *ex, value *val);
+value *eval_lvalue(intend_state *s, expr *ex, lvalue *lv);
+void eval_lvalue_store(intend_state *s, expr *ex, value *target, lvalue *lv);
+int eval_assign_inplace(expr *ex);
+int eval_is_pure(expr *ex);
+int eval_prefix_inplace(expr *ex);
+int eval_postfix_inplace(expr *ex);
+
+/*
+ * Expressions evaluated to pre-allocated values
+ */
+void eval_assign_to(intend_state *s, expr *ex, value *res);
+void eval_assign_operand(intend_state *s, expr *ex, value *two, value *res);
+void eval_ref_to(intend_state *s, expr *ex, value *res);
+void eval_prefix_to(intend_state *s, expr *ex, value *res);
+void eval_postfix_to(intend_state *s, expr *ex, value *res);
+void eval_infix_to(intend_state *s, expr *ex, value *res);
+
+/*
+ * Local variable resolution
+ */
+symtab_frame *eval_frame(stmt *body, char **names, unsigned int args);
+symtab_entry *eval_lookup(intend_state *s, expr *ex);
+void eval_store(intend_state *s, expr *ex, value *val);
+
+/*
+ * Inline caches
+ */
+symtab_entry *eval_cache_call(intend_state *s, expr *ex);
+symtab_entry *eval_cache_method(intend_state *s, expr *ex, symtab *table);
+symtab_entry *eval_cache_field(intend_state *s, expr *ex, symtab *table,
+                               const char *name);
+
+/*
+ * Operators applied to evaluated operands
+ */
+void eval_assign_value(intend_state *s, expr *ex, value *val);
+value *eval_cast_value(intend_state *s, expr *ex, value *val);
+value *eval_prefix_value(intend_state *s, expr *ex, value *val);
+value *eval_postfix_value(intend_state *s, expr *ex, value *val);
+value *eval_infix_values(intend_state *s, expr *ex, value *one, value *two);
+int eval_infix_scalar(expr *ex, value *one, value *two, value *res);
 
 /*
  * Math evaluation
@@ -110,6 +252,7 @@ value *eval_bit_rshift(intend_state *s, value *a, value *b);
 /*
  * Order evaluation
  */
+int eval_order_is_equal(value *a, value *b);
 value *eval_order_equal(value *a, value *b);
 value *eval_order_not_equal(value *a, value *b);
 value *eval_order_seq(value *a, value *b);
@@ -126,6 +269,7 @@ value *eval_string_plus(intend_state *s, value *a, value *b);
  * Top-level expression evaluation
  */
 value *eval_expr(intend_state *s, expr *ex);
+void eval_expr_to(intend_state *s, expr *ex, value *res);
 
 /*
  * Statement evaluation
@@ -134,4 +278,90 @@ void eval_stmt(intend_state *s, stmt *st, int cookie);
 void eval_stmt_switch(intend_state *s, stmt *st, int cookie);
 void eval_stmt_list(intend_state *s, stmt_list *list, int cookie);
 
+/*
+ * Evaluation engines
+ */
+#define ENGINE_TREE     0
+#define ENGINE_VM       1
+
+/*
+ * Bytecode operations
+ */
+typedef enum {
+    VM_HALT         = 0,
+    VM_POP          = 1,
+    VM_VOID         = 2,
+    VM_CONST        = 3,
+    VM_REF          = 4,
+    VM_EVAL         = 5,
+    VM_STMT         = 6,
+    VM_ASSIGN       = 7,
+    VM_ASSIGN_ARRAY = 8,
+    VM_INFIX        = 9,
+    VM_PREFIX       = 10,
+    VM_POSTFIX      = 11,
+    VM_CAST         = 12,
+    VM_BOOL         = 13,
+    VM_AND          = 14,
+    VM_OR           = 15,
+    VM_CALL_CHECK   = 16,
+    VM_CALL         = 17,
+    VM_JUMP         = 18,
+    VM_JUMP_FALSE   = 19,
+    VM_JUMP_TRUE    = 20,
+    VM_CASE         = 21,
+    VM_LOOP_ENTER   = 22,
+    VM_LOOP_LEAVE   = 23,
+    VM_BREAK        = 24,
+    VM_CONTINUE     = 25,
+    VM_RETURN_CHECK = 26,
+    VM_RETURN       = 27,
+    VM_THROW        = 28,
+    VM_TRY          = 29,
+    VM_CATCH        = 30,
+    VM_INFIX_CONST  = 31,
+    VM_CASE_CONST   = 32,
+    VM_UPDATE       = 33,
+    VM_TAIL_CALL    = 34
+} vm_op;
+
+/*
+ * Bytecode instruction
+ */
+typedef struct {
+    vm_op           op;
+    int             arg;        /* jump target or argument count */
+    int             alt;        /* continue target of loops */
+    int             line;       /* source line of leaf operations */
+    char            *file;      /* source file of leaf operations */
+    void            *ptr;       /* expression, statement or constant */
+} vm_instr;
+
+/*
+ * Compiled bytecode unit
+ */
+typedef struct vm_code {
+    unsigned int    len;
+    unsigned int    size;
+    vm_instr        *instr;
+    int             stack;      /* maximum value stack depth */
+    int             blocks;     /* maximum loop and try block nesting */
+    struct vm_code  *next;      /* next unit compiled in this state */
+} vm_code;
+
+/*
+ * Bytecode compilation
+ */
+vm_code *eval_compile_stmt(intend_state *s, stmt *st);
+vm_code *eval_compile_list(intend_state *s, stmt_list *list);
+void eval_code_free(vm_code *code);
+void eval_code_teardown(intend_state *s);
+
+/*
+ * Bytecode execution
+ */
+void eval_code_run(intend_state *s, vm_code *code, int cookie);
+void eval_run_stmt(intend_state *s, stmt *st, int cookie);
+void eval_run_list(intend_state *s, stmt_list *list, int cookie);
+
 #endif
@@ -38,166 +38,524 @@
 #include "eval.h"
 
 /*
- * Evaluate variable assignment
+ * Store variable named by expression
+ *
+ * Names resolved to a frame slot skip the hashing of the local
+ * symbol table.
  */
-value *eval_assign(intend_state *s, expr *ex)
+void eval_store(intend_state *s, expr *ex, value *val)
 {
-    value *val;
+    sanity(ex && ex->name && val);
 
-    sanity(ex && ex->name);
+    if (ex->frame) {
+        symtab_stack_add_variable_slot(s, ex->frame, ex->slot, ex->name, val);
+    } else {
+        symtab_stack_add_variable(s, ex->name, val);
+    }
+}
 
-    val = eval_expr(s, ex->inner);
+/*
+ * Store evaluated value of variable assignment
+ */
+void eval_assign_value(intend_state *s, expr *ex, value *val)
+{
+    sanity(ex && ex->name && val);
 
     if (!s->except_flag && !s->exit_flag) {
         if (val->type != VALUE_TYPE_FN) {
-            symtab_stack_add_variable(s, ex->name, val);
+            eval_store(s, ex, val);
         } else {
             symtab_stack_add_function(s, ex->name, FNSIG_OF(val));
         }
     }
-    return val;
 }
 
 /*
- * Set value in nested array
+ * Number of element indices resolved without allocation
+ */
+#define INDEX_LOCAL 8
+
+/*
+ * Check expression for side effects
+ *
+ * Expressions that only read variables and constants can be
+ * evaluated after the target of a combined assignment has been
+ * resolved without changing the outcome.
+ */
+int eval_is_pure(expr *ex)
+{
+    unsigned int i;
+
+    if (ex->cval) {
+        return 1;
+    }
+
+    switch (ex->type) {
+        case EXPR_REF:
+            return 1;
+        case EXPR_REF_ARRAY:
+            for (i = 0; i < ex->argc; i++) {
+                if (!eval_is_pure(ex->argv[i])) {
+                    return 0;
+                }
+            }
+            return 1;
+        case EXPR_INFIX:
+            return eval_is_pure(ex->inner) && eval_is_pure(ex->index);
+        case EXPR_PREFIX:
+            return (ex->op == OPTYPE_MINUS || ex->op == OPTYPE_NOT ||
+                    ex->op == OPTYPE_NEG) && eval_is_pure(ex->inner);
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Evaluate indices of element reference
+ *
+ * All indices are evaluated before any container is touched, so
+ * code run by them cannot move the storage that is walked. The
+ * values must be given back with release_indices().
  */
-value *array_set(intend_state *s, value *arr, int argc, expr **index,
-                 value *val)
+static int eval_indices(intend_state *s, int argc, expr **index, value **pos)
 {
-    value *pos, *elem;
-    int realpos = 0, is_struct, is_inner_struct;
-    char *realidx = NULL;
+    int i;
 
-    sanity(arr && index && *index && val);
+    for (i = 0; i < argc; i++) {
+        pos[i] = eval_expr_borrow(s, index[i]);
+        if (s->except_flag || s->exit_flag) {
+            while (i >= 0) {
+                eval_release(index[i], pos[i]);
+                --i;
+            }
+            return 0;
+        }
+        if (index[i]->type != EXPR_FIELD &&
+                TYPE_OF(pos[i]) != VALUE_TYPE_STRING) {
+            eval_cast_borrowed(s, index[i], &pos[i], VALUE_TYPE_INT);
+        }
+    }
+    return 1;
+}
 
-    is_struct = (index[0]->type == EXPR_FIELD);
-    is_inner_struct = (argc > 1 && index[1]->type == EXPR_FIELD);
+/*
+ * Release indices from eval_indices()
+ */
+static void release_indices(int argc, expr **index, value **pos)
+{
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        eval_release(index[i], pos[i]);
+    }
+}
 
-    pos = eval_expr(s, index[0]);
+/*
+ * Get struct field for update
+ *
+ * Like value_ref_struct(), with the lookup of existing fields
+ * cached in the field expression. The struct is detached first,
+ * a copy has the shape and thus the slots of its original.
+ */
+static value *field_ref(intend_state *s, value *st, expr *index,
+                        const char *name)
+{
+    symtab_entry *entry;
+    symtab *sym = STRUCT_OF(st);
 
-    if (s->except_flag || s->exit_flag) {
-        value_free(pos);
-        return value_make_void();
+    entry = eval_cache_field(s, index, sym, name);
+    if (!entry || entry->type != SYMTAB_ENTRY_VAR) {
+        return value_ref_struct(st, name);
     }
 
-    if (is_struct) {
-        realidx = STR_OF(pos);
-    } else {
-        if (TYPE_OF(pos) == VALUE_TYPE_STRING) {
-            realidx = STR_OF(pos);
-        } else {
-            value_cast_inplace(s, &pos, VALUE_TYPE_INT);
-            realpos = INT_OF(pos);
-        }
+    value_detach(st);
+    if (STRUCT_OF(st) != sym) {
+        entry = eval_cache_field(s, index, STRUCT_OF(st), name);
     }
+    return &entry->entry_u.var;
+}
 
-    if (argc > 1) {
-        if (is_struct) {
-            elem = value_get_struct(arr, realidx);
+/*
+ * Get element of typed array for update
+ *
+ * Returns the element loaded for update into the target, see lvalue.
+ */
+static value *typed_ref(value *arr, int pos, lvalue *lv)
+{
+    value_move_to(&lv->elem, value_get_array(arr, pos));
+    lv->array = arr;
+    lv->pos = pos;
+    return &lv->elem;
+}
+
+/*
+ * Get element in nested array for update
+ *
+ * Walks the evaluated indices down from the given container and
+ * returns the storage of the final element. Missing elements are
+ * created, and elements that are indexed further are replaced by
+ * an empty array or struct if they are not one already. A final
+ * element of a typed array is only loaded for update.
+ */
+static value *array_ref(intend_state *s, value *arr, int argc, expr **index,
+                        value **pos, lvalue *lv)
+{
+    value *elem, *fresh;
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        if (index[i]->type == EXPR_FIELD) {
+            elem = field_ref(s, arr, index[i], STR_OF(pos[i]));
+        } else if (TYPE_OF(pos[i]) == VALUE_TYPE_STRING) {
+            elem = value_ref_key_array(arr, STR_OF(pos[i]));
+        } else if (i + 1 == argc && ARRKIND_OF(arr) != ARRAY_KIND_VALUE) {
+            elem = typed_ref(arr, INT_OF(pos[i]), lv);
         } else {
-            if (realidx) {
-                elem = value_get_key_array(arr, realidx);
-            } else {
-                elem = value_get_array(arr, realpos);
-            }
+            elem = value_ref_array(arr, INT_OF(pos[i]));
         }
-        if (is_inner_struct) {
-            if (elem->type != VALUE_TYPE_STRUCT) {
-                value_free(elem);
-                elem = value_make_struct();
-            }
-        } else {
-            if (elem->type != VALUE_TYPE_ARRAY) {
-                value_free(elem);
-                elem = value_make_array();
+        if (i + 1 < argc) {
+            fresh = NULL;
+            if (index[i + 1]->type == EXPR_FIELD) {
+                if (elem->type != VALUE_TYPE_STRUCT) {
+                    fresh = value_make_struct();
+                }
+            } else if (elem->type != VALUE_TYPE_ARRAY) {
+                fresh = value_make_array();
             }
-        }
-        elem = array_set(s, elem, argc - 1, index + 1, val);
-        if (is_struct) {
-            value_set_struct(arr, realidx, elem);
-        } else {
-            if (realidx) {
-                value_set_key_array(arr, realidx, elem);
-            } else {
-                value_set_array(arr, realpos, elem);
+            if (fresh) {
+                value_copy_to(elem, fresh);
+                value_free(fresh);
             }
         }
-        value_free(elem);
-        value_free(pos);
-        return arr;
+        arr = elem;
+    }
+    return arr;
+}
+
+/*
+ * Look up variable in the table assignments go to
+ */
+static symtab_entry *lookup_top(intend_state *s, expr *ex)
+{
+    return symtab_stack_lookup_top_slot(s, ex->frame, ex->slot, ex->name);
+}
+
+/*
+ * Get array variable for element update
+ *
+ * An array that is only found in an outer symbol table is updated
+ * there and must also be stored locally afterwards, which is
+ * signalled through root.
+ */
+static value *container_ref(intend_state *s, expr *ex, value **root)
+{
+    symtab_entry *entry;
+    value_type type;
+    value *fresh;
+
+    if (ex->argv[0]->type == EXPR_FIELD) {
+        type = VALUE_TYPE_STRUCT;
     } else {
-        if (is_struct) {
-            value_set_struct(arr, realidx, val);
+        type = VALUE_TYPE_ARRAY;
+    }
+
+    *root = NULL;
+
+    entry = lookup_top(s, ex);
+    if (entry && entry->type == SYMTAB_ENTRY_VAR &&
+            entry->entry_u.var.type == type) {
+        return &entry->entry_u.var;
+    }
+
+    entry = eval_lookup(s, ex);
+    if (entry && entry->type == SYMTAB_ENTRY_VAR &&
+            entry->entry_u.var.type == type) {
+        *root = &entry->entry_u.var;
+        return *root;
+    }
+
+    if (type == VALUE_TYPE_STRUCT) {
+        fresh = value_make_struct();
+    } else {
+        fresh = value_make_array();
+    }
+    eval_store(s, ex, fresh);
+    value_free(fresh);
+
+    entry = lookup_top(s, ex);
+    sanity(entry && entry->type == SYMTAB_ENTRY_VAR);
+    return &entry->entry_u.var;
+}
+
+/*
+ * Resolve array element for update
+ *
+ * If a function is given, it is set as method of the struct that
+ * holds the element instead, and that struct is returned.
+ */
+static value *element_lvalue(intend_state *s, expr *ex, lvalue *lv,
+                             value *fn)
+{
+    value *local[INDEX_LOCAL], **pos, *arr, *res;
+    int last;
+
+    last = ex->argc - 1;
+
+    if (ex->argc <= INDEX_LOCAL) {
+        pos = local;
+    } else {
+        pos = oom(malloc(ex->argc * sizeof(value *)));
+    }
+
+    res = NULL;
+    if (eval_indices(s, ex->argc, ex->argv, pos)) {
+        arr = container_ref(s, ex, &lv->root);
+        if (fn) {
+            res = array_ref(s, arr, last, ex->argv, pos, lv);
+            value_set_struct(res, STR_OF(pos[last]), fn);
         } else {
-            if (realidx) {
-                value_set_key_array(arr, realidx, val);
-            } else {
-                value_set_array(arr, realpos, val);
-            }
+            res = array_ref(s, arr, ex->argc, ex->argv, pos, lv);
         }
-        value_free(pos);
-        return arr;
+        release_indices(ex->argc, ex->argv, pos);
+    }
+
+    if (pos != local) {
+        free(pos);
     }
+    return res;
 }
 
 /*
- * Direct array assignment
+ * Resolve assignment target
  *
- * This function can be used by other evaluation functions to
- * make updates to array elements.
+ * Returns the storage of the variable or array element named by
+ * a reference or assignment expression, so that it can be updated
+ * in place. Index expressions are evaluated exactly once.
+ *
+ * Variables are only resolved in the symbol table that assignments
+ * go to and NULL is returned if they do not exist there yet.
+ * Missing array elements are created. Once the target has been
+ * updated, eval_lvalue_store() must be called with the same lvalue:
+ * elements of typed arrays are written back then, and an array
+ * that lives in an outer symbol table is stored.
+ *
+ * NULL is also returned if evaluating an index raised an exception.
  */
-void eval_assign_array_direct(intend_state *s, const char *name,
-                              int argc, expr **index, value *val)
+value *eval_lvalue(intend_state *s, expr *ex, lvalue *lv)
 {
     symtab_entry *entry;
-    value *arr = NULL;
-    int is_struct;
-    int is_new = 0;
 
-    sanity(name && index && *index && val);
+    sanity(ex && ex->name && lv);
 
-    is_struct = (index[0]->type == EXPR_FIELD);
+    lv->root = NULL;
 
-    entry = symtab_stack_lookup(s, name);
-    if (!entry || entry->type != SYMTAB_ENTRY_VAR) {
-        if (is_struct) {
-            arr = value_make_struct();
-            is_new = 1;
-        } else {
-            arr = value_make_array();
-            is_new = 1;
+    if (ex->type == EXPR_REF || ex->type == EXPR_ASSIGN) {
+        entry = lookup_top(s, ex);
+        if (!entry || entry->type != SYMTAB_ENTRY_VAR) {
+            return NULL;
+        }
+        return &entry->entry_u.var;
+    }
+
+    sanity((ex->type == EXPR_REF_ARRAY || ex->type == EXPR_ASSIGN_ARRAY) &&
+           ex->argc > 0 && ex->argv[0]);
+
+    return element_lvalue(s, ex, lv, NULL);
+}
+
+/*
+ * Finish update of assignment target
+ *
+ * Completes the update of a target returned by eval_lvalue().
+ */
+void eval_lvalue_store(intend_state *s, expr *ex, value *target, lvalue *lv)
+{
+    sanity(ex && target && lv);
+
+    if (target == &lv->elem) {
+        value_set_array(lv->array, lv->pos, &lv->elem);
+        value_cleanup(&lv->elem);
+        lv->elem.type = VALUE_TYPE_VOID;
+    }
+    if (lv->root) {
+        eval_store(s, ex, lv->root);
+    }
+}
+
+/*
+ * Evaluate combined operator and assignment in place
+ *
+ * The operator is applied directly to the storage of the target,
+ * and the result is stored in the clean value res. Strings are
+ * appended to in place. The right
+ * operand is evaluated after the target is resolved, unless it is
+ * given in two, which is only read. Returns 0 if the target cannot
+ * be resolved for update, and the assignment must be evaluated as
+ * written.
+ */
+static int op_assign(intend_state *s, expr *ex, value *two, value *res)
+{
+    value *target, *arg, *val, cell;
+    lvalue lv;
+    expr *op;
+
+    op = ex->inner;
+
+    target = eval_lvalue(s, ex, &lv);
+    if (!target) {
+        return s->except_flag || s->exit_flag;
+    }
+
+    if (two) {
+        arg = two;
+    } else {
+        cell.type = VALUE_TYPE_VOID;
+        arg = eval_expr_cell(s, op->index, &cell);
+        if (s->except_flag || s->exit_flag) {
+            eval_release_cell(op->index, arg);
+            return 1;
         }
+    }
+
+    if (eval_infix_scalar(op, target, arg, target)) {
+        if (!two) {
+            eval_release_cell(op->index, arg);
+        }
+        *res = *target;
+    } else if (op->op == OPTYPE_PLUS && target->type == VALUE_TYPE_STRING &&
+               arg->type == VALUE_TYPE_STRING) {
+        // Appends grow the buffer of the target in place
+        value_append_string(target, STR_OF(arg), STRLEN_OF(arg));
+        if (!two) {
+            eval_release_cell(op->index, arg);
+        }
+        value_copy_to(res, target);
     } else {
-        if (is_struct) {
-            if (entry->entry_u.var.type == VALUE_TYPE_STRUCT) {
-                // Optimization for equal value assignments and large
-                // data types, like strings, arrays and structs
-                //arr = value_copy(entry->entry_u.var);
-                arr = &entry->entry_u.var;
-            } else {
-                arr = value_make_struct();
-                is_new = 1;
-            }
+        if (two) {
+            arg = value_copy(two);
         } else {
-            if (entry->entry_u.var.type == VALUE_TYPE_ARRAY) {
-                // Optimization for equal value assignments and large
-                // data types, like strings, arrays and structs
-                //arr = value_copy(entry->entry_u.var);
-                arr = &entry->entry_u.var;
-            } else {
-                arr = value_make_array();
-                is_new = 1;
-            }
+            arg = eval_box(op->index, arg);
+        }
+        val = eval_infix_values(s, op, value_copy(target), arg);
+        if (s->except_flag || s->exit_flag) {
+            value_free(val);
+            return 1;
         }
+        value_copy_to(target, val);
+        value_move_to(res, val);
     }
 
-    arr = array_set(s, arr, argc, index, val);
-    if (!s->except_flag && !s->exit_flag) {
-        symtab_stack_add_variable(s, name, arr);
+    eval_lvalue_store(s, ex, target, &lv);
+    return 1;
+}
+
+/*
+ * Check for in-place combined assignment
+ *
+ * Combined assignments remember their operator. They can update
+ * the target in place if the right operand has no side effects;
+ * otherwise the target is read before the operand as written.
+ */
+int eval_assign_inplace(expr *ex)
+{
+    sanity(ex);
+
+    return ex->op && ex->inner->type == EXPR_INFIX &&
+           eval_is_pure(ex->inner->index);
+}
+
+/*
+ * Evaluate assignment as written
+ */
+static value *assign_written(intend_state *s, expr *ex)
+{
+    value *val;
+
+    val = eval_expr(s, ex->inner);
+    if (ex->type == EXPR_ASSIGN) {
+        eval_assign_value(s, ex, val);
+    } else if (!s->except_flag && !s->exit_flag) {
+        eval_assign_array_direct(s, ex, val);
+    }
+    return val;
+}
+
+/*
+ * Evaluate assignment to pre-allocated value
+ *
+ * Like eval_assign() and eval_assign_array(), with the result
+ * stored in the clean value res.
+ */
+void eval_assign_to(intend_state *s, expr *ex, value *res)
+{
+    sanity(ex && ex->name && res);
+
+    if (eval_assign_inplace(ex) && op_assign(s, ex, NULL, res)) {
+        return;
+    }
+    value_move_to(res, assign_written(s, ex));
+}
+
+/*
+ * Apply in-place combined assignment to evaluated operand
+ *
+ * Like eval_assign_to(), with the right operand already evaluated
+ * by the caller. The operand is only read.
+ */
+void eval_assign_operand(intend_state *s, expr *ex, value *two, value *res)
+{
+    sanity(ex && ex->name && two && res && eval_assign_inplace(ex));
+
+    if (op_assign(s, ex, two, res)) {
+        return;
+    }
+    value_move_to(res, assign_written(s, ex));
+}
+
+/*
+ * Evaluate variable assignment
+ */
+value *eval_assign(intend_state *s, expr *ex)
+{
+    value *res;
+
+    sanity(ex && ex->name);
+
+    if (eval_assign_inplace(ex)) {
+        res = value_alloc(VALUE_TYPE_VOID);
+        if (op_assign(s, ex, NULL, res)) {
+            return res;
+        }
+        value_free(res);
+    }
+    return assign_written(s, ex);
+}
+
+/*
+ * Direct array assignment
+ *
+ * This function can be used by other evaluation functions to
+ * make updates to array elements.
+ */
+void eval_assign_array_direct(intend_state *s, expr *ex, value *val)
+{
+    value *elem;
+    lvalue lv;
+
+    sanity(ex && ex->name && ex->argc > 0 && ex->argv[0] && val);
+
+    if (val->type == VALUE_TYPE_FN &&
+            ex->argv[ex->argc - 1]->type == EXPR_FIELD) {
+        elem = element_lvalue(s, ex, &lv, val);
+    } else {
+        elem = eval_lvalue(s, ex, &lv);
+        if (elem) {
+            value_copy_to(elem, val);
+        }
+    }
+    if (elem) {
+        eval_lvalue_store(s, ex, elem, &lv);
     }
-    // Optimization for equal value assignments and large
-    // data types, like strings, arrays and structs
-    if (is_new) value_free(arr);
 }
 
 /*
@@ -205,13 +563,16 @@ void eval_assign_array_direct(intend_state *s, const char *name,
  */
 value *eval_assign_array(intend_state *s, expr *ex)
 {
-    value *val;
+    value *res;
 
     sanity(ex && ex->name && ex->argc > 0 && ex->argv[0]);
 
-    val = eval_expr(s, ex->inner);
-    if (!s->except_flag && !s->exit_flag) {
-        eval_assign_array_direct(s, ex->name, ex->argc, ex->argv, val);
+    if (eval_assign_inplace(ex)) {
+        res = value_alloc(VALUE_TYPE_VOID);
+        if (op_assign(s, ex, NULL, res)) {
+            return res;
+        }
+        value_free(res);
     }
-    return val;
+    return assign_written(s, ex);
 }
@@ -0,0 +1,187 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Inline caches for call, method and field lookup
+ *
+ * Call and method expressions remember where their target function
+ * was found: the position of the entry in the entry array together
+ * with the version of the symbol table it was found in. As long as
+ * the table keeps that version, the entry is still there and the
+ * lookup by name can be skipped.
+ */
+
+#include <stdlib.h>
+
+#include "eval.h"
+
+/*
+ * Get cached entry
+ */
+static symtab_entry *cached(symtab *table, expr *ex)
+{
+    return &table->entries[ex->cache_pos];
+}
+
+/*
+ * Version of local slot layout
+ */
+static unsigned long scope(symtab *top)
+{
+    return top->frame ? top->frame->version : 0;
+}
+
+/*
+ * Check whether local symbol table can hide a global name
+ *
+ * With the slot layout the name was resolved in, only its slot
+ * can hide it. Any other table must have no entries outside its
+ * slots, and its layout must be one known not to have the name.
+ */
+static int hidden(symtab *top, expr *ex)
+{
+    if (ex->frame && top->frame == ex->frame) {
+        return top->slots[ex->slot].symbol != NULL;
+    }
+    return top->count > 0 || scope(top) != ex->cache_scope;
+}
+
+/*
+ * Look up function for call expression
+ *
+ * Works like eval_lookup(). Functions held in local slots are
+ * read directly. Only functions of the global symbol table are
+ * cached, and only while the topmost local symbol table cannot
+ * hide them.
+ */
+symtab_entry *eval_cache_call(intend_state *s, expr *ex)
+{
+    symtab **local = s->local_tables;
+    symtab *global = s->global_table;
+    symtab *top = NULL;
+    symtab_entry *entry;
+
+    sanity(ex && ex->name);
+
+    if (s->local_depth > 0) {
+        top = local[s->local_depth-1];
+        if (ex->frame && top->frame == ex->frame &&
+                top->slots[ex->slot].symbol) {
+            return &top->slots[ex->slot];
+        }
+    }
+
+    if (ex->cache == global->version && (!top || !hidden(top, ex))) {
+        ++s->cache_hits;
+        return cached(global, ex);
+    }
+    ++s->cache_misses;
+
+    entry = eval_lookup(s, ex);
+    if (!entry || entry->type != SYMTAB_ENTRY_FUNCTION ||
+            !symtab_locate(global, entry, &ex->cache_pos)) {
+        return entry;
+    }
+    if (top && !(ex->frame && top->frame == ex->frame)) {
+        if (top->count > 0 || (top->frame &&
+                symtab_frame_find(top->frame, ex->name,
+                                  intern_hash(ex->name)) >= 0)) {
+            return entry;
+        }
+    }
+    ex->cache = global->version;
+    ex->cache_scope = top ? scope(top) : 0;
+    return entry;
+}
+
+/*
+ * Look up struct field for expression
+ *
+ * Works like symtab_lookup() on the symbol table of the struct.
+ * Fields kept in the slots of a shape are cached by the version of
+ * the shape and their slot: every struct with that shape holds the
+ * field in the same slot, so one cache serves all of them.
+ */
+symtab_entry *eval_cache_field(intend_state *s, expr *ex, symtab *table,
+                               const char *name)
+{
+    symtab_frame *shape = table->frame;
+    symtab_entry *entry;
+
+    sanity(ex && table && name);
+
+    if (shape && shape->version == ex->cache) {
+        ++s->cache_hits;
+        entry = &table->slots[ex->cache_pos];
+        return entry->symbol ? entry : NULL;
+    }
+    ++s->cache_misses;
+
+    entry = symtab_lookup(table, name);
+    if (entry && shape && shape->shape && entry >= table->slots &&
+            entry < table->slots + shape->len) {
+        ex->cache = shape->version;
+        ex->cache_pos = entry - table->slots;
+    }
+    return entry;
+}
+
+/*
+ * Look up method for method call expression
+ *
+ * Works like symtab_lookup() on the symbol table of the struct.
+ * Methods of structs with a shape are cached like fields. Copies
+ * of a struct keep the version of their original, so the cache
+ * also hits for struct values copied from the same object.
+ */
+symtab_entry *eval_cache_method(intend_state *s, expr *ex, symtab *table)
+{
+    symtab_entry *entry;
+
+    sanity(ex && ex->name && table);
+
+    if (table->frame && table->frame->shape) {
+        return eval_cache_field(s, ex, table, ex->name);
+    }
+
+    if (ex->cache == table->version) {
+        ++s->cache_hits;
+        return cached(table, ex);
+    }
+    ++s->cache_misses;
+
+    entry = symtab_lookup_name(table, ex->name);
+    if (entry && entry->type == SYMTAB_ENTRY_FUNCTION &&
+            symtab_locate(table, entry, &ex->cache_pos)) {
+        ex->cache = table->version;
+    }
+    return entry;
+}
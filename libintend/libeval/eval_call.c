@@ -34,56 +34,114 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "eval.h"
 
 /*
- * Free all floating arguments
+ * Chunk of the argument stack
+ *
+ * Arguments of calls in progress are evaluated into consecutive
+ * slots of the current chunk. Chunks never move, so argument
+ * vectors stay valid while nested calls push their own; a call
+ * that does not fit switches to the next chunk. Chunks emptied
+ * on return are kept for the next call that needs them.
  */
-void eval_free_floats(intend_state *s)
+typedef struct arg_chunk {
+    struct arg_chunk *prev;     /* chunk below, used before this one */
+    struct arg_chunk *next;     /* spare chunk above */
+    unsigned int top;           /* number of slots in use */
+    unsigned int size;          /* number of slots */
+    value *slots[1];            /* argument slots */
+} arg_chunk;
+
+/*
+ * Free argument stack
+ *
+ * Frees the arguments of calls still in progress along with all
+ * chunks of the argument stack.
+ */
+void eval_free_args(intend_state *s)
 {
-    value **float_args = s->float_args;
-    value ***vectors = s->vectors;
-    int i;
+    arg_chunk *chunk = s->args, *next;
+    unsigned int i;
 
-    for (i = 0; i < s->float_count; i++) {
-        value_free(float_args[i]);
+    if (!chunk) {
+        return;
     }
-    free(s->float_args);
-
-    for (i = 0; i < s->vector_count; i++) {
-        free(vectors[i]);
+    while (chunk->prev) {
+        chunk = chunk->prev;
     }
-    free(s->vectors);
+    while (chunk) {
+        for (i = 0; i < chunk->top; i++) {
+            value_free(chunk->slots[i]);
+        }
+        next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    s->args = NULL;
 }
 
 /*
- * Add allocated function argument to floating list
+ * Allocate argument stack chunk
  */
-static void add_float(intend_state *s, value *val)
+static arg_chunk *new_chunk(arg_chunk *prev, unsigned int size)
 {
-    value **float_args = s->float_args;
-
-    float_args = oom(realloc(float_args,
-                             (s->float_count + 1) * sizeof(value *)));
-    float_args[s->float_count++] = val;
-    s->float_args = float_args;
+    arg_chunk *chunk;
+
+    chunk = oom(malloc(sizeof(arg_chunk) + (size - 1) * sizeof(value *)));
+    chunk->prev = prev;
+    chunk->next = NULL;
+    chunk->top = 0;
+    chunk->size = size;
+    if (prev) {
+        prev->next = chunk;
+    }
+    return chunk;
 }
 
 /*
- * Add allocated argument vector to floating list
+ * Push slots for call arguments
+ *
+ * Returns argc consecutive slots on the argument stack. A spare
+ * chunk too small for the call is freed with the spares above it.
  */
-static void add_vector(intend_state *s, value **val)
+static value **push_args(intend_state *s, unsigned int argc)
 {
-    value ***vectors = s->vectors;
+    arg_chunk *chunk = s->args, *next;
+    value **slots;
+
+    if (!chunk) {
+        chunk = s->args = new_chunk(NULL, ARG_CHUNK_SIZE > argc ?
+                                          ARG_CHUNK_SIZE : argc);
+    } else if (chunk->size - chunk->top < argc) {
+        next = chunk->next;
+        if (next && next->size < argc) {
+            chunk->next = NULL;
+            while (next) {
+                chunk = next->next;
+                free(next);
+                next = chunk;
+            }
+            chunk = s->args;
+        }
+        if (!chunk->next) {
+            new_chunk(chunk, ARG_CHUNK_SIZE > argc ? ARG_CHUNK_SIZE : argc);
+        }
+        chunk = s->args = chunk->next;
+    }
 
-    vectors = oom(realloc(vectors, (s->vector_count + 1) * sizeof(value **)));
-    vectors[s->vector_count++] = val;
-    s->vectors = vectors;
+    slots = chunk->slots + chunk->top;
+    chunk->top += argc;
+    return slots;
 }
 
 /*
  * Evaluate function call arguments
+ *
+ * The arguments are evaluated directly into slots pushed on the
+ * argument stack, which argv points to until free_call_args().
  */
 void eval_call_args(intend_state *s, unsigned int argc, expr **args,
                     value ***argv)
@@ -92,29 +150,47 @@ void eval_call_args(intend_state *s, unsigned int argc, expr **args,
 
     sanity((argc == 0 || args) && argv);
 
-    *argv = oom(calloc(sizeof(value *), argc));
-    add_vector(s, *argv);
+    if (argc == 0) {
+        *argv = NULL;
+        return;
+    }
+
+    *argv = push_args(s, argc);
+    for (i = 0; i < argc; i++) {
+        (*argv)[i] = NULL;
+    }
     for (i = 0; i < argc; i++) {
         (*argv)[i] = eval_expr(s, args[i]);
-        add_float(s, (*argv)[i]);
     }
 }
 
 /*
  * Free function call arguments
+ *
+ * Frees the arguments and pops their slots off the argument
+ * stack. Calls must free their arguments in reverse order.
  */
 void free_call_args(intend_state *s, unsigned int argc, value ***argv)
 {
+    arg_chunk *chunk = s->args;
     unsigned int i;
 
     sanity(argc == 0 || (argv && *argv));
 
+    if (argc == 0) {
+        return;
+    }
+
+    sanity(chunk && chunk->top >= argc &&
+           *argv == chunk->slots + chunk->top - argc);
+
     for (i = 0; i < argc; i++) {
         value_free((*argv)[i]);
     }
-    s->float_count -= argc;
-    free(*argv);
-    --s->vector_count;
+    chunk->top -= argc;
+    if (chunk->top == 0 && chunk->prev) {
+        s->args = chunk->prev;
+    }
 }
 
 /*
@@ -139,148 +215,409 @@ static int reflength(expr *ex)
 }
 
 /*
- * Maximum length of occuring references
+ * Check for argument passed by reference
+ *
+ * Only variables and array elements are stored back.
+ */
+static int is_ref(expr *ex)
+{
+    return ex->type == EXPR_PASS_REF &&
+           (ex->inner->type == EXPR_REF || ex->inner->type == EXPR_REF_ARRAY);
+}
+
+/*
+ * Check for storage passed by reference more than once
+ *
+ * Returns 1 if another argument passed by reference names the
+ * same variable or holds the same array or struct. Such arguments
+ * are copied in and out as written, so that changes made through
+ * one of them are not seen through the others.
  */
-static int maxlength(unsigned int argc, expr **argv)
+static int is_shared_ref(unsigned int argc, expr **args, value **argv,
+                         unsigned int arg)
 {
+    value *val = argv[arg];
     unsigned int i;
-    int max = 0, curr;
 
     for (i = 0; i < argc; i++) {
-        curr = reflength(argv[i]);
-        if (curr > max) max = curr;
+        if (i == arg || !is_ref(args[i])) {
+            continue;
+        }
+        if (strcmp(args[i]->inner->name, args[arg]->inner->name) == 0) {
+            return 1;
+        }
+        if (argv[i]->type != val->type) {
+            continue;
+        }
+        if (val->type == VALUE_TYPE_ARRAY &&
+                argv[i]->value_u.array_val == val->value_u.array_val) {
+            return 1;
+        }
+        if (val->type == VALUE_TYPE_STRUCT &&
+                STRUCT_OF(argv[i]) == STRUCT_OF(val)) {
+            return 1;
+        }
     }
-    return max;
+    return 0;
 }
 
 /*
- * Update references from symtab after function call
+ * Bind reference argument to call
+ *
+ * An array or struct that is still shared with the variable or
+ * element it was read from is bound to the call, see value_bind().
+ * The storage holds it and the argument is updated in place, or
+ * the parameter of a user-defined function, see enter_func().
+ * Nothing is bound if the storage could not be, see
+ * value_bind_storage().
  */
-void update_call_args(intend_state *s, signature *sig, unsigned int argc,
-                      expr **argv)
+static void bind_ref(intend_state *s, signature *sig, expr *ex, value *val,
+                     call_ref *ref)
 {
-    char **names;
-    expr *ex;
-    symtab *sym;
-    symtab_entry *entry;
-    value *val;
-    unsigned int i;
-    int maxref, len;
+    value *target;
+    lvalue lv;
+    int bound;
 
-    sanity(sig && (argc == 0 || argv));
+    if (val->type != VALUE_TYPE_ARRAY && val->type != VALUE_TYPE_STRUCT) {
+        return;
+    }
+    if (ex->type == EXPR_REF_ARRAY && !eval_is_pure(ex)) {
+        return;
+    }
+    if (sig->type == FUNCTION_TYPE_USERDEF && ref->arg >= sig->args) {
+        return;
+    }
 
-    sym = symtab_stack_pop(s);
-    names = sig->data;
-    maxref = maxlength(argc, argv);
+    target = eval_lvalue(s, ex, &lv);
+    if (!target || lv.root || target->type != val->type) {
+        return;
+    }
+    if (val->type == VALUE_TYPE_ARRAY ?
+            target->value_u.array_val != val->value_u.array_val :
+            STRUCT_OF(target) != STRUCT_OF(val)) {
+        return;
+    }
 
-    for (len = maxref; len >= 0; len--) {
-        for (i = 0; i < argc; i++) {
-            ex = argv[i];
-            if (reflength(ex) != len) {
-                continue;
-            }
-            if (ex->type != EXPR_PASS_REF ||
-                    (ex->inner->type != EXPR_REF && ex->inner->type != EXPR_REF_ARRAY)) {
-                continue;
-            }
-            entry = symtab_lookup(sym, names[i]);
-            if (!entry || entry->type == SYMTAB_ENTRY_CLASS) {
-                continue;
-            }
-            if (ex->inner->type == EXPR_REF) {
-                if (entry->type == SYMTAB_ENTRY_VAR) {
-                    symtab_stack_add_variable(s, ex->inner->name, &entry->entry_u.var);
-                } else {
-                    symtab_stack_add_function(s, ex->inner->name, &(entry->entry_u.fnc.sigs[0]));
-                }
-            } else {
-                if (entry->type == SYMTAB_ENTRY_VAR) {
-                    eval_assign_array_direct(s, ex->inner->name,
-                                             ex->inner->argc, ex->inner->argv, &entry->entry_u.var);
-                } else {
-                    val = value_make_fn(&(entry->entry_u.fnc.sigs[0]));
-                    eval_assign_array_direct(s, ex->inner->name,
-                                             ex->inner->argc, ex->inner->argv, val);
-                    value_free(val);
-                }
-            }
+    bound = value_bind_storage(target);
+    if (bound >= 0) {
+        ref->bound = bound;
+        value_bind(val, VALUE_BIND_WRITE);
+    }
+}
+
+/*
+ * Bind reference arguments to call
+ *
+ * Collects the arguments of a call that are passed by reference,
+ * in the order they are stored back by update_call_args(), and
+ * binds their arrays and structs to the storage they were read
+ * from. The function then updates that storage in place, and
+ * storing back does not copy anything. Storage passed more than
+ * once is not bound, see is_shared_ref().
+ */
+void bind_call_args(intend_state *s, signature *sig, unsigned int argc,
+                    expr **args, value **argv, call_refs *refs)
+{
+    call_ref ref;
+    unsigned int i, j, count = 0;
+
+    sanity(sig && refs && (argc == 0 || (args && argv)));
+
+    refs->count = 0;
+    refs->list = refs->local;
+
+    for (i = 0; i < argc; i++) {
+        count += is_ref(args[i]);
+    }
+    if (count == 0) {
+        return;
+    }
+    if (count > REF_LOCAL) {
+        refs->list = oom(malloc(count * sizeof(call_ref)));
+    }
+
+    for (i = 0; i < argc; i++) {
+        if (!is_ref(args[i])) {
+            continue;
+        }
+        ref.arg = i;
+        ref.len = reflength(args[i]);
+        ref.bound = 0;
+        if (!s->except_flag && !s->exit_flag &&
+                (count == 1 || !is_shared_ref(argc, args, argv, i))) {
+            bind_ref(s, sig, args[i]->inner, argv[i], &ref);
+        }
+
+        // Longer references are stored first, so that shorter
+        // ones to the same variable win
+        for (j = refs->count++; j > 0 && refs->list[j - 1].len < ref.len; j--) {
+            refs->list[j] = refs->list[j - 1];
+        }
+        refs->list[j] = ref;
+    }
+}
+
+/*
+ * Unbind storage of reference argument
+ *
+ * The storage is unbound when the argument is stored back to it.
+ * This is for calls that lost the parameter and do not store back.
+ */
+static void unbind_ref(intend_state *s, expr *ex)
+{
+    value *target;
+    lvalue lv;
+
+    target = eval_lvalue(s, ex, &lv);
+    if (target && BIND_OF(target) == VALUE_BIND_HOLD) {
+        value_unbind(target);
+    }
+}
+
+/*
+ * Store reference argument back
+ *
+ * User-defined functions leave the final value of the parameter
+ * in their symbol table, builtins in argv.
+ */
+static void store_ref(intend_state *s, signature *sig, expr *ex, value *val,
+                      symtab_entry *entry, int bound)
+{
+    if (sig->type == FUNCTION_TYPE_BUILTIN) {
+        if (ex->type == EXPR_REF) {
+            eval_store(s, ex, val);
+        } else {
+            eval_assign_array_direct(s, ex, val);
+        }
+        return;
+    }
+
+    if (!entry || entry->type == SYMTAB_ENTRY_CLASS) {
+        if (bound) {
+            unbind_ref(s, ex);
+        }
+        return;
+    }
+    if (ex->type == EXPR_REF) {
+        if (entry->type == SYMTAB_ENTRY_VAR) {
+            eval_store(s, ex, &entry->entry_u.var);
+        } else {
+            symtab_stack_add_function(s, ex->name, &(entry->entry_u.fnc.sigs[0]));
+        }
+    } else {
+        if (entry->type == SYMTAB_ENTRY_VAR) {
+            eval_assign_array_direct(s, ex, &entry->entry_u.var);
+        } else {
+            val = value_make_fn(&(entry->entry_u.fnc.sigs[0]));
+            eval_assign_array_direct(s, ex, val);
+            value_free(val);
         }
     }
-    symtab_free(sym);
 }
 
 /*
- * Update references from array after function call
+ * Update references after function call
+ *
+ * Stores the arguments collected by bind_call_args() back, which
+ * unbinds their storage from the call. The symbol table of the call to a
+ * user-defined function must be given in sym.
  */
-void update_array_call_args(intend_state *s, signature *sig, unsigned int argc,
-                            expr **argv, value **newargv)
+void update_call_args(intend_state *s, signature *sig, expr **args,
+                      value **argv, call_refs *refs, symtab *sym)
 {
+    symtab_entry *entry;
     char **names;
-    expr *ex;
+    call_ref *ref;
     unsigned int i;
-    int maxref, len;
 
-    sanity(sig && (argc == 0 || argv));
+    sanity(sig && refs && (refs->count == 0 || (args && argv)));
+    sanity(sig->type == FUNCTION_TYPE_BUILTIN || sym);
 
     names = sig->data;
-    maxref = maxlength(argc, argv);
-
-    for (len = maxref; len >= 0; len--) {
-        for (i = 0; i < argc; i++) {
-            ex = argv[i];
-            if (reflength(ex) != len) {
-                continue;
-            }
-            if (ex->type != EXPR_PASS_REF ||
-                    (ex->inner->type != EXPR_REF && ex->inner->type != EXPR_REF_ARRAY)) {
-                continue;
-            }
-            if (ex->inner->type == EXPR_REF) {
-                symtab_stack_add_variable(s, ex->inner->name, newargv[i]);
-            } else {
-                eval_assign_array_direct(s, ex->inner->name,
-                                         ex->inner->argc, ex->inner->argv, newargv[i]);
-            }
+    for (i = 0; i < refs->count; i++) {
+        ref = &refs->list[i];
+        entry = NULL;
+        if (sig->type != FUNCTION_TYPE_BUILTIN && ref->arg < sig->args) {
+            entry = symtab_lookup(sym, names[ref->arg]);
         }
+        store_ref(s, sig, args[ref->arg]->inner, argv[ref->arg], entry,
+                  ref->bound);
+    }
+
+    if (refs->list != refs->local) {
+        free(refs->list);
     }
 }
 
 /*
- * Evaluate function call
+ * Look up function signature for call expression
+ *
+ * Returns NULL and raises a fatal error if the called name
+ * does not refer to a function.
  */
-value *eval_call(intend_state *s, expr *ex)
+signature *eval_call_lookup(intend_state *s, expr *ex)
 {
     symtab_entry *entry;
-    signature *sig;
-    value *res = NULL;
-    value **argv;
 
     sanity(ex && ex->name);
 
-    entry = symtab_stack_lookup(s, ex->name);
+    entry = eval_cache_call(s, ex);
     if (!entry || entry->type == SYMTAB_ENTRY_CLASS ||
             (entry->type == SYMTAB_ENTRY_VAR &&
              entry->entry_u.var.type != VALUE_TYPE_FN)) {
         fatal(s, "call to undefined function `%s'", ex->name);
-        return value_make_void();
+        return NULL;
     }
     if (entry->type == SYMTAB_ENTRY_FUNCTION) {
-        sig = &(entry->entry_u.fnc.sigs[0]);
-    } else {
-        sig = FNSIG_OF(&entry->entry_u.var);
+        return &(entry->entry_u.fnc.sigs[0]);
     }
+    return FNSIG_OF(&entry->entry_u.var);
+}
 
-    eval_call_args(s, ex->argc, ex->argv, &argv);
+/*
+ * Call function with evaluated arguments
+ *
+ * The arguments in argv are not consumed. References passed
+ * in the call expression are bound to the call while it runs
+ * and stored back after it returns. Calls without references
+ * leave nothing in the local symbol table that is read after
+ * they return, so the function may reuse it for tail calls.
+ */
+value *eval_call_values(intend_state *s, expr *ex, signature *sig,
+                        value **argv)
+{
+    call_refs refs;
+    symtab *sym;
+    value *res;
+
+    sanity(ex && sig);
 
+    bind_call_args(s, sig, ex->argc, ex->argv, argv, &refs);
     if (sig->type == FUNCTION_TYPE_BUILTIN) {
         res = call_function(s, sig, ex->argc, argv);
-        update_array_call_args(s, sig, ex->argc, ex->argv, argv);
+        update_call_args(s, sig, ex->argv, argv, &refs, NULL);
     } else {
-        symtab_stack_enter(s);
+        symtab_stack_enter_frame(s, eval_frame(sig->def, sig->data, sig->args));
+        s->tail_frame = refs.count == 0;
         res = call_function(s, sig, ex->argc, argv);
-        update_call_args(s, sig, ex->argc, ex->argv);
+        s->tail_frame = 0;
+        sym = symtab_stack_pop(s);
+        update_call_args(s, sig, ex->argv, argv, &refs, sym);
+        symtab_free(sym);
+    }
+    return res;
+}
+
+/*
+ * Evaluate function call
+ */
+value *eval_call(intend_state *s, expr *ex)
+{
+    signature *sig;
+    value *res;
+    value **argv;
+
+    sanity(ex && ex->name);
+
+    sig = eval_call_lookup(s, ex);
+    if (!sig) {
+        return value_make_void();
     }
 
+    eval_call_args(s, ex->argc, ex->argv, &argv);
+    res = eval_call_values(s, ex, sig, argv);
+    free_call_args(s, ex->argc, &argv);
+
+    return res;
+}
+
+/*
+ * Leave call with evaluated arguments pending as tail call
+ *
+ * This function is used for calls returned by a return statement.
+ * Calls to user-defined functions without references are checked
+ * and left pending for the running function, which takes over the
+ * arguments in argv and sets them to NULL. Returns 1 if the call
+ * was left pending and the return is in progress, 0 if the caller
+ * has to make the call itself.
+ */
+int eval_tail_values(intend_state *s, expr *ex, signature *sig,
+                     value **argv)
+{
+    tail_call *tail = s->tail;
+    unsigned int i;
+
+    sanity(ex && sig && (ex->argc == 0 || argv));
+
+    if (!tail || tail->depth != s->local_depth ||
+            sig->type != FUNCTION_TYPE_USERDEF ||
+            s->except_flag || s->exit_flag) {
+        return 0;
+    }
+    for (i = 0; i < ex->argc; i++) {
+        if (is_ref(ex->argv[i])) {
+            return 0;
+        }
+    }
+
+    call_check(s, sig->name, sig, ex->argc, argv);
+    if (s->except_flag || s->exit_flag) {
+        return 0;
+    }
+
+    if (ex->argc > tail->size) {
+        tail->argv = oom(realloc(tail->argv, ex->argc * sizeof(value *)));
+        tail->size = ex->argc;
+    }
+    for (i = 0; i < ex->argc; i++) {
+        tail->argv[i] = argv[i];
+        argv[i] = NULL;
+    }
+    tail->argc         = ex->argc;
+    tail->ret.name     = sig->name;
+    tail->ret.rettype  = sig->rettype;
+    tail->ret.retcheck = sig->retcheck;
+    tail->names        = sig->data;
+    tail->body         = sig->def;
+    tail->args         = sig->args;
+    tail->pending      = 1;
+
+    s->retval = NULL;
+    s->return_flag = s->continue_flag = s->break_flag = 1;
+    return 1;
+}
+
+/*
+ * Evaluate function call in tail position
+ *
+ * Returns NULL if the call was left pending, see eval_tail_values().
+ */
+value *eval_tail_call(intend_state *s, expr *ex)
+{
+    signature *sig;
+    value *res;
+    value **argv;
+
+    sanity(ex && ex->name);
+
+    if (s->except_flag || s->exit_flag) {
+        return value_make_void();
+    }
+    s->source_line = ex->line;
+    s->source_file = ex->file;
+
+    sig = eval_call_lookup(s, ex);
+    if (!sig) {
+        return value_make_void();
+    }
+
+    eval_call_args(s, ex->argc, ex->argv, &argv);
+    if (eval_tail_values(s, ex, sig, argv)) {
+        res = NULL;
+    } else {
+        res = eval_call_values(s, ex, sig, argv);
+    }
     free_call_args(s, ex->argc, &argv);
+
     return res;
 }
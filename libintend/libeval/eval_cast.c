@@ -63,16 +63,23 @@ static value_type typeval(const char *typespec)
     return VALUE_TYPE_VOID;
 }
 
+/*
+ * Apply cast to evaluated operand
+ */
+value *eval_cast_value(intend_state *s, expr *ex, value *val)
+{
+    sanity(ex && val);
+
+    value_cast_inplace(s, &val, typeval(ex->name));
+    return val;
+}
+
 /*
  * Evaluate cast
  */
 value *eval_cast(intend_state *s, expr *ex)
 {
-    value *val;
-
     sanity(ex);
 
-    val = eval_expr(s, ex->inner);
-    value_cast_inplace(s, &val, typeval(ex->name));
-    return val;
+    return eval_cast_value(s, ex, eval_expr(s, ex->inner));
 }
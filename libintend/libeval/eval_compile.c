@@ -0,0 +1,593 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Bytecode compiler
+ *
+ * Lowers parsed statements and expressions into a flat bytecode
+ * for the dispatch loop in eval_vm.c. Control flow, constants,
+ * variable access, operators and function calls are compiled to
+ * dedicated operations; all other expressions and statements are
+ * delegated to the tree-walking evaluator.
+ */
+
+#include <stdlib.h>
+
+#include "eval.h"
+
+/*
+ * Compiler state
+ */
+typedef struct {
+    intend_state    *s;
+    vm_code         *code;
+    int             depth;      /* current value stack depth */
+    int             nest;       /* current block nesting */
+} compiler;
+
+static void compile_expr(compiler *c, expr *ex);
+static void compile_stmt(compiler *c, stmt *st);
+
+/*
+ * Append instruction
+ *
+ * The delta is the effect of the operation on the value stack
+ * depth. The position expression is given for leaf operations,
+ * which record the source position like eval_expr() does.
+ */
+static int emit(compiler *c, vm_op op, void *ptr, expr *pos, int delta)
+{
+    vm_code *code = c->code;
+    vm_instr *in;
+
+    if (code->len == code->size) {
+        code->size = code->size ? code->size * 2 : 32;
+        code->instr = oom(realloc(code->instr, code->size * sizeof(vm_instr)));
+    }
+
+    in = &code->instr[code->len];
+    in->op   = op;
+    in->arg  = 0;
+    in->alt  = 0;
+    in->ptr  = ptr;
+    in->line = pos ? pos->line : 0;
+    in->file = pos ? pos->file : NULL;
+
+    c->depth += delta;
+    if (c->depth > code->stack) {
+        code->stack = c->depth;
+    }
+
+    return code->len++;
+}
+
+/*
+ * Current instruction position
+ */
+static int here(compiler *c)
+{
+    return c->code->len;
+}
+
+/*
+ * Set jump target of instruction
+ */
+static void patch(compiler *c, int at, int target)
+{
+    c->code->instr[at].arg = target;
+}
+
+/*
+ * Enter loop or try block
+ */
+static void block_enter(compiler *c)
+{
+    if (++c->nest > c->code->blocks) {
+        c->code->blocks = c->nest;
+    }
+}
+
+/*
+ * Leave loop or try block
+ */
+static void block_leave(compiler *c)
+{
+    --c->nest;
+}
+
+/*
+ * Compile boolean AND and OR
+ *
+ * The first operand is left on the stack as the result if it
+ * decides the outcome, otherwise the second operand is.
+ */
+static void compile_bool(compiler *c, expr *ex, vm_op op)
+{
+    int jump;
+
+    compile_expr(c, ex->inner);
+    jump = emit(c, op, ex, NULL, -1);
+    compile_expr(c, ex->index);
+    emit(c, VM_BOOL, ex, NULL, 0);
+    patch(c, jump, here(c));
+}
+
+/*
+ * Compile conditional expression
+ */
+static void compile_if(compiler *c, expr *ex)
+{
+    int jump, end;
+
+    compile_expr(c, ex->inner);
+    jump = emit(c, VM_JUMP_FALSE, ex, NULL, -1);
+    compile_expr(c, ex->index);
+    end = emit(c, VM_JUMP, ex, NULL, -1);
+    patch(c, jump, here(c));
+    compile_expr(c, ex->elif);
+    patch(c, end, here(c));
+}
+
+/*
+ * Compile function call
+ *
+ * The function is looked up before the arguments are evaluated,
+ * so calls to undefined functions fail without side effects.
+ * Returned calls are compiled to VM_TAIL_CALL, which may leave
+ * the call pending for the running function.
+ */
+static void compile_call(compiler *c, expr *ex, vm_op op)
+{
+    unsigned int i;
+
+    emit(c, VM_CALL_CHECK, ex, ex, 0);
+    for (i = 0; i < ex->argc; i++) {
+        compile_expr(c, ex->argv[i]);
+    }
+    emit(c, op, ex, NULL, 1 - (int) ex->argc);
+}
+
+/*
+ * Compile expression
+ *
+ * Every expression leaves exactly one value on the stack.
+ */
+static void compile_expr(compiler *c, expr *ex)
+{
+    sanity(ex);
+
+    switch (ex->type) {
+        case EXPR_CONST_VOID:
+        case EXPR_CONST_BOOL:
+        case EXPR_CONST_INT:
+        case EXPR_CONST_FLOAT:
+        case EXPR_CONST_STRING:
+        case EXPR_FIELD:
+        case EXPR_FILE:
+        case EXPR_LINE:
+            if (ex->cval) {
+                emit(c, VM_CONST, ex->cval, ex, 1);
+            } else {
+                emit(c, VM_EVAL, ex, NULL, 1);
+            }
+            break;
+        case EXPR_REF:
+            emit(c, VM_REF, ex, ex, 1);
+            break;
+        case EXPR_ASSIGN:
+            if (eval_assign_inplace(ex)) {
+                compile_expr(c, ex->inner->index);
+                emit(c, VM_UPDATE, ex, ex, 0);
+                break;
+            }
+            compile_expr(c, ex->inner);
+            emit(c, VM_ASSIGN, ex, NULL, 0);
+            break;
+        case EXPR_ASSIGN_ARRAY:
+            if (eval_assign_inplace(ex)) {
+                compile_expr(c, ex->inner->index);
+                emit(c, VM_UPDATE, ex, ex, 0);
+                break;
+            }
+            compile_expr(c, ex->inner);
+            emit(c, VM_ASSIGN_ARRAY, ex, NULL, 0);
+            break;
+        case EXPR_CAST:
+            compile_expr(c, ex->inner);
+            emit(c, VM_CAST, ex, NULL, 0);
+            break;
+        case EXPR_CALL:
+            compile_call(c, ex, VM_CALL);
+            break;
+        case EXPR_INFIX:
+            if (ex->op == OPTYPE_BOOL_AND) {
+                compile_bool(c, ex, VM_AND);
+            } else if (ex->op == OPTYPE_BOOL_OR) {
+                compile_bool(c, ex, VM_OR);
+            } else if (ex->index->cval) {
+                compile_expr(c, ex->inner);
+                emit(c, VM_INFIX_CONST, ex, ex->index, 0);
+            } else {
+                compile_expr(c, ex->inner);
+                compile_expr(c, ex->index);
+                emit(c, VM_INFIX, ex, NULL, -1);
+            }
+            break;
+        case EXPR_PREFIX:
+            if (eval_prefix_inplace(ex)) {
+                emit(c, VM_EVAL, ex, NULL, 1);
+                break;
+            }
+            compile_expr(c, ex->inner);
+            emit(c, VM_PREFIX, ex, NULL, 0);
+            break;
+        case EXPR_POSTFIX:
+            if (eval_postfix_inplace(ex)) {
+                emit(c, VM_EVAL, ex, NULL, 1);
+                break;
+            }
+            compile_expr(c, ex->inner);
+            emit(c, VM_POSTFIX, ex, NULL, 0);
+            break;
+        case EXPR_IF:
+            compile_if(c, ex);
+            break;
+        case EXPR_PASS_REF:
+            compile_expr(c, ex->inner);
+            break;
+        default:
+            emit(c, VM_EVAL, ex, NULL, 1);
+            break;
+    }
+}
+
+/*
+ * Compile statement list
+ */
+static void compile_list(compiler *c, stmt_list *list)
+{
+    unsigned int i;
+
+    sanity(list);
+
+    for (i = 0; i < list->len; i++) {
+        compile_stmt(c, list->list[i]);
+    }
+}
+
+/*
+ * Compile loop
+ *
+ * The loop entry records the break and continue targets for the
+ * block stack of the dispatch loop. The test expression is given
+ * for while loops and omitted for do loops, which test at the end.
+ */
+static void compile_while(compiler *c, stmt *st, int test_first)
+{
+    int loop, jump = -1, body;
+
+    loop = emit(c, VM_LOOP_ENTER, st, NULL, 0);
+    block_enter(c);
+
+    if (test_first) {
+        c->code->instr[loop].alt = here(c);
+        compile_expr(c, st->expr);
+        jump = emit(c, VM_JUMP_FALSE, st, NULL, -1);
+        compile_stmt(c, st->true_case);
+        patch(c, emit(c, VM_JUMP, st, NULL, 0), c->code->instr[loop].alt);
+    } else {
+        body = here(c);
+        compile_stmt(c, st->true_case);
+        c->code->instr[loop].alt = here(c);
+        compile_expr(c, st->expr);
+        patch(c, emit(c, VM_JUMP_TRUE, st, NULL, -1), body);
+    }
+
+    block_leave(c);
+    patch(c, loop, here(c));
+    if (jump >= 0) patch(c, jump, here(c));
+    emit(c, VM_LOOP_LEAVE, st, NULL, 0);
+}
+
+/*
+ * Compile for loop
+ */
+static void compile_for(compiler *c, stmt *st)
+{
+    int loop, test, jump;
+
+    loop = emit(c, VM_LOOP_ENTER, st, NULL, 0);
+    block_enter(c);
+
+    compile_expr(c, st->init);
+    emit(c, VM_POP, st, NULL, -1);
+
+    test = here(c);
+    compile_expr(c, st->expr);
+    jump = emit(c, VM_JUMP_FALSE, st, NULL, -1);
+    compile_stmt(c, st->true_case);
+
+    c->code->instr[loop].alt = here(c);
+    compile_expr(c, st->guard);
+    emit(c, VM_POP, st, NULL, -1);
+    patch(c, emit(c, VM_JUMP, st, NULL, 0), test);
+
+    block_leave(c);
+    patch(c, loop, here(c));
+    patch(c, jump, here(c));
+    emit(c, VM_LOOP_LEAVE, st, NULL, 0);
+}
+
+/*
+ * Compile switch
+ *
+ * The switch value stays on the stack while the case guards are
+ * tested in order. Case bodies are laid out in sequence so that
+ * fall-through cases continue into the next body. When no guard
+ * matched, execution jumps to the default body, which never falls
+ * through, or past the switch if there is none.
+ */
+static void compile_switch(compiler *c, stmt *st)
+{
+    stmt_list *list;
+    stmt *label;
+    int *tests, *exits;
+    int nomatch, count = 0;
+    unsigned int i;
+
+    sanity(st->block);
+    list = (stmt_list *) st->block;
+
+    tests = oom(calloc(list->len + 1, sizeof(int)));
+    exits = oom(calloc(list->len + 1, sizeof(int)));
+
+    compile_expr(c, st->expr);
+
+    for (i = 0; i < list->len; i++) {
+        label = list->list[i];
+        sanity(label && (label->type == STMT_CASE || label->type == STMT_DEFAULT));
+
+        if (label->type == STMT_DEFAULT) continue;
+        if (label->expr->cval) {
+            tests[i] = emit(c, VM_CASE_CONST, label, label->expr, 0);
+        } else {
+            compile_expr(c, label->expr);
+            tests[i] = emit(c, VM_CASE, label, NULL, -1);
+        }
+    }
+    nomatch = emit(c, VM_JUMP, st, NULL, 0);
+
+    for (i = 0; i < list->len; i++) {
+        label = list->list[i];
+        if (label->type == STMT_CASE) {
+            patch(c, tests[i], here(c));
+        } else {
+            patch(c, nomatch, here(c));
+            nomatch = -1;
+        }
+        compile_list(c, (stmt_list *) label->block);
+        if (!label->thru || i == list->len - 1) {
+            exits[count++] = emit(c, VM_JUMP, label, NULL, 0);
+        }
+    }
+
+    if (nomatch >= 0) patch(c, nomatch, here(c));
+
+    for (i = 0; i < count; i++) {
+        patch(c, exits[i], here(c));
+    }
+    emit(c, VM_POP, st, NULL, -1);
+
+    free(tests);
+    free(exits);
+}
+
+/*
+ * Compile try-catch block
+ */
+static void compile_try(compiler *c, stmt *st)
+{
+    int try, catch;
+
+    try = emit(c, VM_TRY, st, NULL, 0);
+    block_enter(c);
+    compile_stmt(c, st->true_case);
+    block_leave(c);
+
+    catch = emit(c, VM_CATCH, st, NULL, 0);
+    patch(c, try, catch);
+    compile_stmt(c, st->false_case);
+    patch(c, catch, here(c));
+}
+
+/*
+ * Compile statement
+ */
+static void compile_stmt(compiler *c, stmt *st)
+{
+    int jump, end;
+
+    sanity(st);
+
+    switch (st->type) {
+        case STMT_NOP:
+            break;
+        case STMT_BLOCK:
+            compile_list(c, (stmt_list *) st->block);
+            break;
+        case STMT_IF:
+            compile_expr(c, st->expr);
+            jump = emit(c, VM_JUMP_FALSE, st, NULL, -1);
+            compile_stmt(c, st->true_case);
+            patch(c, jump, here(c));
+            break;
+        case STMT_IF_ELSE:
+            compile_expr(c, st->expr);
+            jump = emit(c, VM_JUMP_FALSE, st, NULL, -1);
+            compile_stmt(c, st->true_case);
+            end = emit(c, VM_JUMP, st, NULL, 0);
+            patch(c, jump, here(c));
+            compile_stmt(c, st->false_case);
+            patch(c, end, here(c));
+            break;
+        case STMT_WHILE:
+            compile_while(c, st, 1);
+            break;
+        case STMT_DO:
+            compile_while(c, st, 0);
+            break;
+        case STMT_FOR:
+            compile_for(c, st);
+            break;
+        case STMT_CONTINUE:
+            emit(c, VM_CONTINUE, st, NULL, 0);
+            break;
+        case STMT_BREAK:
+            emit(c, VM_BREAK, st, NULL, 0);
+            break;
+        case STMT_RETURN:
+            jump = emit(c, VM_RETURN_CHECK, st, NULL, 0);
+            if (st->tail) {
+                compile_call(c, st->expr, VM_TAIL_CALL);
+            } else if (st->expr) {
+                compile_expr(c, st->expr);
+            } else {
+                emit(c, VM_VOID, st, NULL, 1);
+            }
+            emit(c, VM_RETURN, st, NULL, -1);
+            patch(c, jump, here(c));
+            break;
+        case STMT_EXPR:
+            compile_expr(c, st->expr);
+            emit(c, VM_POP, st, NULL, -1);
+            break;
+        case STMT_SWITCH:
+            compile_switch(c, st);
+            break;
+        case STMT_TRY:
+            compile_try(c, st);
+            break;
+        case STMT_THROW:
+            compile_expr(c, st->expr);
+            emit(c, VM_THROW, st, NULL, -1);
+            break;
+        case STMT_FUNC:
+        case STMT_CLASS:
+            emit(c, VM_STMT, st, NULL, 0);
+            break;
+        case STMT_CASE:
+        case STMT_DEFAULT:
+            sanity(0);
+            break;
+    }
+}
+
+/*
+ * Set up compiler for new bytecode unit
+ */
+static void compile_begin(compiler *c, intend_state *s)
+{
+    c->s     = s;
+    c->code  = oom(calloc(1, sizeof(vm_code)));
+    c->depth = 0;
+    c->nest  = 0;
+}
+
+/*
+ * Finish bytecode unit and hand ownership to the state
+ */
+static vm_code *compile_end(compiler *c)
+{
+    vm_code *code = c->code;
+
+    emit(c, VM_HALT, NULL, NULL, 0);
+    sanity(c->depth == 0 && c->nest == 0);
+
+    code->next = c->s->code;
+    c->s->code = code;
+
+    return code;
+}
+
+/*
+ * Compile statement into bytecode unit
+ */
+vm_code *eval_compile_stmt(intend_state *s, stmt *st)
+{
+    compiler c;
+
+    sanity(st);
+
+    compile_begin(&c, s);
+    compile_stmt(&c, st);
+    return compile_end(&c);
+}
+
+/*
+ * Compile statement list into bytecode unit
+ */
+vm_code *eval_compile_list(intend_state *s, stmt_list *list)
+{
+    compiler c;
+
+    sanity(list);
+
+    compile_begin(&c, s);
+    compile_list(&c, list);
+    return compile_end(&c);
+}
+
+/*
+ * Free bytecode unit
+ */
+void eval_code_free(vm_code *code)
+{
+    if (!code) {
+        return;
+    }
+
+    free(code->instr);
+    free(code);
+}
+
+/*
+ * Free all bytecode units compiled in a state
+ */
+void eval_code_teardown(intend_state *s)
+{
+    vm_code *code, *next;
+
+    for (code = s->code; code; code = next) {
+        next = code->next;
+        eval_code_free(code);
+    }
+    s->code = NULL;
+}
@@ -33,9 +33,7 @@
  * Intend C Constant expressions
  */
 
-#include <ctype.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "eval.h"
 
@@ -52,9 +50,9 @@ value *eval_const_void(void)
  */
 value *eval_const_bool(expr *ex)
 {
-    sanity(ex);
+    sanity(ex && ex->cval);
 
-    return value_make_bool(strcmp(ex->name, "true") == 0);
+    return value_copy(ex->cval);
 }
 
 /*
@@ -62,143 +60,130 @@ value *eval_const_bool(expr *ex)
  */
 value *eval_const_int(expr *ex)
 {
-    sanity(ex);
+    sanity(ex && ex->cval);
 
-    return value_make_int(strtol(ex->name, NULL, 0));
+    return value_copy(ex->cval);
 }
 
 /*
  * Evaluate float constant
  */
 value *eval_const_float(expr *ex)
+{
+    sanity(ex && ex->cval);
+
+    return value_copy(ex->cval);
+}
+
+/*
+ * Evaluate string constant
+ *
+ * The parser leaves the value unset if the literal could not be
+ * unescaped.
+ */
+value *eval_const_string(intend_state *s, expr *ex)
 {
     sanity(ex);
 
-    return value_make_float(strtod(ex->name, NULL));
+    if (!ex->cval) {
+        fatal(s, "non-terminated string escape sequence");
+        return value_make_void();
+    }
+    return value_copy(ex->cval);
 }
 
 /*
- * Character code escape
+ * Evaluate expression for reading only
+ *
+ * Constant expressions hand out their decoded value directly
+ * instead of a copy. The result must not be modified and must be
+ * given back with eval_release().
  */
-static int charcode(char *orig, char **pos, int base, unsigned int maxlen)
+value *eval_expr_borrow(intend_state *s, expr *ex)
 {
-    long int res, len;
-    char tmp = 0;
-    char *endptr = orig;
+    sanity(ex);
 
-    if (strlen(orig) > maxlen) {
-        tmp = orig[maxlen];
-        orig[maxlen] = 0;
+    if (ex->cval && !s->except_flag && !s->exit_flag) {
+        s->source_line = ex->line;
+        s->source_file = ex->file;
+        return ex->cval;
     }
+    return eval_expr(s, ex);
+}
 
-    res = strtol(orig, &endptr, base);
-    if (endptr != orig) {
-        *(*pos) = res & 0xFF;
-        (*pos) += 1;
-        len = (endptr - orig) - 1;
-    } else {
-        len = 0;
+/*
+ * Release value from eval_expr_borrow()
+ */
+void eval_release(expr *ex, value *val)
+{
+    if (val != ex->cval) {
+        value_free(val);
     }
+}
+
+/*
+ * Evaluate expression for reading only, without allocating
+ *
+ * Like eval_expr_borrow(), with the results of other than constant
+ * expressions stored in the clean value cell, usually on the C
+ * stack. The result must be given back with eval_release_cell(),
+ * or turned into an allocated value with eval_box().
+ */
+value *eval_expr_cell(intend_state *s, expr *ex, value *cell)
+{
+    sanity(ex && cell);
 
-    if (tmp != 0) {
-        orig[maxlen] = tmp;
+    if (ex->cval && !s->except_flag && !s->exit_flag) {
+        s->source_line = ex->line;
+        s->source_file = ex->file;
+        return ex->cval;
     }
-    return len;
+    eval_expr_to(s, ex, cell);
+    return cell;
 }
 
 /*
- * Unescape special characters
+ * Release value from eval_expr_cell()
  */
-static char *unescape(intend_state *s, const char *orig, int *retlen)
+void eval_release_cell(expr *ex, value *val)
 {
-    char *raw, *pos;
-    int i, len, is_esc = 0, count = 0;
-
-    len = strlen(orig);
-
-    raw = oom(malloc(len + 1));
-    pos = raw;
-
-    for (i = 0; i < len + 1; i++) {
-        if (is_esc) {
-            switch (orig[i]) {
-                case 0:
-                    *retlen = 0;
-                    free(raw);
-                    fatal(s, "non-terminated string escape sequence");
-                    return NULL;
-                    break;
-                case '0':
-                    i += charcode((char *) & orig[i], &pos, 8, 4);
-                    break;
-                case 'b':
-                    *pos++ = '\b';
-                    break;
-                case 'd':
-                    i += charcode((char *) & orig[i+1], &pos, 10, 3) + 1;
-                    break;
-                case 'e':
-                    *pos++ = 27;
-                    break;
-                case 'f':
-                    *pos++ = '\f';
-                    break;
-                case 'n':
-                    *pos++ = '\n';
-                    break;
-                case 'o':
-                    i += charcode((char *) & orig[i+1], &pos, 8, 3) + 1;
-                    break;
-                case 'r':
-                    *pos++ = '\r';
-                    break;
-                case 't':
-                    *pos++ = '\t';
-                    break;
-                case 'x':
-                    i += charcode((char *) & orig[i+1], &pos, 16, 2) + 1;
-                    break;
-                default:
-                    if (isdigit(orig[i])) {
-                        i += charcode((char *) & orig[i], &pos, 8, 3);
-                    } else {
-                        *pos++ = orig[i];
-                    }
-            }
-            is_esc = 0;
-            count++;
-        } else {
-            switch (orig[i]) {
-                case 0:
-                    *pos = 0;
-                    i = len + 1;
-                    break;
-                case '\\':
-                    is_esc = 1;
-                    break;
-                default:
-                    *pos++ = orig[i];
-                    count++;
-            }
-        }
+    if (val != ex->cval) {
+        value_cleanup(val);
     }
-    *retlen = count;
-    return raw;
 }
 
 /*
- * Evaluate string constant
+ * Move value from eval_expr_cell() to allocated storage
+ *
+ * The result is given back like one from eval_expr_borrow().
  */
-value *eval_const_string(intend_state *s, expr *ex)
+value *eval_box(expr *ex, value *val)
 {
-    char *raw;
-    value *val;
-    int len;
+    value *res;
 
-    sanity(ex && ex->name);
+    if (val == ex->cval) {
+        return val;
+    }
+    res = value_alloc(VALUE_TYPE_VOID);
+    *res = *val;
+    return res;
+}
 
-    raw = unescape(s, ex->name, &len);
-    val = value_make_memstring(raw, len);
-    free(raw);
-    return val;
+/*
+ * Cast value from eval_expr_borrow()
+ *
+ * Borrowed constants are replaced by a converted copy, owned values
+ * are converted in place.
+ */
+void eval_cast_borrowed(intend_state *s, expr *ex, value **val,
+                        value_type type)
+{
+    if ((*val)->type == type) {
+        return;
+    }
+    if (*val == ex->cval) {
+        *val = value_cast(s, *val, type);
+    } else {
+        value_cast_inplace(s, val, type);
+    }
 }
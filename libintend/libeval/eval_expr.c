@@ -166,3 +166,50 @@ value *eval_expr(intend_state *s, expr *ex)
 
     return res;
 }
+
+/*
+ * Evaluate expression to pre-allocated value
+ *
+ * Like eval_expr(), with the result stored in the clean value res.
+ * Constants, variable references, in-place updates of variables and
+ * array elements, and operators on ints and floats store their
+ * result without allocating a value.
+ */
+void eval_expr_to(intend_state *s, expr *ex, value *res)
+{
+    sanity(ex && res);
+
+    if (s->except_flag || s->exit_flag) {
+        return;
+    }
+
+    s->source_line = ex->line;
+    s->source_file = ex->file;
+
+    switch (ex->type) {
+        case EXPR_ASSIGN:
+        case EXPR_ASSIGN_ARRAY:
+            eval_assign_to(s, ex, res);
+            break;
+        case EXPR_POSTFIX:
+            eval_postfix_to(s, ex, res);
+            break;
+        case EXPR_PREFIX:
+            eval_prefix_to(s, ex, res);
+            break;
+        case EXPR_REF:
+            eval_ref_to(s, ex, res);
+            break;
+        case EXPR_INFIX:
+            eval_infix_to(s, ex, res);
+            break;
+        case EXPR_CONST_BOOL:
+        case EXPR_CONST_INT:
+        case EXPR_CONST_FLOAT:
+            value_copy_to(res, ex->cval);
+            break;
+        default:
+            value_move_to(res, eval_expr(s, ex));
+            break;
+    }
+}
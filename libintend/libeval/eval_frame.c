@@ -0,0 +1,175 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Local variable resolution
+ */
+
+#include <stdlib.h>
+
+#include "eval.h"
+
+static void resolve_stmt(symtab_frame *frame, stmt *st, int try);
+
+/*
+ * Names that need argc and argv in the local symbol table
+ *
+ * Names only known at run time find them without, since the local
+ * symbol table adds them on such a lookup, see
+ * symtab_stack_set_args().
+ */
+static const char *varargs_names[] = {
+    "argc", "argv", NULL
+};
+
+/*
+ * Resolve names in expression
+ *
+ * Lambda expressions are function bodies of their own and are
+ * resolved when they are called.
+ */
+static void resolve_expr(symtab_frame *frame, expr *ex)
+{
+    unsigned int i;
+
+    if (!ex || ex->type == EXPR_LAMBDA) {
+        return;
+    }
+
+    switch (ex->type) {
+        case EXPR_REF:
+        case EXPR_REF_ARRAY:
+        case EXPR_ASSIGN:
+        case EXPR_ASSIGN_ARRAY:
+        case EXPR_CALL:
+            ex->slot = symtab_frame_add(frame, ex->name);
+            ex->frame = frame;
+            break;
+        default:
+            break;
+    }
+
+    resolve_expr(frame, ex->inner);
+    resolve_expr(frame, ex->index);
+    resolve_expr(frame, ex->elif);
+    for (i = 0; i < ex->argc; i++) {
+        resolve_expr(frame, ex->argv[i]);
+    }
+}
+
+/*
+ * Resolve names in statement list
+ */
+static void resolve_list(symtab_frame *frame, stmt_list *list, int try)
+{
+    unsigned int i;
+
+    if (!list) {
+        return;
+    }
+
+    for (i = 0; i < list->len; i++) {
+        resolve_stmt(frame, list->list[i], try);
+    }
+}
+
+/*
+ * Resolve names in statement
+ *
+ * Nested functions and classes run in symbol tables of their
+ * own and are left alone. Returns of calls are marked as tail
+ * calls unless they are inside a try block, which has to catch
+ * exceptions of the call before the function is left.
+ */
+static void resolve_stmt(symtab_frame *frame, stmt *st, int try)
+{
+    if (!st || st->type == STMT_FUNC || st->type == STMT_CLASS) {
+        return;
+    }
+
+    if (st->type == STMT_RETURN) {
+        st->tail = !try && st->expr && st->expr->type == EXPR_CALL;
+    }
+
+    resolve_expr(frame, st->init);
+    resolve_expr(frame, st->expr);
+    resolve_expr(frame, st->guard);
+    resolve_stmt(frame, st->true_case, try || st->type == STMT_TRY);
+    resolve_stmt(frame, st->false_case, try);
+    resolve_list(frame, (stmt_list *) st->block, try);
+}
+
+/*
+ * Check whether function body names argc or argv
+ */
+static int uses_varargs(symtab_frame *frame)
+{
+    unsigned int i;
+
+    for (i = 0; varargs_names[i]; i++) {
+        if (symtab_frame_find(frame, varargs_names[i],
+                              symtab_hash_symbol(varargs_names[i])) >= 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Get frame layout of function body
+ *
+ * On the first call, every variable and function name used in the
+ * body is given a slot, starting with the parameters. Names used
+ * only through dynamic lookups stay in the hash table of the
+ * local symbol table. The body is also marked if it names argc
+ * or argv.
+ */
+symtab_frame *eval_frame(stmt *body, char **names, unsigned int args)
+{
+    symtab_frame *frame;
+    unsigned int i;
+
+    sanity(body);
+
+    if (body->frame) {
+        return body->frame;
+    }
+
+    frame = symtab_frame_alloc();
+    for (i = 0; i < args; i++) {
+        symtab_frame_add(frame, names[i]);
+    }
+    resolve_stmt(frame, body, 0);
+
+    body->varargs = uses_varargs(frame);
+    body->frame = frame;
+    return frame;
+}
@@ -62,13 +62,13 @@ static int is_order(int op)
  * the other to the type of the constant. Otherwise, promote
  * the second value to the type of the first value.
  */
-static void promote_order(intend_state *s, value **one, value **two,
-                          int two_type)
+static void promote_order(intend_state *s, expr *ex, value **one,
+                          value **two)
 {
-    if (is_const(two_type)) {
-        value_cast_inplace(s, one, (*two)->type);
+    if (is_const(ex->index->type)) {
+        eval_cast_borrowed(s, ex->inner, one, (*two)->type);
     } else {
-        value_cast_inplace(s, two, (*one)->type);
+        eval_cast_borrowed(s, ex->index, two, (*one)->type);
     }
 }
 
@@ -88,15 +88,16 @@ static int is_math(int op)
  * Promotes both values to float is any one of them is float,
  * otherwise promotes both to int.
  */
-static void promote_math(intend_state *s, value **one, value **two)
+static void promote_math(intend_state *s, expr *ex, value **one,
+                         value **two)
 {
     if ((*one)->type == VALUE_TYPE_FLOAT ||
             (*two)->type == VALUE_TYPE_FLOAT) {
-        value_cast_inplace(s, one, VALUE_TYPE_FLOAT);
-        value_cast_inplace(s, two, VALUE_TYPE_FLOAT);
+        eval_cast_borrowed(s, ex->inner, one, VALUE_TYPE_FLOAT);
+        eval_cast_borrowed(s, ex->index, two, VALUE_TYPE_FLOAT);
     } else {
-        value_cast_inplace(s, one, VALUE_TYPE_INT);
-        value_cast_inplace(s, two, VALUE_TYPE_INT);
+        eval_cast_borrowed(s, ex->inner, one, VALUE_TYPE_INT);
+        eval_cast_borrowed(s, ex->index, two, VALUE_TYPE_INT);
     }
 }
 
@@ -115,10 +116,11 @@ static int is_bitwise(int op)
  *
  * Promotes both values to int.
  */
-static void promote_bitwise(intend_state *s, value **one, value **two)
+static void promote_bitwise(intend_state *s, expr *ex, value **one,
+                            value **two)
 {
-    value_cast_inplace(s, one, VALUE_TYPE_INT);
-    value_cast_inplace(s, two, VALUE_TYPE_INT);
+    eval_cast_borrowed(s, ex->inner, one, VALUE_TYPE_INT);
+    eval_cast_borrowed(s, ex->index, two, VALUE_TYPE_INT);
 }
 
 /*
@@ -134,41 +136,35 @@ static int is_string(value *val)
  *
  * Promotes both values to string.
  */
-static void promote_string(intend_state *s, value **one, value **two)
+static void promote_string(intend_state *s, expr *ex, value **one,
+                           value **two)
 {
     //value_cast_inplace(s, one, VALUE_TYPE_INT);
-    value_cast_inplace(s, two, VALUE_TYPE_STRING);
+    eval_cast_borrowed(s, ex->index, two, VALUE_TYPE_STRING);
 }
 
 /*
- * Evaluate infix operator
+ * Apply infix operator to evaluated operands
+ *
+ * Both operands are consumed, except when they are the borrowed
+ * values of constant operand expressions.
  */
-value *eval_infix(intend_state *s, expr *ex)
+value *eval_infix_values(intend_state *s, expr *ex, value *one, value *two)
 {
-    value *one, *two, *res = NULL;
-
-    sanity(ex);
-
-    if (ex->op == OPTYPE_BOOL_AND) {
-        return eval_bool_and(s, ex->inner, ex->index);
-    } else if (ex->op == OPTYPE_BOOL_OR) {
-        return eval_bool_or(s, ex->inner, ex->index);
-    }
-
-    one = eval_expr(s, ex->inner);
-    two = eval_expr(s, ex->index);
+    value *res = NULL;
+    op_type op = ex->op;
 
-    if (is_order(ex->op)) {
-        promote_order(s, &one, &two, ex->index->type);
-    } else if (is_math(ex->op) && !is_string(one)) {
-        promote_math(s, &one, &two);
-    } else if (is_bitwise(ex->op)) {
-        promote_bitwise(s, &one, &two);
+    if (is_order(op)) {
+        promote_order(s, ex, &one, &two);
+    } else if (is_math(op) && !is_string(one)) {
+        promote_math(s, ex, &one, &two);
+    } else if (is_bitwise(op)) {
+        promote_bitwise(s, ex, &one, &two);
     } else if (is_string(one)) {
-		promote_string(s, &one, &two);
+		promote_string(s, ex, &one, &two);
 	}
 
-    switch (ex->op) {
+    switch (op) {
         case OPTYPE_PLUS:
 			if(!is_string(one)) {
             	res = eval_math_plus(s, one, two);
@@ -235,7 +231,191 @@ value *eval_infix(intend_state *s, expr *ex)
             /* not handled here */
             break;
     }
-    value_free(one);
-    value_free(two);
+    eval_release(ex->inner, one);
+    eval_release(ex->index, two);
+    return res;
+}
+
+/*
+ * Apply infix operator to scalar operands
+ *
+ * Operators on two ints or two floats are evaluated without
+ * allocating a value: the result is stored in res, which may be
+ * one of the operands. Returns 0 if the operands need the general
+ * evaluation of eval_infix_values(), including divisions by zero.
+ */
+int eval_infix_scalar(expr *ex, value *one, value *two, value *res)
+{
+    int a, b, ires;
+    double x, y, fres;
+
+    if (one->type == VALUE_TYPE_INT && two->type == VALUE_TYPE_INT) {
+        a = INT_OF(one);
+        b = INT_OF(two);
+        switch (ex->op) {
+            case OPTYPE_PLUS:
+                ires = a + b;
+                break;
+            case OPTYPE_MINUS:
+                ires = a - b;
+                break;
+            case OPTYPE_MUL:
+                ires = a * b;
+                break;
+            case OPTYPE_DIV:
+                if (b == 0) {
+                    return 0;
+                }
+                ires = a / b;
+                break;
+            case OPTYPE_MOD:
+                if (b == 0) {
+                    return 0;
+                }
+                ires = a % b;
+                break;
+            case OPTYPE_AND:
+                ires = a & b;
+                break;
+            case OPTYPE_OR:
+                ires = a | b;
+                break;
+            case OPTYPE_XOR:
+                ires = a ^ b;
+                break;
+            case OPTYPE_LSHIFT:
+                ires = a << b;
+                break;
+            case OPTYPE_RSHIFT:
+                ires = a >> b;
+                break;
+            default:
+                x = a;
+                y = b;
+                goto order;
+        }
+        res->type = VALUE_TYPE_INT;
+        INT_OF(res) = ires;
+        return 1;
+    }
+
+    if (one->type != VALUE_TYPE_FLOAT || two->type != VALUE_TYPE_FLOAT) {
+        return 0;
+    }
+
+    x = FLOAT_OF(one);
+    y = FLOAT_OF(two);
+    switch (ex->op) {
+        case OPTYPE_PLUS:
+            fres = x + y;
+            break;
+        case OPTYPE_MINUS:
+            fres = x - y;
+            break;
+        case OPTYPE_MUL:
+            fres = x * y;
+            break;
+        case OPTYPE_DIV:
+            if (y == 0.0) {
+                return 0;
+            }
+            fres = x / y;
+            break;
+        default:
+            goto order;
+    }
+    res->type = VALUE_TYPE_FLOAT;
+    FLOAT_OF(res) = fres;
+    return 1;
+
+order:
+    /*
+     * values that are neither smaller nor larger are equal, as in
+     * eval_order.c
+     */
+    switch (ex->op) {
+        case OPTYPE_EQUAL:
+            ires = !(x < y) && !(x > y);
+            break;
+        case OPTYPE_NOT_EQUAL:
+            ires = x < y || x > y;
+            break;
+        case OPTYPE_SEQ:
+            ires = !(x > y);
+            break;
+        case OPTYPE_LEQ:
+            ires = !(x < y);
+            break;
+        case OPTYPE_SMALLER:
+            ires = x < y;
+            break;
+        case OPTYPE_LARGER:
+            ires = x > y;
+            break;
+        default:
+            return 0;
+    }
+    res->type = VALUE_TYPE_BOOL;
+    BOOL_OF(res) = ires;
+    return 1;
+}
+
+/*
+ * Evaluate infix operator
+ */
+value *eval_infix(intend_state *s, expr *ex)
+{
+    value *res;
+
+    sanity(ex);
+
+    if (ex->op == OPTYPE_BOOL_AND) {
+        return eval_bool_and(s, ex->inner, ex->index);
+    } else if (ex->op == OPTYPE_BOOL_OR) {
+        return eval_bool_or(s, ex->inner, ex->index);
+    }
+
+    res = value_alloc(VALUE_TYPE_VOID);
+    eval_infix_to(s, ex, res);
     return res;
 }
+
+/*
+ * Evaluate infix operator to pre-allocated value
+ *
+ * Like eval_infix(), with the result stored in the clean value res.
+ * The operands are evaluated into values on the C stack, so that
+ * operators on two ints or two floats allocate no value.
+ */
+void eval_infix_to(intend_state *s, expr *ex, value *res)
+{
+    value one_cell, two_cell, *one, *two;
+
+    sanity(ex && res);
+
+    if (ex->op == OPTYPE_BOOL_AND || ex->op == OPTYPE_BOOL_OR) {
+        value_move_to(res, eval_infix(s, ex));
+        return;
+    }
+
+    one_cell.type = VALUE_TYPE_VOID;
+    two_cell.type = VALUE_TYPE_VOID;
+    one = eval_expr_cell(s, ex->inner, &one_cell);
+    two = eval_expr_cell(s, ex->index, &two_cell);
+
+    /*
+     * Operands that raised an exception or a fatal error are
+     * void -- do not apply the operator to them
+     */
+    if (s->except_flag || s->exit_flag) {
+        eval_release_cell(ex->inner, one);
+        eval_release_cell(ex->index, two);
+        return;
+    }
+
+    if (eval_infix_scalar(ex, one, two, res)) {
+        return;
+    }
+    value_move_to(res, eval_infix_values(s, ex, eval_box(ex->inner, one),
+                                         eval_box(ex->index, two)));
+}
@@ -40,47 +40,162 @@
 
 /*
  * Enter struct namespace
+ *
+ * The struct is bound to the call, see value_bind(): the handle
+ * of the call holds it and `this' is updated in place. Nothing is
+ * bound if the receiver could not be, see bind_receiver().
  */
-static void enter_struct(intend_state *s, value *val)
+static void enter_struct(intend_state *s, value *val, int receiver)
 {
+    symtab_entry *entry;
+
     symtab_stack_enter(s);
-    symtab_stack_add_variable(s, "this", val);
+    entry = symtab_stack_add_variable(s, "this", val);
+    if (receiver >= 0) {
+        value_bind(val, VALUE_BIND_HOLD);
+        value_bind(&entry->entry_u.var, VALUE_BIND_WRITE);
+    }
 }
 
 /*
  * Leave struct namespace
  */
-static value *leave_struct(intend_state *s, signature *sig,
-                           unsigned int argc, expr **argv)
+static value *leave_struct(intend_state *s, signature *sig, expr **args,
+                           value **argv, call_refs *refs)
 {
     symtab_entry *entry;
+    symtab *sym;
     value *res = NULL;
 
     entry = symtab_stack_lookup(s, "this");
     if (entry) {
         res = value_copy(&entry->entry_u.var);
     }
-    update_call_args(s, sig, argc, argv);
+    sym = symtab_stack_pop(s);
+    update_call_args(s, sig, args, argv, refs, sym);
+    symtab_free(sym);
     return res;
 }
 
+/*
+ * Bind method call receiver
+ *
+ * The receiver is the variable or array element that the struct
+ * was read from and is stored back to after the call. It is bound
+ * to the call if possible, and then shares the updates of the
+ * method while it runs, see value_bind_storage(), which gives the
+ * result. Without such a receiver, the struct is only bound if
+ * no other call holds it: -1 is returned otherwise, and 0 if it
+ * is free.
+ */
+static int bind_receiver(intend_state *s, expr *ex, value *val)
+{
+    value *target;
+    lvalue lv;
+
+    target = NULL;
+    if (ex->type == EXPR_REF ||
+            (ex->type == EXPR_REF_ARRAY && eval_is_pure(ex))) {
+        target = eval_lvalue(s, ex, &lv);
+    }
+    if (!target || target->type != VALUE_TYPE_STRUCT ||
+            STRUCT_OF(target) != STRUCT_OF(val)) {
+        return STRUCTBOUND_OF(val) > 0 ? -1 : 0;
+    }
+    return value_bind_storage(target);
+}
+
+/*
+ * Unbind method call receiver
+ *
+ * The receiver is unbound when the struct is stored back to it.
+ * This is for calls that lost `this' and do not store back.
+ */
+static void unbind_receiver(intend_state *s, expr *ex)
+{
+    value *target;
+    lvalue lv;
+
+    target = eval_lvalue(s, ex, &lv);
+    if (target && BIND_OF(target) == VALUE_BIND_HOLD) {
+        value_unbind(target);
+    }
+}
+
+/*
+ * Check member initializer for constant value
+ */
+static int is_static_expr(expr *ex)
+{
+    if (ex->cval) {
+        return 1;
+    }
+
+    switch (ex->type) {
+        case EXPR_INFIX:
+            return is_static_expr(ex->inner) && is_static_expr(ex->index);
+        case EXPR_PREFIX:
+            return (ex->op == OPTYPE_MINUS || ex->op == OPTYPE_NOT ||
+                    ex->op == OPTYPE_NEG) && is_static_expr(ex->inner);
+        case EXPR_CAST:
+            return is_static_expr(ex->inner);
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Check class definition for static members
+ *
+ * A class body that only defines methods and initializes members
+ * with constant expressions builds the same members every time.
+ */
+static int is_static_class(symtab_entry *entry)
+{
+    stmt_list *list;
+    stmt *st;
+    unsigned int i;
+
+    if (entry->entry_u.cls.type != CLASS_TYPE_USERDEF) {
+        return 1;
+    }
+
+    list = (stmt_list *) entry->entry_u.cls.definition;
+    for (i = 0; i < list->len; i++) {
+        st = list->list[i];
+        if (st->type == STMT_FUNC) {
+            continue;
+        }
+        if (st->type != STMT_EXPR || st->expr->type != EXPR_ASSIGN ||
+                !is_static_expr(st->expr->inner)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
 /*
  * Recursively construct instance
+ *
+ * The flag is cleared if any class of the chain is not static.
  */
-static void getinstance(intend_state *s, const char *name)
+static void getinstance(intend_state *s, const char *name, int *fixed)
 {
     symtab_entry *entry;
 
-    entry = symtab_stack_lookup(s, name);
+    entry = symtab_lookup(s->global_table, name);
     if (!entry || entry->type != SYMTAB_ENTRY_CLASS) {
         fatal(s, "use of undefined class `%s'", name);
         return;
     }
+    if (!is_static_class(entry)) {
+        *fixed = 0;
+    }
     if (entry->entry_u.cls.parent) {
-        getinstance(s, entry->entry_u.cls.parent);
+        getinstance(s, entry->entry_u.cls.parent, fixed);
     }
     if (entry->entry_u.cls.type == CLASS_TYPE_USERDEF) {
-        eval_stmt_list(s, (stmt_list *) entry->entry_u.cls.definition, 0);
+        eval_run_list(s, (stmt_list *) entry->entry_u.cls.definition, 0);
     } else {
         // The class is builtin, so register it
         symtab_stack_add_function(s, entry->symbol, entry->entry_u.cls.constructor);
@@ -94,45 +209,123 @@ static void getinstance(intend_state *s, const char *name)
 }
 
 /*
- * Evaluate constructor expression
+ * Get class prototype
+ *
+ * Returns a struct with the members of the class and its parents
+ * and `__class' set, or NULL if the class definitions raised an
+ * exception. The name of the constructor, if any, is stored in
+ * cons. Class lookups always end in the global table, so when
+ * the whole chain is static, the struct is kept in the class entry
+ * and shared until the global table changes again.
  */
-value *eval_new(intend_state *s, expr *ex)
+static value *getproto(intend_state *s, const char *name, const char **cons)
 {
+    symtab *global = s->global_table;
+    symtab_entry *entry;
     value *res, *tname;
-
-    sanity(ex && ex->name);
+    int fixed = 1;
+
+    entry = symtab_lookup(global, name);
+    if (entry && entry->type == SYMTAB_ENTRY_CLASS &&
+            entry->entry_u.cls.proto &&
+            entry->entry_u.cls.proto_version == global->version) {
+        *cons = entry->entry_u.cls.proto_cons;
+        return value_copy(entry->entry_u.cls.proto);
+    }
 
     symtab_stack_enter(s);
     s->new_cons = NULL;
     s->new_sig  = NULL;
-    getinstance(s, ex->name);
+    getinstance(s, name, &fixed);
 
     if (s->except_flag || s->exit_flag) {
         symtab_stack_leave(s);
-        return value_make_void();
+        return NULL;
     }
 
     res = value_make_struct();
     symtab_free(res->value_u.struct_val);
     res->value_u.struct_val = symtab_stack_pop(s);
+    symtab_shape_build(res->value_u.struct_val);
 
-    tname = value_make_string(ex->name);
+    tname = value_make_string(name);
     value_set_struct(res, "__class", tname);
     value_free(tname);
 
-    if (s->new_cons) {
+    *cons = s->new_cons;
+    if (!fixed || !entry) {
+        return res;
+    }
+
+    if (entry->entry_u.cls.proto) {
+        value_free(entry->entry_u.cls.proto);
+    }
+    if (entry->entry_u.cls.proto_cons) {
+        free(entry->entry_u.cls.proto_cons);
+    }
+    entry->entry_u.cls.proto = value_copy(res);
+    entry->entry_u.cls.proto_version = global->version;
+    entry->entry_u.cls.proto_cons = *cons ? xstrdup(*cons) : NULL;
+    *cons = entry->entry_u.cls.proto_cons;
+
+    return res;
+}
+
+/*
+ * Get method of class prototype
+ */
+static signature *getmethod(value *proto, const char *name)
+{
+    symtab_entry *entry;
+
+    entry = symtab_lookup(proto->value_u.struct_val, name);
+    if (!entry || entry->type != SYMTAB_ENTRY_FUNCTION) {
+        return NULL;
+    }
+    return &(entry->entry_u.fnc.sigs[0]);
+}
+
+/*
+ * Evaluate constructor expression
+ *
+ * The constructor runs on a copy of the class prototype, which
+ * gets fields of its own first, so that no update of the instance
+ * can reach the cached prototype. The signature of the constructor
+ * stays valid while the instance is held in res.
+ */
+value *eval_new(intend_state *s, expr *ex)
+{
+    const char *cons = NULL;
+    signature *sig = NULL;
+    value *res;
+
+    sanity(ex && ex->name);
+
+    res = getproto(s, ex->name, &cons);
+    if (!res) {
+        return value_make_void();
+    }
+    value_detach(res);
+
+    if (cons) {
+        sig = getmethod(res, cons);
+    }
+
+    if (sig) {
         value **argv;
-        value *temp, *cons;
+        value *temp, *ret;
+        call_refs refs;
 
         eval_call_args(s, ex->argc, ex->argv, &argv);
-        enter_struct(s, res);
+        bind_call_args(s, sig, ex->argc, ex->argv, argv, &refs);
+        enter_struct(s, res, STRUCTBOUND_OF(res) > 0 ? -1 : 0);
 
-        cons = call_function(s, s->new_sig, ex->argc, argv);
-        value_free(cons);
+        ret = call_function(s, sig, ex->argc, argv);
+        value_free(ret);
 
-        temp = leave_struct(s, s->new_sig, ex->argc, ex->argv);
+        temp = leave_struct(s, sig, ex->argv, argv, &refs);
         if (!temp) {
-            fatal(s, "no `this' at constructor `%s' exit", s->new_cons);
+            fatal(s, "no `this' at constructor `%s' exit", cons);
             temp = value_make_void();
         }
         free_call_args(s, ex->argc, &argv);
@@ -149,37 +342,37 @@ value *eval_new(intend_state *s, expr *ex)
  */
 value *eval_static(intend_state *s, expr *ex)
 {
-    symtab_entry *entry;
+    const char *cons;
     signature *sig;
-    value **argv, *res;
+    value **argv, *proto, *res;
+    call_refs refs;
+    symtab *sym;
 
     sanity(ex && ex->tname && ex->name);
 
-    symtab_stack_enter(s);
-    getinstance(s, ex->tname);
-
-    if (s->except_flag || s->exit_flag) {
-        symtab_stack_leave(s);
+    proto = getproto(s, ex->tname, &cons);
+    if (!proto) {
         return value_make_void();
     }
 
-    entry = symtab_stack_lookup(s, ex->name);
-    if (!entry || entry->type != SYMTAB_ENTRY_FUNCTION ||
-            !symtab_stack_local(s, ex->name)) {
+    sig = getmethod(proto, ex->name);
+    if (!sig) {
         fatal(s, "call to undefined method `%s::%s'", ex->tname, ex->name);
-        symtab_stack_leave(s);
+        value_free(proto);
         return value_make_void();
     }
-    sig = &(entry->entry_u.fnc.sigs[0]);
-    symtab_stack_leave(s);
 
     eval_call_args(s, ex->argc, ex->argv, &argv);
+    bind_call_args(s, sig, ex->argc, ex->argv, argv, &refs);
     symtab_stack_enter(s);
 
     res = call_function(s, sig, ex->argc, argv);
-    update_call_args(s, sig, ex->argc, ex->argv);
+    sym = symtab_stack_pop(s);
+    update_call_args(s, sig, ex->argv, argv, &refs, sym);
+    symtab_free(sym);
 
     free_call_args(s, ex->argc, &argv);
+    value_free(proto);
 
     return res;
 }
@@ -189,21 +382,22 @@ value *eval_static(intend_state *s, expr *ex)
  */
 value *eval_static_ref(intend_state *s, expr *ex)
 {
-    symtab *sym;
+    const char *cons;
     symtab_entry *entry;
-    value *res;
+    value *proto, *res;
 
     sanity(ex && ex->tname && ex->name);
 
-    symtab_stack_enter(s);
-    getinstance(s, ex->tname);
-    sym = symtab_stack_pop(s);
+    proto = getproto(s, ex->tname, &cons);
+    if (!proto) {
+        return value_make_void();
+    }
 
-    entry = symtab_lookup(sym, ex->name);
+    entry = symtab_lookup(proto->value_u.struct_val, ex->name);
     if (!entry) {
         fatal(s, "use of undefined class member `%s::%s'", ex->tname,
               ex->name);
-        symtab_free(sym);
+        value_free(proto);
         return value_make_void();
     }
     if (entry->type == SYMTAB_ENTRY_VAR) {
@@ -211,7 +405,7 @@ value *eval_static_ref(intend_state *s, expr *ex)
     } else {
         res = value_make_fn(&(entry->entry_u.fnc.sigs[0]));
     }
-    symtab_free(sym);
+    value_free(proto);
     return res;
 }
 
@@ -221,7 +415,10 @@ value *eval_static_ref(intend_state *s, expr *ex)
 value *eval_method(intend_state *s, expr *ex)
 {
     symtab_entry *entry;
+    signature *sig;
     value *val, *res, *temp, **argv;
+    call_refs refs;
+    int bound;
 
     sanity(ex && ex->inner && ex->name);
 
@@ -232,30 +429,36 @@ value *eval_method(intend_state *s, expr *ex)
         return value_make_void();
     }
 
-    entry = symtab_lookup(val->value_u.struct_val, ex->name);
+    entry = eval_cache_method(s, ex, val->value_u.struct_val);
     if (!entry || entry->type != SYMTAB_ENTRY_FUNCTION) {
         value_free(val);
         fatal(s, "call to undefined method `%s'", ex->name);
         return value_make_void();
     }
 
+    sig = &(entry->entry_u.fnc.sigs[0]);
     eval_call_args(s, ex->argc, ex->argv, &argv);
-    enter_struct(s, val);
+    bind_call_args(s, sig, ex->argc, ex->argv, argv, &refs);
+    bound = bind_receiver(s, ex->inner, val);
+    enter_struct(s, val, bound);
 
-    res = call_function(s, &(entry->entry_u.fnc.sigs[0]), ex->argc, argv);
+    res = call_function(s, sig, ex->argc, argv);
 
-    temp = leave_struct(s, &(entry->entry_u.fnc.sigs[0]), ex->argc, ex->argv);
+    temp = leave_struct(s, sig, ex->argv, argv, &refs);
     free_call_args(s, ex->argc, &argv);
 
     value_free(val);
 
+    if (!temp && bound > 0) {
+        unbind_receiver(s, ex->inner);
+    }
+
     if (temp) {
         if (ex->inner->type == EXPR_REF) {
-            symtab_stack_add_variable(s, ex->inner->name, temp);
+            eval_store(s, ex->inner, temp);
         }
         if (ex->inner->type == EXPR_REF_ARRAY) {
-            eval_assign_array_direct(s, ex->inner->name, ex->inner->argc,
-                                     ex->inner->argv, temp);
+            eval_assign_array_direct(s, ex->inner, temp);
         }
         value_free(temp);
     }
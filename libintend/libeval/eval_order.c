@@ -74,6 +74,7 @@ static int getorder(value *a, value *b)
     switch (a->type) {
         case VALUE_TYPE_VOID:
             res = ORDER_EQUAL;
+            break;
         case VALUE_TYPE_BOOL:
             if (BOOL_OF(a) < BOOL_OF(b)) {
                 res = ORDER_SMALLER;
@@ -145,16 +146,21 @@ static int getorder(value *a, value *b)
 }
 
 /*
- * Evaluate equality operator
+ * Check values for equality
  */
-value *eval_order_equal(value *a, value *b)
+int eval_order_is_equal(value *a, value *b)
 {
-    int res;
-
     sanity(a && b);
 
-    res = (a->type == b->type && getorder(a, b) == ORDER_EQUAL);
-    return value_make_bool(res);
+    return a->type == b->type && getorder(a, b) == ORDER_EQUAL;
+}
+
+/*
+ * Evaluate equality operator
+ */
+value *eval_order_equal(value *a, value *b)
+{
+    return value_make_bool(eval_order_is_equal(a, b));
 }
 
 /*
@@ -40,11 +40,10 @@
 /*
  * Evaluate post-increment operator
  */
-static value *postincrement(intend_state *s, expr *ex)
+static value *postincrement(intend_state *s, expr *ex, value *val)
 {
-    value *val, *copy;
+    value *copy;
 
-    val = eval_expr(s, ex);
     value_cast_inplace(s, &val, VALUE_TYPE_INT);
 
     copy = value_make_int(INT_OF(val));
@@ -53,9 +52,9 @@ static value *postincrement(intend_state *s, expr *ex)
 
     if (!s->except_flag && !s->exit_flag) {
         if (ex->type == EXPR_REF) {
-            symtab_stack_add_variable(s, ex->name, val);
+            eval_store(s, ex, val);
         } else if (ex->type == EXPR_REF_ARRAY) {
-            eval_assign_array_direct(s, ex->name, ex->argc, ex->argv, val);
+            eval_assign_array_direct(s, ex, val);
         }
     }
     value_free(val);
@@ -66,11 +65,10 @@ static value *postincrement(intend_state *s, expr *ex)
 /*
  * Evaluate post-decrement operator
  */
-static value *postdecrement(intend_state *s, expr *ex)
+static value *postdecrement(intend_state *s, expr *ex, value *val)
 {
-    value *val, *copy;
+    value *copy;
 
-    val = eval_expr(s, ex);
     value_cast_inplace(s, &val, VALUE_TYPE_INT);
 
     copy = value_make_int(INT_OF(val));
@@ -79,9 +77,9 @@ static value *postdecrement(intend_state *s, expr *ex)
 
     if (!s->except_flag && !s->exit_flag) {
         if (ex->type == EXPR_REF) {
-            symtab_stack_add_variable(s, ex->name, val);
+            eval_store(s, ex, val);
         } else if (ex->type == EXPR_REF_ARRAY) {
-            eval_assign_array_direct(s, ex->name, ex->argc, ex->argv, val);
+            eval_assign_array_direct(s, ex, val);
         }
     }
     value_free(val);
@@ -90,23 +88,112 @@ static value *postdecrement(intend_state *s, expr *ex)
 }
 
 /*
- * Evaluate postfix operator
+ * Apply postfix operator to evaluated operand
+ *
+ * The operand value is consumed and must be the result of
+ * evaluating the inner expression of the given postfix expression.
  */
-value *eval_postfix(intend_state *s, expr *ex)
+value *eval_postfix_value(intend_state *s, expr *ex, value *val)
 {
     value *res = NULL;
 
-    sanity(ex);
+    sanity(ex && val);
 
     switch (ex->op) {
         case OPTYPE_POSTINC:
-            res = postincrement(s, ex->inner);
+            res = postincrement(s, ex->inner, val);
             break;
         case OPTYPE_POSTDEC:
-            res = postdecrement(s, ex->inner);
+            res = postdecrement(s, ex->inner, val);
             break;
         default:
             sanity(0);
     }
     return res;
 }
+
+/*
+ * Evaluate post-increment or post-decrement in place
+ *
+ * The storage of the operand is resolved once and updated
+ * directly, and the result is stored in the clean value res.
+ * Returns 0 if the operand cannot be updated in place and must be
+ * evaluated as a value.
+ */
+static int postfix_inplace(intend_state *s, expr *ex, value *res)
+{
+    value *target, *val;
+    lvalue lv;
+
+    target = eval_lvalue(s, ex->inner, &lv);
+    if (!target) {
+        return s->except_flag || s->exit_flag;
+    }
+
+    if (target->type != VALUE_TYPE_INT) {
+        val = value_cast(s, target, VALUE_TYPE_INT);
+        if (s->except_flag || s->exit_flag) {
+            value_free(val);
+            return 1;
+        }
+        value_copy_to(target, val);
+        value_free(val);
+    }
+
+    res->type = VALUE_TYPE_INT;
+    INT_OF(res) = INT_OF(target);
+
+    if (ex->op == OPTYPE_POSTINC) {
+        ++INT_OF(target);
+    } else {
+        --INT_OF(target);
+    }
+
+    eval_lvalue_store(s, ex->inner, target, &lv);
+    return 1;
+}
+
+/*
+ * Check for in-place postfix operator
+ */
+int eval_postfix_inplace(expr *ex)
+{
+    sanity(ex);
+
+    return ex->inner->type == EXPR_REF || ex->inner->type == EXPR_REF_ARRAY;
+}
+
+/*
+ * Evaluate postfix operator to pre-allocated value
+ *
+ * Like eval_postfix(), with the result stored in the clean value
+ * res.
+ */
+void eval_postfix_to(intend_state *s, expr *ex, value *res)
+{
+    sanity(ex && res);
+
+    if (eval_postfix_inplace(ex) && postfix_inplace(s, ex, res)) {
+        return;
+    }
+    value_move_to(res, eval_postfix_value(s, ex, eval_expr(s, ex->inner)));
+}
+
+/*
+ * Evaluate postfix operator
+ */
+value *eval_postfix(intend_state *s, expr *ex)
+{
+    value *res;
+
+    sanity(ex);
+
+    if (eval_postfix_inplace(ex)) {
+        res = value_alloc(VALUE_TYPE_VOID);
+        if (postfix_inplace(s, ex, res)) {
+            return res;
+        }
+        value_free(res);
+    }
+    return eval_postfix_value(s, ex, eval_expr(s, ex->inner));
+}
@@ -53,11 +53,8 @@ static void promote_prefix(intend_state *s, value **one, int allow_float)
 /*
  * Evaluate unary minus operator
  */
-static value *unary_minus(intend_state *s, expr *ex)
+static value *unary_minus(intend_state *s, value *val)
 {
-    value *val;
-
-    val = eval_expr(s, ex);
     promote_prefix(s, &val, 1);
 
     if (val->type == VALUE_TYPE_INT) {
@@ -71,11 +68,8 @@ static value *unary_minus(intend_state *s, expr *ex)
 /*
  * Evaluate logical NOT operator
  */
-static value *logical_not(intend_state *s, expr *ex)
+static value *logical_not(intend_state *s, value *val)
 {
-    value *val;
-
-    val = eval_expr(s, ex);
     value_cast_inplace(s, &val, VALUE_TYPE_BOOL);
 
     BOOL_OF(val) ^= 1;
@@ -86,20 +80,17 @@ static value *logical_not(intend_state *s, expr *ex)
 /*
  * Evaluate pre-increment operator
  */
-static value *preincrement(intend_state *s, expr *ex)
+static value *preincrement(intend_state *s, expr *ex, value *val)
 {
-    value *val;
-
-    val = eval_expr(s, ex);
     promote_prefix(s, &val, 0);
 
     ++INT_OF(val);
 
     if (!s->except_flag && !s->exit_flag) {
         if (ex->type == EXPR_REF) {
-            symtab_stack_add_variable(s, ex->name, val);
+            eval_store(s, ex, val);
         } else if (ex->type == EXPR_REF_ARRAY) {
-            eval_assign_array_direct(s, ex->name, ex->argc, ex->argv, val);
+            eval_assign_array_direct(s, ex, val);
         }
     }
 
@@ -109,20 +100,17 @@ static value *preincrement(intend_state *s, expr *ex)
 /*
  * Evaluate pre-decrement operator
  */
-static value *predecrement(intend_state *s, expr *ex)
+static value *predecrement(intend_state *s, expr *ex, value *val)
 {
-    value *val;
-
-    val = eval_expr(s, ex);
     promote_prefix(s, &val, 0);
 
     --INT_OF(val);
 
     if (!s->except_flag && !s->exit_flag) {
         if (ex->type == EXPR_REF) {
-            symtab_stack_add_variable(s, ex->name, val);
+            eval_store(s, ex, val);
         } else if (ex->type == EXPR_REF_ARRAY) {
-            eval_assign_array_direct(s, ex->name, ex->argc, ex->argv, val);
+            eval_assign_array_direct(s, ex, val);
         }
     }
 
@@ -132,11 +120,8 @@ static value *predecrement(intend_state *s, expr *ex)
 /*
  * Evaluate bit-negation operator
  */
-value *negate(intend_state *s, expr *ex)
+value *negate(intend_state *s, value *val)
 {
-    value *val;
-
-    val = eval_expr(s, ex);
     promote_prefix(s, &val, 0);
 
     INT_OF(val) = ~ INT_OF(val);
@@ -145,32 +130,125 @@ value *negate(intend_state *s, expr *ex)
 }
 
 /*
- * Evaluate prefix operator
+ * Apply prefix operator to evaluated operand
+ *
+ * The operand value is consumed and must be the result of
+ * evaluating the inner expression of the given prefix expression.
  */
-value *eval_prefix(intend_state *s, expr *ex)
+value *eval_prefix_value(intend_state *s, expr *ex, value *val)
 {
     value *res = NULL;
 
-    sanity(ex);
+    sanity(ex && val);
 
     switch (ex->op) {
         case OPTYPE_MINUS:
-            res = unary_minus(s, ex->inner);
+            res = unary_minus(s, val);
             break;
         case OPTYPE_NOT:
-            res = logical_not(s, ex->inner);
+            res = logical_not(s, val);
             break;
         case OPTYPE_PREINC:
-            res = preincrement(s, ex->inner);
+            res = preincrement(s, ex->inner, val);
             break;
         case OPTYPE_PREDEC:
-            res = predecrement(s, ex->inner);
+            res = predecrement(s, ex->inner, val);
             break;
         case OPTYPE_NEG:
-            res = negate(s, ex->inner);
+            res = negate(s, val);
             break;
         default:
             sanity(0);
     }
     return res;
 }
+
+/*
+ * Evaluate pre-increment or pre-decrement in place
+ *
+ * The storage of the operand is resolved once and updated
+ * directly, and the result is stored in the clean value res.
+ * Returns 0 if the operand cannot be updated in place and must be
+ * evaluated as a value.
+ */
+static int prefix_inplace(intend_state *s, expr *ex, value *res)
+{
+    value *target, *val;
+    lvalue lv;
+
+    target = eval_lvalue(s, ex->inner, &lv);
+    if (!target) {
+        return s->except_flag || s->exit_flag;
+    }
+
+    if (target->type != VALUE_TYPE_INT) {
+        val = value_cast(s, target, VALUE_TYPE_INT);
+        if (s->except_flag || s->exit_flag) {
+            value_free(val);
+            return 1;
+        }
+        value_copy_to(target, val);
+        value_free(val);
+    }
+
+    if (ex->op == OPTYPE_PREINC) {
+        ++INT_OF(target);
+    } else {
+        --INT_OF(target);
+    }
+
+    res->type = VALUE_TYPE_INT;
+    INT_OF(res) = INT_OF(target);
+    eval_lvalue_store(s, ex->inner, target, &lv);
+    return 1;
+}
+
+/*
+ * Check for in-place prefix operator
+ *
+ * Increments and decrements of variables and array elements
+ * update their operand in place.
+ */
+int eval_prefix_inplace(expr *ex)
+{
+    sanity(ex);
+
+    return (ex->op == OPTYPE_PREINC || ex->op == OPTYPE_PREDEC) &&
+           (ex->inner->type == EXPR_REF ||
+            ex->inner->type == EXPR_REF_ARRAY);
+}
+
+/*
+ * Evaluate prefix operator to pre-allocated value
+ *
+ * Like eval_prefix(), with the result stored in the clean value
+ * res.
+ */
+void eval_prefix_to(intend_state *s, expr *ex, value *res)
+{
+    sanity(ex && res);
+
+    if (eval_prefix_inplace(ex) && prefix_inplace(s, ex, res)) {
+        return;
+    }
+    value_move_to(res, eval_prefix_value(s, ex, eval_expr(s, ex->inner)));
+}
+
+/*
+ * Evaluate prefix operator
+ */
+value *eval_prefix(intend_state *s, expr *ex)
+{
+    value *res;
+
+    sanity(ex);
+
+    if (eval_prefix_inplace(ex)) {
+        res = value_alloc(VALUE_TYPE_VOID);
+        if (prefix_inplace(s, ex, res)) {
+            return res;
+        }
+        value_free(res);
+    }
+    return eval_prefix_value(s, ex, eval_expr(s, ex->inner));
+}
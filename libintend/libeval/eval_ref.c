@@ -38,16 +38,67 @@
 
 #include "eval.h"
 
+/*
+ * Look up symbol named by expression
+ *
+ * Names resolved to a frame slot skip the local symbol table
+ * lookup, all others are found by their interned name.
+ */
+symtab_entry *eval_lookup(intend_state *s, expr *ex)
+{
+    sanity(ex && ex->name);
+
+    return symtab_stack_lookup_slot(s, ex->frame, ex->slot, ex->name);
+}
+
+/*
+ * Evaluate variable reference to pre-allocated value
+ *
+ * Like eval_ref(), with the result stored in the clean value res.
+ */
+void eval_ref_to(intend_state *s, expr *ex, value *res)
+{
+    symtab_entry *entry;
+
+    sanity(ex && ex->name && res);
+
+    entry = eval_lookup(s, ex);
+    if (!entry || entry->type == SYMTAB_ENTRY_CLASS) {
+        return;
+    }
+    if (entry->type == SYMTAB_ENTRY_VAR) {
+        value_copy_to(res, &entry->entry_u.var);
+    } else {
+        value_move_to(res, value_make_fn(&(entry->entry_u.fnc.sigs[0])));
+    }
+}
+
 /*
  * Evaluate variable reference
  */
 value *eval_ref(intend_state *s, expr *ex)
 {
-    symtab_entry *entry;
+    value *res;
 
     sanity(ex && ex->name);
 
-    entry = symtab_stack_lookup(s, ex->name);
+    res = value_alloc(VALUE_TYPE_VOID);
+    eval_ref_to(s, ex, res);
+    return res;
+}
+
+/*
+ * Get struct field
+ *
+ * Like value_get_struct(), with the lookup cached in the field
+ * expression.
+ */
+static value *field_get(intend_state *s, value *st, expr *index,
+                        const char *name)
+{
+    symtab_entry *entry;
+
+    entry = eval_cache_field(s, index, STRUCT_OF(st), name);
     if (!entry || entry->type == SYMTAB_ENTRY_CLASS) {
         return value_make_void();
     }
@@ -74,20 +125,20 @@ static value *array_get(intend_state *s, value *arr, int argc, expr **index)
         return value_make_void();
     }
 
-    pos = eval_expr(s, index[0]);
+    pos = eval_expr_borrow(s, index[0]);
     if (is_struct) {
         realidx = STR_OF(pos);
     } else {
         if (TYPE_OF(pos) == VALUE_TYPE_STRING) {
             realidx = STR_OF(pos);
         } else {
-            value_cast_inplace(s, &pos, VALUE_TYPE_INT);
+            eval_cast_borrowed(s, index[0], &pos, VALUE_TYPE_INT);
             realpos = INT_OF(pos);
         }
     }
 
     if (is_struct) {
-        val = value_get_struct(arr, realidx);
+        val = field_get(s, arr, index[0], realidx);
     } else {
         if (realidx) {
             val = value_get_key_array(arr, realidx);
@@ -95,7 +146,7 @@ static value *array_get(intend_state *s, value *arr, int argc, expr **index)
             val = value_get_array(arr, realpos);
         }
     }
-    value_free(pos);
+    eval_release(index[0], pos);
 
     if (argc == 1) {
         return val;
@@ -115,8 +166,7 @@ value *eval_ref_array(intend_state *s, expr *ex)
     symtab_entry *entry;
 
     sanity(ex && ex->name);
-
-    entry = symtab_stack_lookup(s, ex->name);
+    entry = eval_lookup(s, ex);
     if (!entry || entry->type != SYMTAB_ENTRY_VAR) {
         return value_make_void();
     }
@@ -39,6 +39,9 @@
 
 #include "eval.h"
 
+static value *run_func(intend_state *s, void *data, void *def,
+                       unsigned int args, unsigned int argc, value **argv);
+
 /*
  * Evaluate statement list
  *
@@ -71,10 +74,17 @@ void eval_stmt_list(intend_state *s, stmt_list *list, int cookie)
  */
 static int runtest(intend_state *s, expr *ex)
 {
-    value *val;
+    value cell, *val;
     int res;
 
-    val = eval_expr(s, ex);
+    cell.type = VALUE_TYPE_VOID;
+    eval_expr_to(s, ex, &cell);
+    if (cell.type == VALUE_TYPE_BOOL) {
+        return BOOL_OF(&cell);
+    }
+
+    val = value_alloc(VALUE_TYPE_VOID);
+    *val = cell;
     value_cast_inplace(s, &val, VALUE_TYPE_BOOL);
     res = BOOL_OF(val);
     value_free(val);
@@ -82,11 +92,29 @@ static int runtest(intend_state *s, expr *ex)
     return res;
 }
 
+/*
+ * Evaluate expression for its side effects
+ *
+ * The result is stored on the C stack, so that assignments and
+ * updates of ints and floats allocate no value.
+ */
+static void discard(intend_state *s, expr *ex)
+{
+    value cell;
+
+    cell.type = VALUE_TYPE_VOID;
+    eval_expr_to(s, ex, &cell);
+    value_cleanup(&cell);
+}
+
 /*
  * Put function arguments into symbol table
  *
  * This function adds variables named "argc" and "argv" to the
- * current function's symbol table.
+ * current function's symbol table. It is only called for bodies
+ * that name them. Other bodies keep the arguments with the symbol
+ * table, which adds both variables only if they are asked for by
+ * a name known at run time, since the array copies all arguments.
  */
 static void varargs(intend_state *s, unsigned int argc, value **argv)
 {
@@ -105,42 +133,61 @@ static void varargs(intend_state *s, unsigned int argc, value **argv)
 }
 
 /*
- * Run user-defined function
+ * Set up local symbol table of user-defined function
  *
- * This function runs a user-defined function by creating a new
- * symbol table, adding the function parameters as variables, and
- * then executing the function body. This function is implicitly
- * called from eval_call.c::eval_call(), via call_func() from
- * libruntime.
+ * Attaches the frame layout of the body to the topmost local
+ * symbol table and adds the function parameters as variables.
+ * An argument bound to the call for update hands the binding on
+ * to its parameter, see bind_call_args().
  */
-static value *run_func(intend_state *s, void *data, void *def,
+static void enter_func(intend_state *s, char **names, stmt *st,
                        unsigned int args, unsigned int argc, value **argv)
 {
-    char **names = (char **) data;
-    stmt *st = (stmt *) def;
+    symtab_entry *entry;
     unsigned int i;
-    int cookie;
-
-    sanity(def && argc >= args && (argc == 0 || argv));
 
-    if (++s->func_flag < 1) {
-        fatal(s, "too deep function call nesting");
-        return value_make_void();
+    symtab_stack_attach_frame(s, eval_frame(st, names, args));
+    if (st->varargs) {
+        varargs(s, argc, argv);
     }
 
-    varargs(s, argc, argv);
-
     for (i = 0; i < args; i++) {
-        symtab_stack_add_variable(s, names[i], argv[i]);
+        entry = symtab_stack_add_variable(s, names[i], argv[i]);
+        if ((argv[i]->type == VALUE_TYPE_ARRAY ||
+             argv[i]->type == VALUE_TYPE_STRUCT) &&
+                BIND_OF(argv[i]) == VALUE_BIND_WRITE) {
+            value_unbind(argv[i]);
+            value_bind(argv[i], VALUE_BIND_HOLD);
+            value_bind(&entry->entry_u.var, VALUE_BIND_WRITE);
+        }
+    }
+
+    if (!st->varargs) {
+        symtab_stack_set_args(s, argc, argv);
     }
+}
+
+/*
+ * Run body of user-defined function
+ *
+ * Returns the function result, or NULL if the body returned a
+ * call that was left pending as tail call.
+ */
+static value *run_body(intend_state *s, stmt *st, tail_call *tail)
+{
+    int cookie;
 
     s->retval = NULL;
     cookie = ++s->global_cookie;
 
-    eval_stmt(s, st, cookie);
+    eval_run_stmt(s, st, cookie);
 
     s->return_flag = s->continue_flag = s->break_flag = 0;
 
+    if (tail->pending) {
+        return NULL;
+    }
+
     /*
      * Check whether retval was allocated on the level of this
      * function call -- if not, allocate new void value
@@ -148,30 +195,166 @@ static value *run_func(intend_state *s, void *data, void *def,
     if (s->retval_cookie != cookie || !s->retval) {
         s->retval = value_make_void();
     }
+    return s->retval;
+}
+
+/*
+ * Free arguments of pending tail call
+ */
+static void free_tail(tail_call *tail)
+{
+    unsigned int i;
+
+    for (i = 0; i < tail->argc; i++) {
+        value_free(tail->argv[i]);
+    }
+    tail->argc = 0;
+    tail->pending = 0;
+}
+
+/*
+ * Keep arguments of tail call made in place
+ *
+ * The local symbol table taken over by the call still refers to
+ * its arguments, see symtab_stack_set_args(). They are kept until
+ * the next call takes the table over or the chain ends, and the
+ * arguments kept before are freed.
+ */
+static void keep_tail(tail_call *tail)
+{
+    value **argv;
+    unsigned int i, size;
+
+    for (i = 0; i < tail->kept; i++) {
+        value_free(tail->keep[i]);
+    }
+    argv = tail->keep;
+    size = tail->keep_size;
+    tail->keep = tail->argv;
+    tail->keep_size = tail->size;
+    tail->kept = tail->argc;
+    tail->argv = argv;
+    tail->size = size;
+    tail->argc = 0;
+    tail->pending = 0;
+}
+
+/*
+ * Make pending tail call
+ *
+ * If the local symbol table of the running function is not read
+ * after it returns, the called function takes it over, so that
+ * chains of tail calls run in constant space. Return checks of
+ * the functions taken over are kept until the chain ends, once
+ * for runs of the same check. Otherwise, the call is made in a
+ * symbol table of its own.
+ */
+static value *run_tail(intend_state *s, tail_call *tail, int reuse)
+{
+    tail_check *last;
+    value *res;
+
+    last = tail->nchecks ? &tail->checks[tail->nchecks - 1] : NULL;
+    if (!(tail->ret.retcheck & CALL_CHECK_ANY) &&
+            (!last || last->retcheck != tail->ret.retcheck)) {
+        if (tail->nchecks == TAIL_CHECKS) {
+            reuse = 0;
+        } else if (reuse) {
+            tail->checks[tail->nchecks++] = tail->ret;
+        }
+    }
+
+    if (reuse) {
+        symtab_stack_leave(s);
+        symtab_stack_enter(s);
+        enter_func(s, tail->names, tail->body, tail->args, tail->argc,
+                   tail->argv);
+        keep_tail(tail);
+        return run_body(s, tail->body, tail);
+    }
+
+    symtab_stack_enter(s);
+    s->tail_frame = 1;
+    res = run_func(s, tail->names, tail->body, tail->args, tail->argc,
+                   tail->argv);
+    symtab_stack_leave(s);
+    call_check_return(s, tail->ret.name, tail->ret.rettype,
+                      tail->ret.retcheck, &res);
+    free_tail(tail);
+    return res;
+}
 
+/*
+ * Run user-defined function
+ *
+ * This function runs a user-defined function by creating a new
+ * symbol table, adding the function parameters as variables, and
+ * then executing the function body. This function is implicitly
+ * called from eval_call.c::eval_call(), via call_func() from
+ * libruntime. Calls returned by the body are made here once the
+ * body has unwound, see run_tail().
+ */
+static value *run_func(intend_state *s, void *data, void *def,
+                       unsigned int args, unsigned int argc, value **argv)
+{
+    tail_call tail, *outer;
+    unsigned int i;
+    value *res;
+    int reuse;
+
+    sanity(def && argc >= args && (argc == 0 || argv));
+
+    if (++s->func_flag < 1) {
+        fatal(s, "too deep function call nesting");
+        return value_make_void();
+    }
+
+    reuse = s->tail_frame;
+    s->tail_frame = 0;
+    memset(&tail, 0, sizeof(tail));
+    tail.depth = s->local_depth;
+    outer = s->tail;
+    s->tail = &tail;
+
+    enter_func(s, (char **) data, (stmt *) def, args, argc, argv);
+    res = run_body(s, (stmt *) def, &tail);
+    while (!res) {
+        res = run_tail(s, &tail, reuse);
+    }
+    while (tail.nchecks > 0) {
+        --tail.nchecks;
+        call_check_return(s, tail.checks[tail.nchecks].name,
+                          tail.checks[tail.nchecks].rettype,
+                          tail.checks[tail.nchecks].retcheck, &res);
+    }
+    free(tail.argv);
+    for (i = 0; i < tail.kept; i++) {
+        value_free(tail.keep[i]);
+    }
+    free(tail.keep);
+
+    s->tail = outer;
     --s->func_flag;
-    return s->retval;
+    return res;
 }
 
 /*
  * Create user-defined function symtab entry
  *
  * This function creates a symbol table entry for a user defined
- * function and adds it to the current symbol table.
+ * function and adds it to the current symbol table. The frame
+ * layout of the body is resolved here, which also tells whether
+ * calls need to set up argc and argv.
  */
 void define_func(intend_state *s, stmt *st)
 {
     signature *sig;
     char *proto_copy;
-    char *name_copy;
 
     sanity(st && st->name);
 
     sig = call_sig_alloc();
 
-    name_copy = oom(malloc(strlen(st->name) + 1));
-    strcpy(name_copy, st->name);
-
     if (st->proto) {
         proto_copy = oom(malloc(strlen(st->proto) + 1));
         strcpy(proto_copy, st->proto);
@@ -181,13 +364,14 @@ void define_func(intend_state *s, stmt *st)
 
     sig->type    = FUNCTION_TYPE_USERDEF;
     sig->args    = st->args;
-    sig->name    = name_copy;
+    sig->name    = intern(st->name);
     sig->proto   = proto_copy;
     sig->rettype = st->rettype;
     sig->data    = st->names;
     sig->def     = st->true_case;
     sig->call_u.userdef_vector = run_func;
 
+    eval_frame(st->true_case, st->names, st->args);
     symtab_stack_add_function(s, st->name, sig);
     call_sig_free(sig);
 }
@@ -270,14 +454,12 @@ void eval_stmt(intend_state *s, stmt *st, int cookie)
                 fatal(s, "too deep loop nesting");
                 return;
             }
-            val = eval_expr(s, st->init);
-            value_free(val);
+            discard(s, st->init);
             while ((res = runtest(s, st->expr)) == 1) {
                 eval_stmt(s, st->true_case, cookie);
                 s->continue_flag = 0;
                 if (s->break_flag) break;
-                val = eval_expr(s, st->guard);
-                value_free(val);
+                discard(s, st->guard);
             }
             s->break_flag = 0;
             --s->loop_flag;
@@ -297,11 +479,19 @@ void eval_stmt(intend_state *s, stmt *st, int cookie)
         case STMT_RETURN:
             /* return statement */
             if (s->func_flag) {
-                if (st->expr) {
+                if (st->tail) {
+                    val = eval_tail_call(s, st->expr);
+                    if (!val) break;
+                } else if (st->expr) {
                     val = eval_expr(s, st->expr);
                 } else {
                     val = value_make_void();
                 }
+                /* a return expression that raised does not return */
+                if (s->except_flag || s->exit_flag) {
+                    value_free(val);
+                    break;
+                }
                 /* store result, for function returns */
                 s->retval = val;
                 s->retval_cookie = cookie;
@@ -310,8 +500,7 @@ void eval_stmt(intend_state *s, stmt *st, int cookie)
             break;
         case STMT_EXPR:
             /* expression statment */
-            val = eval_expr(s, st->expr);
-            value_free(val);
+            discard(s, st->expr);
             break;
         case STMT_FUNC:
             define_func(s, st);
@@ -43,19 +43,7 @@
  */
 value *eval_string_plus(intend_state *s, value *a, value *b)
 {
-    value *res;
-	char *buf;
-
     sanity(a && b);
 
-	buf = oom(malloc(STRLEN_OF(a) + STRLEN_OF(b) + 1));
-	strcpy(buf, STR_OF(a));
-	strcat(buf, STR_OF(b));
-
-	res = value_make_string(buf);
-
-	free(buf);
-
-    return res;
+    return value_concat_string(a, b);
 }
-
@@ -39,6 +39,9 @@
 
 /*
  * Evaluate switch
+ *
+ * A continue, break or return inside a case body leaves the
+ * switch at once, without falling through into the next body.
  */
 void eval_stmt_switch(intend_state *s, stmt *st, int cookie)
 {
@@ -62,16 +65,18 @@ void eval_stmt_switch(intend_state *s, stmt *st, int cookie)
         if (!go && label->type != STMT_CASE) continue;
 
         if (!go) {
-            guard = eval_expr(s, label->expr);
+            guard = eval_expr_borrow(s, label->expr);
             equal = eval_order_equal(val, guard);
             go = BOOL_OF(equal);
-            value_free(guard);
+            eval_release(label->expr, guard);
             value_free(equal);
         }
 
         if (go) {
             handled = 1;
             eval_stmt_list(s, (stmt_list *) label->block, cookie);
+            if (s->continue_flag || s->return_flag ||
+                    s->except_flag   || s->exit_flag) break;
         }
 
         if (go && !label->thru) break;
@@ -0,0 +1,563 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Bytecode virtual machine
+ *
+ * Executes bytecode units produced by eval_compile.c on a value
+ * stack. Loop and try blocks are tracked on a block stack so that
+ * break, continue, return and exceptions can unwind them with the
+ * same effect on the interpreter state flags as the tree-walking
+ * evaluator in eval_stmt.c.
+ *
+ * Each stack position has a value cell of its own. Scalars and
+ * results of variable references and in-place updates are stored
+ * in the cells, so that loops over plain int and float expressions
+ * run without allocating values. Values are moved to allocated
+ * storage when an operation consumes its operands.
+ */
+
+#include <stdlib.h>
+
+#include "eval.h"
+
+/*
+ * Use computed goto dispatch where the compiler supports it
+ */
+#if defined(__GNUC__) && !defined(VM_NO_COMPUTED_GOTO)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+/*
+ * Stack sizes served from the C stack
+ */
+#define VM_STACK_LOCAL  32
+#define VM_BLOCKS_LOCAL 8
+
+/*
+ * Loop or try block
+ */
+typedef struct {
+    int     loop;       /* loop block if set, try block otherwise */
+    int     brk;        /* break target of loops, catch target of try */
+    int     cont;       /* continue target of loops */
+    int     sp;         /* value stack depth on entry */
+} vm_block;
+
+/*
+ * Dispatch macros
+ */
+#ifdef VM_COMPUTED_GOTO
+#define VM_OP(op)       op_##op:
+#define VM_DISPATCH()   goto *labels[ip->op]
+#else
+#define VM_OP(op)       case op:
+#define VM_DISPATCH()   goto dispatch
+#endif
+
+#define VM_NEXT()       do { ip++; VM_DISPATCH(); } while (0)
+#define VM_GOTO(t)      do { ip = instr + (t); VM_DISPATCH(); } while (0)
+#define VM_CHECK()      do { if (s->except_flag || s->exit_flag) goto unwind; } while (0)
+#define VM_POSITION()   do { s->source_line = ip->line; s->source_file = ip->file; } while (0)
+#define VM_CELL(p)      (cells[p].type = VALUE_TYPE_VOID, stack[p] = &cells[p])
+
+/*
+ * Free value at stack position
+ */
+static void vm_drop(value **stack, value *cells, int p)
+{
+    if (stack[p] == &cells[p]) {
+        value_cleanup(stack[p]);
+    } else {
+        value_free(stack[p]);
+    }
+}
+
+/*
+ * Take value at stack position
+ *
+ * Returns the value in allocated storage, moving it out of its
+ * cell if needed.
+ */
+static value *vm_take(value **stack, value *cells, int p)
+{
+    value *val;
+
+    if (stack[p] != &cells[p]) {
+        return stack[p];
+    }
+    val = value_alloc(VALUE_TYPE_VOID);
+    *val = cells[p];
+    return val;
+}
+
+/*
+ * Run bytecode unit
+ *
+ * The cookie is used to tag return values like eval_stmt() does.
+ */
+void eval_code_run(intend_state *s, vm_code *code, int cookie)
+{
+#ifdef VM_COMPUTED_GOTO
+    static void *labels[] = {
+        &&op_VM_HALT, &&op_VM_POP, &&op_VM_VOID, &&op_VM_CONST,
+        &&op_VM_REF, &&op_VM_EVAL, &&op_VM_STMT, &&op_VM_ASSIGN,
+        &&op_VM_ASSIGN_ARRAY, &&op_VM_INFIX, &&op_VM_PREFIX,
+        &&op_VM_POSTFIX, &&op_VM_CAST, &&op_VM_BOOL, &&op_VM_AND,
+        &&op_VM_OR, &&op_VM_CALL_CHECK, &&op_VM_CALL, &&op_VM_JUMP,
+        &&op_VM_JUMP_FALSE, &&op_VM_JUMP_TRUE, &&op_VM_CASE,
+        &&op_VM_LOOP_ENTER, &&op_VM_LOOP_LEAVE, &&op_VM_BREAK,
+        &&op_VM_CONTINUE, &&op_VM_RETURN_CHECK, &&op_VM_RETURN,
+        &&op_VM_THROW, &&op_VM_TRY, &&op_VM_CATCH, &&op_VM_INFIX_CONST,
+        &&op_VM_CASE_CONST, &&op_VM_UPDATE, &&op_VM_TAIL_CALL
+    };
+#endif
+    value *local_stack[VM_STACK_LOCAL];
+    value local_cells[VM_STACK_LOCAL];
+    vm_block local_blocks[VM_BLOCKS_LOCAL];
+    value **stack, **argv, *cells, *val, tmp;
+    vm_block *blocks;
+    vm_instr *instr, *ip;
+    signature *sig;
+    expr *ex;
+    stmt *st;
+    int sp = 0, bp = 0, res, i;
+
+    sanity(code);
+
+    if (s->return_flag || s->except_flag || s->exit_flag) return;
+
+    if (code->stack <= VM_STACK_LOCAL) {
+        stack = local_stack;
+        cells = local_cells;
+    } else {
+        stack = oom(malloc(code->stack * sizeof(value *)));
+        cells = oom(malloc(code->stack * sizeof(value)));
+    }
+    if (code->blocks <= VM_BLOCKS_LOCAL) {
+        blocks = local_blocks;
+    } else {
+        blocks = oom(malloc(code->blocks * sizeof(vm_block)));
+    }
+
+    instr = code->instr;
+    ip = instr;
+
+#ifdef VM_COMPUTED_GOTO
+    VM_DISPATCH();
+#else
+dispatch:
+    switch (ip->op) {
+#endif
+        VM_OP(VM_HALT)
+            goto leave;
+
+        VM_OP(VM_POP)
+            vm_drop(stack, cells, --sp);
+            VM_NEXT();
+
+        VM_OP(VM_VOID)
+            VM_CELL(sp);
+            sp++;
+            VM_NEXT();
+
+        VM_OP(VM_CONST)
+            VM_POSITION();
+            value_copy_to(VM_CELL(sp), ip->ptr);
+            sp++;
+            VM_NEXT();
+
+        VM_OP(VM_REF)
+            VM_POSITION();
+            eval_ref_to(s, ip->ptr, VM_CELL(sp));
+            sp++;
+            VM_NEXT();
+
+        VM_OP(VM_EVAL)
+            eval_expr_to(s, ip->ptr, VM_CELL(sp));
+            sp++;
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_STMT)
+            eval_stmt(s, ip->ptr, cookie);
+            if (s->except_flag || s->exit_flag ||
+                    s->return_flag || s->continue_flag) goto unwind;
+            VM_NEXT();
+
+        VM_OP(VM_ASSIGN)
+            eval_assign_value(s, ip->ptr, stack[sp - 1]);
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_ASSIGN_ARRAY)
+            ex = ip->ptr;
+            eval_assign_array_direct(s, ex, stack[sp - 1]);
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_UPDATE)
+            VM_POSITION();
+            tmp.type = VALUE_TYPE_VOID;
+            eval_assign_operand(s, ip->ptr, stack[sp - 1], &tmp);
+            vm_drop(stack, cells, sp - 1);
+            cells[sp - 1] = tmp;
+            stack[sp - 1] = &cells[sp - 1];
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_INFIX)
+            ex = ip->ptr;
+            if (eval_infix_scalar(ex, stack[sp - 2], stack[sp - 1],
+                                  &cells[sp - 2])) {
+                vm_drop(stack, cells, --sp);
+                if (stack[sp - 1] != &cells[sp - 1]) {
+                    value_free(stack[sp - 1]);
+                    stack[sp - 1] = &cells[sp - 1];
+                }
+                VM_NEXT();
+            }
+            val = vm_take(stack, cells, --sp);
+            stack[sp - 1] = eval_infix_values(s, ex,
+                                              vm_take(stack, cells, sp - 1),
+                                              val);
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_INFIX_CONST)
+            VM_POSITION();
+            ex = ip->ptr;
+            if (eval_infix_scalar(ex, stack[sp - 1], ex->index->cval,
+                                  &cells[sp - 1])) {
+                if (stack[sp - 1] != &cells[sp - 1]) {
+                    value_free(stack[sp - 1]);
+                    stack[sp - 1] = &cells[sp - 1];
+                }
+                VM_NEXT();
+            }
+            stack[sp - 1] = eval_infix_values(s, ex,
+                                              vm_take(stack, cells, sp - 1),
+                                              ex->index->cval);
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_PREFIX)
+            stack[sp - 1] = eval_prefix_value(s, ip->ptr,
+                                              vm_take(stack, cells, sp - 1));
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_POSTFIX)
+            stack[sp - 1] = eval_postfix_value(s, ip->ptr,
+                                               vm_take(stack, cells, sp - 1));
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_CAST)
+            stack[sp - 1] = eval_cast_value(s, ip->ptr,
+                                            vm_take(stack, cells, sp - 1));
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_BOOL)
+            if (stack[sp - 1]->type != VALUE_TYPE_BOOL) {
+                stack[sp - 1] = vm_take(stack, cells, sp - 1);
+                value_cast_inplace(s, &stack[sp - 1], VALUE_TYPE_BOOL);
+                VM_CHECK();
+            }
+            VM_NEXT();
+
+        VM_OP(VM_AND)
+            if (stack[sp - 1]->type != VALUE_TYPE_BOOL) {
+                stack[sp - 1] = vm_take(stack, cells, sp - 1);
+                value_cast_inplace(s, &stack[sp - 1], VALUE_TYPE_BOOL);
+                VM_CHECK();
+            }
+            if (!BOOL_OF(stack[sp - 1])) VM_GOTO(ip->arg);
+            vm_drop(stack, cells, --sp);
+            VM_NEXT();
+
+        VM_OP(VM_OR)
+            if (stack[sp - 1]->type != VALUE_TYPE_BOOL) {
+                stack[sp - 1] = vm_take(stack, cells, sp - 1);
+                value_cast_inplace(s, &stack[sp - 1], VALUE_TYPE_BOOL);
+                VM_CHECK();
+            }
+            if (BOOL_OF(stack[sp - 1])) VM_GOTO(ip->arg);
+            vm_drop(stack, cells, --sp);
+            VM_NEXT();
+
+        VM_OP(VM_CALL_CHECK)
+            VM_POSITION();
+            if (!eval_call_lookup(s, ip->ptr)) goto unwind;
+            VM_NEXT();
+
+        VM_OP(VM_CALL)
+            ex = ip->ptr;
+            sig = eval_call_lookup(s, ex);
+            if (!sig) goto unwind;
+            argv = stack + sp - ex->argc;
+            for (i = 0; i < ex->argc; i++) {
+                argv[i] = vm_take(stack, cells, sp - ex->argc + i);
+            }
+            val = eval_call_values(s, ex, sig, argv);
+            for (i = 0; i < ex->argc; i++) {
+                value_free(argv[i]);
+            }
+            sp -= ex->argc;
+            stack[sp++] = val;
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_TAIL_CALL)
+            ex = ip->ptr;
+            sig = eval_call_lookup(s, ex);
+            if (!sig) goto unwind;
+            argv = stack + sp - ex->argc;
+            for (i = 0; i < ex->argc; i++) {
+                argv[i] = vm_take(stack, cells, sp - ex->argc + i);
+            }
+            if (eval_tail_values(s, ex, sig, argv)) {
+                sp -= ex->argc;
+                goto unwind;
+            }
+            val = eval_call_values(s, ex, sig, argv);
+            for (i = 0; i < ex->argc; i++) {
+                value_free(argv[i]);
+            }
+            sp -= ex->argc;
+            stack[sp++] = val;
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_JUMP)
+            VM_GOTO(ip->arg);
+
+        VM_OP(VM_JUMP_FALSE)
+            if (stack[--sp]->type == VALUE_TYPE_BOOL) {
+                res = BOOL_OF(stack[sp]);
+                vm_drop(stack, cells, sp);
+            } else {
+                val = vm_take(stack, cells, sp);
+                value_cast_inplace(s, &val, VALUE_TYPE_BOOL);
+                res = BOOL_OF(val);
+                value_free(val);
+                VM_CHECK();
+            }
+            if (!res) VM_GOTO(ip->arg);
+            VM_NEXT();
+
+        VM_OP(VM_JUMP_TRUE)
+            if (stack[--sp]->type == VALUE_TYPE_BOOL) {
+                res = BOOL_OF(stack[sp]);
+                vm_drop(stack, cells, sp);
+            } else {
+                val = vm_take(stack, cells, sp);
+                value_cast_inplace(s, &val, VALUE_TYPE_BOOL);
+                res = BOOL_OF(val);
+                value_free(val);
+                VM_CHECK();
+            }
+            if (res) VM_GOTO(ip->arg);
+            VM_NEXT();
+
+        VM_OP(VM_CASE)
+            res = eval_order_is_equal(stack[sp - 2], stack[sp - 1]);
+            vm_drop(stack, cells, --sp);
+            if (res) VM_GOTO(ip->arg);
+            VM_NEXT();
+
+        VM_OP(VM_CASE_CONST)
+            VM_POSITION();
+            st = ip->ptr;
+            res = eval_order_is_equal(stack[sp - 1], st->expr->cval);
+            if (res) VM_GOTO(ip->arg);
+            VM_NEXT();
+
+        VM_OP(VM_LOOP_ENTER)
+            if (++s->loop_flag < 1) {
+                fatal(s, "too deep loop nesting");
+                goto unwind;
+            }
+            blocks[bp].loop = 1;
+            blocks[bp].brk  = ip->arg;
+            blocks[bp].cont = ip->alt;
+            blocks[bp].sp   = sp;
+            bp++;
+            VM_NEXT();
+
+        VM_OP(VM_LOOP_LEAVE)
+            --bp;
+            --s->loop_flag;
+            VM_NEXT();
+
+        VM_OP(VM_BREAK)
+            if (!s->loop_flag) VM_NEXT();
+            s->continue_flag = s->break_flag = 1;
+            goto unwind;
+
+        VM_OP(VM_CONTINUE)
+            if (!s->loop_flag) VM_NEXT();
+            s->continue_flag = 1;
+            goto unwind;
+
+        VM_OP(VM_RETURN_CHECK)
+            if (!s->func_flag) VM_GOTO(ip->arg);
+            VM_NEXT();
+
+        VM_OP(VM_RETURN)
+            /* store result, for function returns */
+            --sp;
+            s->retval = vm_take(stack, cells, sp);
+            s->retval_cookie = cookie;
+            s->return_flag = s->continue_flag = s->break_flag = 1;
+            goto unwind;
+
+        VM_OP(VM_THROW)
+            --sp;
+            except_throw(s, vm_take(stack, cells, sp));
+            VM_CHECK();
+            VM_NEXT();
+
+        VM_OP(VM_TRY)
+            if (!except_try(s)) goto unwind;
+            blocks[bp].loop = 0;
+            blocks[bp].brk  = ip->arg;
+            blocks[bp].cont = 0;
+            blocks[bp].sp   = sp;
+            bp++;
+            VM_NEXT();
+
+        VM_OP(VM_CATCH)
+            --bp;
+            val = except_catch(s);
+            if (!val) VM_GOTO(ip->arg);
+            symtab_stack_add_variable(s, ((stmt *) ip->ptr)->name, val);
+            value_free(val);
+            VM_NEXT();
+#ifndef VM_COMPUTED_GOTO
+    }
+#endif
+
+unwind:
+    /*
+     * An operation raised one of the state flags: transfer control
+     * to the innermost block handling it, or leave the unit and let
+     * the caller see the flag
+     */
+    if (s->exit_flag) goto leave;
+
+    if (s->except_flag) {
+        while (bp > 0 && blocks[bp - 1].loop) {
+            --bp;
+            --s->loop_flag;
+        }
+        if (bp == 0) goto leave;
+        while (sp > blocks[bp - 1].sp) {
+            vm_drop(stack, cells, --sp);
+        }
+        VM_GOTO(blocks[bp - 1].brk);
+    }
+
+    if (s->return_flag) goto leave;
+
+    if (s->continue_flag) {
+        while (bp > 0 && !blocks[bp - 1].loop) {
+            --bp;
+            --s->try_flag;
+        }
+        if (bp == 0) goto leave;
+        while (sp > blocks[bp - 1].sp) {
+            vm_drop(stack, cells, --sp);
+        }
+        if (s->break_flag) {
+            s->continue_flag = s->break_flag = 0;
+            VM_GOTO(blocks[bp - 1].brk);
+        }
+        s->continue_flag = 0;
+        VM_GOTO(blocks[bp - 1].cont);
+    }
+
+leave:
+    while (sp > 0) {
+        vm_drop(stack, cells, --sp);
+    }
+    while (bp > 0) {
+        if (blocks[--bp].loop) {
+            --s->loop_flag;
+        } else {
+            --s->try_flag;
+        }
+    }
+
+    if (stack != local_stack) {
+        free(stack);
+        free(cells);
+    }
+    if (blocks != local_blocks) free(blocks);
+}
+
+/*
+ * Run statement with the selected evaluation engine
+ *
+ * Statements are compiled to bytecode on their first run and the
+ * compiled unit is kept with the statement.
+ */
+void eval_run_stmt(intend_state *s, stmt *st, int cookie)
+{
+    sanity(st);
+
+    if (s->engine != ENGINE_VM) {
+        eval_stmt(s, st, cookie);
+        return;
+    }
+    if (!st->code) {
+        st->code = eval_compile_stmt(s, st);
+    }
+    eval_code_run(s, st->code, cookie);
+}
+
+/*
+ * Run statement list with the selected evaluation engine
+ */
+void eval_run_list(intend_state *s, stmt_list *list, int cookie)
+{
+    sanity(list);
+
+    if (s->engine != ENGINE_VM) {
+        eval_stmt_list(s, list, cookie);
+        return;
+    }
+    if (!list->code) {
+        list->code = eval_compile_list(s, list);
+    }
+    eval_code_run(s, list->code, cookie);
+}
@@ -38,6 +38,10 @@
 #ifndef INTEND_MISC_H
 #define INTEND_MISC_H
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <stdio.h>
 
 /*
@@ -70,25 +74,31 @@ typedef struct intend_state_s {
     void    *retval;            /* last function return value */
     int     retval_cookie;      /* cookie of return value */
     int     global_cookie;      /* current cookie */
-    int     float_count;        /* number of in-flight arguments */
-    void    *float_args;        /* in-flight arguments */
-    int     vector_count;       /* number of in-flight argument vectors */
-    void    *vectors;           /* in-flight argument vectors */
+    void    *args;              /* argument stack of calls in progress */
+    void    *tail;              /* tail call of running function */
+    int     tail_frame;         /* next function may reuse its frame */
     char    *new_cons;          /* current constructor name */
     void    *new_sig;           /* current constructor signature */
     void    *global_table;      /* global symbol table */
     int     local_depth;        /* local symbol table depth */
-    void    *local_tables;      /* local symbol tables */
+    int     local_size;         /* allocated local symbol tables */
+    void    *local_tables;      /* local symbol tables, reused above depth */
     char    *source_file;       /* current source file */
     int     source_line;        /* current line in source file */
     int     source_col;         /* current column in source file */
     void    *parser;            /* parser data */
     void    *script;            /* parsed script data */
+    int     engine;             /* evaluation engine (0=tree walker;1=bytecode vm) */
+    void    *code;              /* compiled bytecode units */
+    unsigned long cache_hits;   /* call and method inline cache hits */
+    unsigned long cache_misses; /* call and method inline cache misses */
+    unsigned long value_allocs; /* values allocated by the context */
     int     seed_init;          /* random generator initialization */
     int     safe_mode;          /* running script in safe mode (0=regular;1=safe mode)*/
     void    *sandboxes;         /* safe mode allowed paths (sandboxes) */
     void    *preload_modules;   /* Linked list of modules to pre-load during state init */
     void    *modules;           /* Linked list of loaded modules data */
+    void    *slab;              /* small objects allocated by the context */
 } intend_state;
 
 /*
@@ -97,6 +107,29 @@ typedef struct intend_state_s {
 intend_state *state_alloc(void);
 void state_free(intend_state *state);
 
+/*
+ * Context running on the calling thread
+ *
+ * Compilers without __thread variables keep it under a thread key,
+ * which state_current() has to look up on every call.
+ */
+#ifdef HAVE_TLS_MODEL
+#define TLS_INITIAL_EXEC __attribute__((tls_model("initial-exec")))
+#else
+#define TLS_INITIAL_EXEC
+#endif
+
+intend_state *state_enter(intend_state *state);
+void state_leave(intend_state *prev);
+
+#ifdef HAVE_TLS
+extern __thread intend_state *state_running TLS_INITIAL_EXEC;
+
+#define state_current() (state_running)
+#else
+intend_state *state_current(void);
+#endif
+
 /*
  * Error printing
  */
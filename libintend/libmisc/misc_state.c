@@ -34,6 +34,9 @@
  */
 
 #include <stdlib.h>
+#ifndef HAVE_TLS
+#include <pthread.h>
+#endif
 
 #include "misc.h"
 
@@ -52,3 +55,70 @@ void state_free(intend_state *state)
 {
 	cfree(state);
 }
+
+/*
+ * Context running on this thread
+ *
+ * Set by the library entry points while they work for a context,
+ * so that code without access to the state, like the allocators,
+ * can find it with state_current(). It is NULL outside of the
+ * library.
+ */
+#ifdef HAVE_TLS
+__thread intend_state *state_running;
+#else
+static pthread_key_t running_key;
+static pthread_once_t running_once = PTHREAD_ONCE_INIT;
+
+static void running_init(void)
+{
+	pthread_key_create(&running_key, NULL);
+}
+
+/*
+ * Get context running on this thread
+ */
+intend_state *state_current(void)
+{
+	pthread_once(&running_once, running_init);
+	return pthread_getspecific(running_key);
+}
+
+static void set_running(intend_state *state)
+{
+	pthread_once(&running_once, running_init);
+	pthread_setspecific(running_key, state);
+}
+#endif
+
+/*
+ * Make context the running one
+ *
+ * Returns the context that was running before, which must be given
+ * to state_leave().
+ */
+intend_state *state_enter(intend_state *state)
+{
+#ifdef HAVE_TLS
+	intend_state *prev = state_running;
+
+	state_running = state;
+#else
+	intend_state *prev = state_current();
+
+	set_running(state);
+#endif
+	return prev;
+}
+
+/*
+ * Restore the context running before state_enter()
+ */
+void state_leave(intend_state *prev)
+{
+#ifdef HAVE_TLS
+	state_running = prev;
+#else
+	set_running(prev);
+#endif
+}
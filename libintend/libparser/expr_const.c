@@ -0,0 +1,213 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Constant expression decoding
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "../libruntime/runtime.h"
+
+/*
+ * Character code escape
+ */
+static int charcode(char *orig, char **pos, int base, unsigned int maxlen)
+{
+    long int res, len;
+    char tmp = 0;
+    char *endptr = orig;
+
+    if (strlen(orig) > maxlen) {
+        tmp = orig[maxlen];
+        orig[maxlen] = 0;
+    }
+
+    res = strtol(orig, &endptr, base);
+    if (endptr != orig) {
+        *(*pos) = res & 0xFF;
+        (*pos) += 1;
+        len = (endptr - orig) - 1;
+    } else {
+        len = 0;
+    }
+
+    if (tmp != 0) {
+        orig[maxlen] = tmp;
+    }
+    return len;
+}
+
+/*
+ * Unescape special characters
+ *
+ * Returns NULL for a non-terminated escape sequence; the evaluator
+ * reports that error when the constant is evaluated.
+ */
+static char *unescape(const char *orig, int *retlen)
+{
+    char *raw, *pos;
+    int i, len, is_esc = 0, count = 0;
+
+    len = strlen(orig);
+
+    raw = oom(malloc(len + 1));
+    pos = raw;
+
+    for (i = 0; i < len + 1; i++) {
+        if (is_esc) {
+            switch (orig[i]) {
+                case 0:
+                    *retlen = 0;
+                    free(raw);
+                    return NULL;
+                    break;
+                case '0':
+                    i += charcode((char *) & orig[i], &pos, 8, 4);
+                    break;
+                case 'b':
+                    *pos++ = '\b';
+                    break;
+                case 'd':
+                    i += charcode((char *) & orig[i+1], &pos, 10, 3) + 1;
+                    break;
+                case 'e':
+                    *pos++ = 27;
+                    break;
+                case 'f':
+                    *pos++ = '\f';
+                    break;
+                case 'n':
+                    *pos++ = '\n';
+                    break;
+                case 'o':
+                    i += charcode((char *) & orig[i+1], &pos, 8, 3) + 1;
+                    break;
+                case 'r':
+                    *pos++ = '\r';
+                    break;
+                case 't':
+                    *pos++ = '\t';
+                    break;
+                case 'x':
+                    i += charcode((char *) & orig[i+1], &pos, 16, 2) + 1;
+                    break;
+                default:
+                    if (isdigit(orig[i])) {
+                        i += charcode((char *) & orig[i], &pos, 8, 3);
+                    } else {
+                        *pos++ = orig[i];
+                    }
+            }
+            is_esc = 0;
+            count++;
+        } else {
+            switch (orig[i]) {
+                case 0:
+                    *pos = 0;
+                    i = len + 1;
+                    break;
+                case '\\':
+                    is_esc = 1;
+                    break;
+                default:
+                    *pos++ = orig[i];
+                    count++;
+            }
+        }
+    }
+    *retlen = count;
+    return raw;
+}
+
+/*
+ * Decode string constant
+ */
+static value *decode_string(const char *orig)
+{
+    char *raw;
+    value *val;
+    int len;
+
+    raw = unescape(orig, &len);
+    if (!raw) {
+        return NULL;
+    }
+    val = value_make_memstring(raw, len);
+    free(raw);
+    return val;
+}
+
+/*
+ * Decode constant expression
+ *
+ * Constant nodes carry their value in decoded form, so that the
+ * evaluator never has to parse literal text at run time. Nodes
+ * that are not constants are left alone.
+ */
+void expr_decode(expr *ex)
+{
+    value *val = NULL;
+
+    sanity(ex);
+
+    switch (ex->type) {
+        case EXPR_CONST_VOID:
+            val = value_make_void();
+            break;
+        case EXPR_CONST_BOOL:
+            val = value_make_bool(strcmp(ex->name, "true") == 0);
+            break;
+        case EXPR_CONST_INT:
+            val = value_make_int(strtol(ex->name, NULL, 0));
+            break;
+        case EXPR_CONST_FLOAT:
+            val = value_make_float(strtod(ex->name, NULL));
+            break;
+        case EXPR_CONST_STRING:
+        case EXPR_FIELD:
+            val = decode_string(ex->name);
+            break;
+        case EXPR_FILE:
+            val = value_make_string(ex->file);
+            break;
+        case EXPR_LINE:
+            val = value_make_int(ex->line);
+            break;
+        default:
+            break;
+    }
+
+    ex->cval = val;
+}
@@ -38,23 +38,23 @@
 #include <string.h>
 
 #include "parser.h"
+#include "../libruntime/runtime.h"
 
 /*
  * Allocate expression structure
  */
-expr *expr_alloc(void)
+expr *expr_alloc(intend_state *s)
 {
-    expr *ex;
-
-    ex = oom(calloc(sizeof(expr), 1));
-
-    return ex;
+    return parser_arena_alloc(s, sizeof(expr));
 }
 
 /*
- * Free expression structure
+ * Release expression structure
+ *
+ * Frees the data of the expression that is not kept in the parser
+ * arena. The nodes themselves are freed with the arena.
  */
-void expr_free(expr *ex)
+void expr_release(expr *ex)
 {
     unsigned int i;
 
@@ -62,55 +62,45 @@ void expr_free(expr *ex)
         return;
     }
 
-    expr_free(ex->inner);
-    expr_free(ex->index);
-    expr_free(ex->elif);
+    expr_release(ex->inner);
+    expr_release(ex->index);
+    expr_release(ex->elif);
     for (i = 0; i < ex->argc; i++) {
-        expr_free(ex->argv[i]);
+        expr_release(ex->argv[i]);
     }
 
-    stmt_free(ex->lambda);
-
-    free(ex->argv);
-    free(ex->name);
-    free(ex->tname);
-    free(ex);
+    stmt_release(ex->lambda);
+    value_free(ex->cval);
 }
 
 /*
  * Copy expression
+ *
+ * Names are shared with the original, as both live in the arena.
  */
-expr *expr_copy(expr *ex)
+expr *expr_copy(intend_state *s, expr *ex)
 {
     expr *copy;
-    char *scopy;
     unsigned int i;
 
     if (!ex) {
         return NULL;
     }
 
-    copy = expr_alloc();
+    copy = expr_alloc(s);
     *copy = *ex;
 
-    if (ex->name) {
-        scopy = oom(malloc(strlen(ex->name) + 1));
-        strcpy(scopy, ex->name);
-        copy->name = scopy;
-    }
-    if (ex->tname) {
-        scopy = oom(malloc(strlen(ex->tname) + 1));
-        strcpy(scopy, ex->tname);
-        copy->tname = scopy;
+    if (ex->cval) {
+        copy->cval = value_copy(ex->cval);
     }
 
-    copy->inner = expr_copy(ex->inner);
-    copy->index = expr_copy(ex->index);
+    copy->inner = expr_copy(s, ex->inner);
+    copy->index = expr_copy(s, ex->index);
 
     if (ex->argc > 0) {
-        copy->argv = oom(malloc(sizeof(expr *) * ex->argc));
+        copy->argv = parser_arena_alloc(s, sizeof(expr *) * ex->argc);
         for (i = 0; i < ex->argc; i++) {
-            copy->argv[i] = expr_copy(ex->argv[i]);
+            copy->argv[i] = expr_copy(s, ex->argv[i]);
         }
     }
 
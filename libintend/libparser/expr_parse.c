@@ -49,7 +49,7 @@ static void safe_args(intend_state *s, int *argc, expr ***argv)
     *argc = expr_arg_leave(s);
     sanity(*argc != -1);
 
-    *argv = oom(calloc(sizeof(expr *), *argc));
+    *argv = parser_arena_alloc(s, sizeof(expr *) * *argc);
 
     next = (*argv) + (*argc - 1);
     for (i = 0; i < *argc; i++) {
@@ -64,10 +64,11 @@ static void expr_end_simple(intend_state *s, expr_type type)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = type;
     ex->file = s->source_file;
     ex->line = s->source_line;
+    expr_decode(ex);
 
     expr_stack_push(s, ex);
 }
@@ -89,18 +90,27 @@ void expr_end_assign(intend_state *s, char *name)
 
     arg = expr_stack_pop(s);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_ASSIGN;
     ex->file = s->source_file;
     ex->line = s->source_line;
     ex->name = name;
     ex->inner = arg;
 
+    // Appends written as a = a + b are updated in place like a += b
+    if (arg->type == EXPR_INFIX && arg->op == OPTYPE_PLUS &&
+            arg->inner->type == EXPR_REF && arg->inner->name == name) {
+        ex->op = OPTYPE_PLUS;
+    }
+
     expr_stack_push(s, ex);
 }
 
 /*
  * End combined operator and assignment expression
+ *
+ * The operator is also kept in the assignment, so that the
+ * evaluator can update the variable in place.
  */
 void expr_end_op_assign(intend_state *s, char *name, op_type type)
 {
@@ -108,7 +118,7 @@ void expr_end_op_assign(intend_state *s, char *name, op_type type)
 
     mod = expr_stack_pop(s);
 
-    ref = expr_alloc();
+    ref = expr_alloc(s);
     ref->type = EXPR_REF;
     ref->file = s->source_file;
     ref->line = s->source_line;
@@ -119,8 +129,9 @@ void expr_end_op_assign(intend_state *s, char *name, op_type type)
 
     expr_end_infix(s, type);
 
-    ex = expr_copy(ref);
+    ex = expr_copy(s, ref);
     ex->type = EXPR_ASSIGN;
+    ex->op = type;
     ex->inner = expr_stack_pop(s);
 
     expr_stack_push(s, ex);
@@ -139,7 +150,7 @@ void expr_end_assign_array(intend_state *s, char *name)
 
     safe_args(s, &argc, &argv);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_ASSIGN_ARRAY;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -152,7 +163,10 @@ void expr_end_assign_array(intend_state *s, char *name)
 }
 
 /*
- * End combined operator and assignment expression
+ * End combined operator and array assignment expression
+ *
+ * The operator is also kept in the assignment, so that the
+ * evaluator can update the array element in place.
  */
 void expr_end_op_assign_array(intend_state *s, char *name, op_type type)
 {
@@ -164,7 +178,7 @@ void expr_end_op_assign_array(intend_state *s, char *name, op_type type)
 
     safe_args(s, &argc, &argv);
 
-    ref = expr_alloc();
+    ref = expr_alloc(s);
     ref->type = EXPR_REF_ARRAY;
     ref->file = s->source_file;
     ref->line = s->source_line;
@@ -177,8 +191,9 @@ void expr_end_op_assign_array(intend_state *s, char *name, op_type type)
 
     expr_end_infix(s, type);
 
-    ex = expr_copy(ref);
+    ex = expr_copy(s, ref);
     ex->type = EXPR_ASSIGN_ARRAY;
+    ex->op = type;
     ex->inner = expr_stack_pop(s);
 
     expr_stack_push(s, ex);
@@ -189,18 +204,14 @@ void expr_end_op_assign_array(intend_state *s, char *name, op_type type)
  */
 void expr_end_cast(intend_state *s, char *typespec)
 {
-    char *tcopy;
     expr *ex;
 
-    tcopy = oom(malloc(strlen(typespec) + 1));
-    strcpy(tcopy, typespec);
-
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_CAST;
     ex->file = s->source_file;
     ex->line = s->source_line;
     ex->inner = expr_stack_pop(s);
-    ex->name = tcopy;
+    ex->name = parser_arena_intern(s, typespec);
 
     expr_stack_push(s, ex);
 }
@@ -212,7 +223,7 @@ void expr_end_call_void(intend_state *s, char *name, int cons)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = cons ? EXPR_NEW : EXPR_CALL;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -228,7 +239,7 @@ void expr_end_static_void(intend_state *s, char *tname, char *name)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_STATIC;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -245,7 +256,7 @@ void expr_end_method_void(intend_state *s, char *name)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_METHOD;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -266,7 +277,7 @@ void expr_end_call(intend_state *s, char *name, int cons)
 
     safe_args(s, &argc, &argv);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = cons ? EXPR_NEW : EXPR_CALL;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -284,19 +295,19 @@ void expr_end_typeinit_void(intend_state *s, int type)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_CALL;
     ex->file = s->source_file;
     ex->line = s->source_line;
     switch (type) {
         case 1: // TYPE_ARRAY
-            asprintf(&(ex->name), "mkarray");
+            ex->name = parser_arena_intern(s, "mkarray");
             break;
         case 2: // TYPE_STRUCT
-            asprintf(&(ex->name), "mkstruct");
+            ex->name = parser_arena_intern(s, "mkstruct");
             break;
         default: // This should never happen
-            asprintf(&(ex->name), "invalid_type_initialization");
+            ex->name = parser_arena_intern(s, "invalid_type_initialization");
             break;
     }
 
@@ -314,19 +325,19 @@ void expr_end_typeinit(intend_state *s, int type)
 
     safe_args(s, &argc, &argv);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_CALL;
     ex->file = s->source_file;
     ex->line = s->source_line;
     switch (type) {
         case 1: // TYPE_ARRAY
-            asprintf(&(ex->name), "mkkeyarray");
+            ex->name = parser_arena_intern(s, "mkkeyarray");
             break;
         case 2: // TYPE_STRUCT
-            asprintf(&(ex->name), "mkstruct");
+            ex->name = parser_arena_intern(s, "mkstruct");
             break;
         default: // This should never happen
-            asprintf(&(ex->name), "invalid_type_initialization");
+            ex->name = parser_arena_intern(s, "invalid_type_initialization");
             break;
     }
     ex->argc = argc;
@@ -361,12 +372,11 @@ void expr_end_use(intend_state *s)
 
     safe_args(s, &argc, &argv);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_CALL;
     ex->file = s->source_file;
     ex->line = s->source_line;
-    asprintf(&(ex->name), "module_load");
-    oom(ex->name);
+    ex->name = parser_arena_intern(s, "module_load");
     ex->argc = argc;
     ex->argv = argv;
 
@@ -384,7 +394,7 @@ void expr_end_static(intend_state *s, char *tname, char *name)
 
     safe_args(s, &argc, &argv);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_STATIC;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -407,7 +417,7 @@ void expr_end_method(intend_state *s, char *name)
 
     safe_args(s, &argc, &argv);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_METHOD;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -426,7 +436,7 @@ void expr_end_ref(intend_state *s, char *name)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_REF;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -446,7 +456,7 @@ void expr_end_index(intend_state *s)
 
     safe_args(s, &argc, &argv);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_INDEX;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -468,7 +478,7 @@ void expr_end_ref_array(intend_state *s, char *name)
 
     safe_args(s, &argc, &argv);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_REF_ARRAY;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -486,11 +496,12 @@ static void expr_end_const(intend_state *s, expr_type type, char *val)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = type;
     ex->file = s->source_file;
     ex->line = s->source_line;
     ex->name = val;
+    expr_decode(ex);
 
     expr_stack_push(s, ex);
 }
@@ -508,12 +519,7 @@ void expr_end_const_bool(intend_state *s, char *val)
  */
 void expr_end_true(intend_state *s)
 {
-    char *str;
-
-    str = oom(malloc(5));
-    strcpy(str, "true");
-
-    expr_end_const(s, EXPR_CONST_BOOL, str);
+    expr_end_const(s, EXPR_CONST_BOOL, parser_arena_strdup(s, "true"));
 }
 
 /*
@@ -566,7 +572,7 @@ void expr_end_infix(intend_state *s, op_type type)
     two = expr_stack_pop(s);
     one = expr_stack_pop(s);
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_INFIX;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -584,7 +590,7 @@ void expr_end_postfix(intend_state *s, op_type type)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_POSTFIX;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -601,7 +607,7 @@ void expr_end_prefix(intend_state *s, op_type type)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_PREFIX;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -634,7 +640,7 @@ void expr_end_static_ref(intend_state *s, char *tname, char *name)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_STATIC_REF;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -651,7 +657,7 @@ void expr_end_if(intend_state *s)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_IF;
     ex->file = s->source_file;
     ex->line = s->source_line;
@@ -669,7 +675,7 @@ void expr_end_pass_ref(intend_state *s)
 {
     expr *ex;
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->type = EXPR_PASS_REF;
     ex->file = s->source_file;
     ex->line = s->source_line;
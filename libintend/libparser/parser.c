@@ -98,11 +98,16 @@ int parser_run(intend_state *s, FILE *file)
     // Did we get an error? Return false
     if (p->parser_error != 0) {
         stmt_stack_leave(s, 1);
+        parser_arena_free(p->arena);
+        p->arena = NULL;
         return 0;
     }
 
-    // Save a pointer to the parsed statement stack in state->script
+    // Save a pointer to the parsed statement stack in state->script,
+    // which keeps the arena of the parsed nodes
     s->script = stmt_stack_leave(s, 0);
+    ((stmt_list *) s->script)->arena = p->arena;
+    p->arena = NULL;
 
     // Done with success
     return 1;
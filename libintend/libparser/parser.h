@@ -60,6 +60,14 @@ void parser_error(intend_state *state, char *msg);
 void parser_enter_include(intend_state *state, char *path);
 void parser_include_teardown(intend_state *state);
 
+/*
+ * Memory arena of parsed script
+ */
+void *parser_arena_alloc(intend_state *s, unsigned int size);
+char *parser_arena_strdup(intend_state *s, const char *str);
+char *parser_arena_intern(intend_state *s, const char *str);
+void parser_arena_free(void *arena);
+
 /*
  * -- statements --
  */
@@ -109,28 +117,36 @@ typedef struct stmt {
     char            *proto;
     char            rettype;
     char            **names;
+    void            *code;      /* compiled bytecode, owned by evaluator */
+    void            *frame;     /* local slot layout of function bodies */
+    int             varargs;    /* function body names argc or argv */
+    int             tail;       /* return of a call in tail position */
 } stmt;
 
 /*
  * Statement memory management
  */
-stmt *stmt_alloc(void);
-void stmt_free(stmt *st);
+stmt *stmt_alloc(intend_state *s);
+void stmt_release(stmt *st);
 
 /*
  * Statement list
  */
 typedef struct {
     unsigned int    len;
+    unsigned int    size;       /* allocated list entries */
     stmt            **list;
+    void            *code;      /* compiled bytecode, owned by evaluator */
+    void            *arena;     /* node memory, kept by script list */
 } stmt_list;
 
 /*
  * Statement list management
  */
-stmt_list *stmt_list_alloc();
+stmt_list *stmt_list_alloc(intend_state *s);
+void stmt_list_release(stmt_list *list);
 void stmt_list_free(stmt_list *list);
-void stmt_list_push(stmt_list *list, stmt *stmt);
+void stmt_list_push(intend_state *s, stmt_list *list, stmt *stmt);
 stmt *stmt_list_pop(stmt_list *list);
 
 /*
@@ -225,14 +241,25 @@ typedef struct expr {
     EXPR            **argv;
     op_type         op;
     stmt            *lambda;
+    void            *cval;      /* decoded constant value */
+    void            *frame;     /* slot layout of enclosing function */
+    int             slot;       /* local slot in frame */
+    unsigned long   cache;      /* inline cache: symbol table version */
+    unsigned long   cache_scope;/* inline cache: local layout version */
+    int             cache_pos;  /* inline cache: position of entry */
 } expr;
 
 /*
  * Expression memory management
  */
-expr *expr_alloc(void);
-expr *expr_copy(expr *ex);
-void expr_free(expr *ex);
+expr *expr_alloc(intend_state *s);
+expr *expr_copy(intend_state *s, expr *ex);
+void expr_release(expr *ex);
+
+/*
+ * Constant expression decoding
+ */
+void expr_decode(expr *ex);
 
 /*
  * Expression stack
@@ -370,6 +397,8 @@ typedef struct parser_data {
     char            *fn_rettype;
     // name of parent class
     char            *class_parent;
+    // memory of parsed nodes and names
+    void            *arena;
 } parser_data;
 
 /*
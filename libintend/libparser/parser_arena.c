@@ -0,0 +1,186 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Parser memory arena
+ *
+ * Expression and statement nodes, names and argument vectors of a
+ * script are carved from large blocks in the order the parser
+ * builds them, which keeps the children of a node next to it in
+ * memory. The blocks are freed together with the script.
+ *
+ * Identifiers are interned. Each block lists the names interned
+ * for it, and releases them when it is freed.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "../libruntime/runtime.h"
+
+/*
+ * Bytes of data per block
+ */
+#define ARENA_BLOCK     65536
+
+/*
+ * Alignment of allocations
+ */
+#define ARENA_ALIGN     8
+
+/*
+ * Interned name held by arena
+ */
+typedef struct arena_name_s {
+    struct arena_name_s *next;      /* next name of the block */
+    char            *name;          /* interned name */
+} arena_name;
+
+/*
+ * Arena block
+ */
+typedef struct arena_block_s {
+    struct arena_block_s *next;     /* next block of the arena */
+    arena_name      *names;         /* names held by block */
+    unsigned int    used;           /* bytes in use */
+    unsigned int    size;           /* bytes of data */
+    double          data[1];        /* start of data */
+} arena_block;
+
+/*
+ * Allocate new block
+ */
+static arena_block *block_alloc(unsigned int size)
+{
+    arena_block *block;
+
+    block = oom(malloc(offsetof(arena_block, data) + size));
+    block->next = NULL;
+    block->names = NULL;
+    block->used = 0;
+    block->size = size;
+    return block;
+}
+
+/*
+ * Allocate zeroed memory from parser arena
+ *
+ * Requests too large to share a block get a block of their own,
+ * linked behind the block in use.
+ */
+void *parser_arena_alloc(intend_state *s, unsigned int size)
+{
+    parser_data *p;
+    arena_block *block;
+    void *ptr;
+
+    sanity(s && s->parser);
+
+    p = s->parser;
+    block = p->arena;
+
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    if (size > ARENA_BLOCK / 4) {
+        block = block_alloc(size);
+        if (p->arena) {
+            block->next = ((arena_block *) p->arena)->next;
+            ((arena_block *) p->arena)->next = block;
+        } else {
+            p->arena = block;
+        }
+        block->used = size;
+        return memset(block->data, 0, size);
+    }
+
+    if (!block || block->size - block->used < size) {
+        block = block_alloc(ARENA_BLOCK);
+        block->next = p->arena;
+        p->arena = block;
+    }
+
+    ptr = (char *) block->data + block->used;
+    block->used += size;
+    return memset(ptr, 0, size);
+}
+
+/*
+ * Copy string to parser arena
+ */
+char *parser_arena_strdup(intend_state *s, const char *str)
+{
+    char *copy;
+
+    sanity(str);
+
+    copy = parser_arena_alloc(s, strlen(str) + 1);
+    strcpy(copy, str);
+    return copy;
+}
+
+/*
+ * Intern name for parser arena
+ *
+ * The name is released together with the arena.
+ */
+char *parser_arena_intern(intend_state *s, const char *str)
+{
+    arena_name *rec;
+    arena_block *block;
+
+    sanity(str);
+
+    rec = parser_arena_alloc(s, sizeof(arena_name));
+    block = ((parser_data *) s->parser)->arena;
+    rec->name = intern(str);
+    rec->next = block->names;
+    block->names = rec;
+    return rec->name;
+}
+
+/*
+ * Free parser arena
+ */
+void parser_arena_free(void *arena)
+{
+    arena_block *block, *next;
+    arena_name *rec;
+
+    for (block = arena; block; block = next) {
+        next = block->next;
+        for (rec = block->names; rec; rec = rec->next) {
+            intern_release(rec->name);
+        }
+        free(block);
+    }
+}
@@ -35,29 +35,30 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "parser.h"
 
 /*
  * Add statement to list
+ *
+ * The list grows by doubling in the parser arena.
  */
-void stmt_list_push(stmt_list *list, stmt *st)
+void stmt_list_push(intend_state *s, stmt_list *list, stmt *st)
 {
     stmt **elems;
 
     sanity(list && st);
 
-    if (list->len == 0) {
-        elems = oom(malloc(sizeof(stmt *)));
-        *elems = st;
-        list->list = elems;
-        list->len = 1;
-    } else {
-        elems = oom(realloc(list->list, (list->len + 1) * sizeof(stmt *)));
+    if (list->len == list->size) {
+        list->size = list->size ? list->size * 2 : 4;
+        elems = parser_arena_alloc(s, list->size * sizeof(stmt *));
+        if (list->len > 0) {
+            memcpy(elems, list->list, list->len * sizeof(stmt *));
+        }
         list->list = elems;
-        elems += list->len++;
-        *elems = st;
     }
+    list->list[list->len++] = st;
 }
 
 /*
@@ -37,58 +37,50 @@
 #include <string.h>
 
 #include "parser.h"
+#include "../libruntime/runtime.h"
 
 /*
  * Allocate statement structure
  */
-stmt *stmt_alloc(void)
+stmt *stmt_alloc(intend_state *s)
 {
-    return oom(calloc(sizeof(stmt), 1));
+    return parser_arena_alloc(s, sizeof(stmt));
 }
 
 /*
- * Free statment structure
+ * Release statement structure
+ *
+ * Frees the data of the statement that is not kept in the parser
+ * arena. The nodes themselves are freed with the arena.
  */
-void stmt_free(stmt *st)
+void stmt_release(stmt *st)
 {
     if (!st) {
         return;
     }
 
-    if (st->init) expr_free(st->init);
-    if (st->expr) expr_free(st->expr);
-    if (st->guard) expr_free(st->guard);
-    if (st->true_case) stmt_free(st->true_case);
-    if (st->false_case) stmt_free(st->false_case);
-    if (st->block) stmt_list_free((stmt_list *) st->block);
+    expr_release(st->init);
+    expr_release(st->expr);
+    expr_release(st->guard);
+    stmt_release(st->true_case);
+    stmt_release(st->false_case);
+    stmt_list_release((stmt_list *) st->block);
 
-    if (st->args > 0) {
-        unsigned int i;
-
-        for (i = 0; i < st->args; i++) {
-            free(st->names[i]);
-        }
-    }
-
-    free(st->name);
-    free(st->proto);
-    free(st->names);
-
-    free(st);
+    symtab_frame_free(st->frame);
 }
 
 /*
  * Allocate statement list structure
  */
-stmt_list *stmt_list_alloc(void)
+stmt_list *stmt_list_alloc(intend_state *s)
 {
-    return oom(calloc(sizeof(stmt_list), 1));
+    return parser_arena_alloc(s, sizeof(stmt_list));
 }
 
 /*
- * Free statement list structure
+ * Release statement list structure
  */
-void stmt_list_free(stmt_list *list)
+void stmt_list_release(stmt_list *list)
 {
     unsigned int i;
 
@@ -97,8 +89,22 @@ void stmt_list_free(stmt_list *list)
     }
 
     for (i = 0; i < list->len; i++) {
-        stmt_free(list->list[i]);
+        stmt_release(list->list[i]);
     }
-    free(list->list);
-    free(list);
+}
+
+/*
+ * Free script statement list
+ *
+ * Releases the statements of a parsed script and frees the arena
+ * holding them.
+ */
+void stmt_list_free(stmt_list *list)
+{
+    if (!list) {
+        return;
+    }
+
+    stmt_list_release(list);
+    parser_arena_free(list->arena);
 }
@@ -66,7 +66,7 @@ void stmt_end_block(intend_state *s)
 {
     stmt *st;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_BLOCK;
     st->block = (STMT_LIST *) stmt_stack_leave(s, 0);
 
@@ -92,7 +92,7 @@ void stmt_end_if(intend_state *s)
     two = stmt_stack_pop(s);
     stmt_stack_leave(s, 1);
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     if (two) {
         st->type = STMT_IF_ELSE;
         st->true_case = two;
@@ -121,7 +121,7 @@ void stmt_end_while(intend_state *s)
 {
     stmt *st;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_WHILE;
     st->expr = expr_stack_pop(s);
     st->true_case = safe_pop(s);
@@ -146,7 +146,7 @@ void stmt_end_do(intend_state *s)
 {
     stmt *st;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_DO;
     st->expr = expr_stack_pop(s);
     st->true_case = safe_pop(s);
@@ -176,7 +176,7 @@ void stmt_end_for(intend_state *s)
     expr = expr_stack_pop(s);
     init = expr_stack_pop(s);
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_FOR;
     st->init = init;
     st->expr = expr;
@@ -195,7 +195,7 @@ static void end_simple(intend_state *s, stmt_type type)
 {
     stmt *st;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = type;
 
     stmt_stack_push(s, st);
@@ -208,7 +208,7 @@ static void end_simple_expr(intend_state *s, stmt_type type)
 {
     stmt *st;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = type;
     st->expr = expr_stack_pop(s);
 
@@ -293,6 +293,34 @@ void stmt_end_arg(intend_state *s, char typespec, char *name)
     p->fn_arg_names[p->fn_arg_depth - 1] = names;
 }
 
+/*
+ * Move argument definitions of function to statement
+ *
+ * The lists are built on the heap while arguments are added, and
+ * copied to the parser arena when the function is complete.
+ */
+static void end_args(intend_state *s, stmt *st)
+{
+    parser_data *p;
+    unsigned int depth;
+
+    p = (parser_data *)s->parser;
+    depth = p->fn_arg_depth;
+
+    st->args = p->fn_arg_count[depth];
+    if (p->fn_arg_types[depth]) {
+        st->proto = parser_arena_strdup(s, p->fn_arg_types[depth]);
+        free(p->fn_arg_types[depth]);
+        p->fn_arg_types[depth] = NULL;
+    }
+    if (p->fn_arg_names[depth]) {
+        st->names = parser_arena_alloc(s, st->args * sizeof(char *));
+        memcpy(st->names, p->fn_arg_names[depth], st->args * sizeof(char *));
+        free(p->fn_arg_names[depth]);
+        p->fn_arg_names[depth] = NULL;
+    }
+}
+
 /*
  * Start function declaration
  */
@@ -349,14 +377,12 @@ void stmt_end_func(intend_state *s, char *name)
 
     --p->fn_arg_depth;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_FUNC;
     st->true_case = safe_pop(s);
     st->name = name;
-    st->args = p->fn_arg_count[p->fn_arg_depth];
-    st->proto = p->fn_arg_types[p->fn_arg_depth];
+    end_args(s, st);
     st->rettype = p->fn_rettype[p->fn_arg_depth];
-    st->names = p->fn_arg_names[p->fn_arg_depth];
 
     stmt_stack_leave(s, 1);
 
@@ -378,7 +404,7 @@ void stmt_end_switch(intend_state *s)
 {
     stmt *st;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_SWITCH;
     st->expr = expr_stack_pop(s);
     st->block = (STMT_LIST *) stmt_stack_leave(s, 0);
@@ -408,7 +434,7 @@ void stmt_end_case(intend_state *s, char thru)
         thru = 0;
     }
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_CASE;
     st->expr = expr_stack_pop(s);
     st->block = (STMT_LIST *) list;
@@ -424,7 +450,7 @@ void stmt_end_default(intend_state *s)
 {
     stmt *st;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_DEFAULT;
     st->block = (STMT_LIST *) stmt_stack_leave(s, 0);
     st->thru = 0;
@@ -447,7 +473,7 @@ void stmt_end_try(intend_state *s, char *name)
 {
     stmt *st;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_TRY;
     st->false_case = safe_pop(s);
     st->true_case = safe_pop(s);
@@ -500,7 +526,7 @@ void stmt_end_class(intend_state *s, char *name)
 
     p = (parser_data *)s->parser;
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_CLASS;
     st->name = name;
     st->proto = p->class_parent;
@@ -535,23 +561,20 @@ void expr_end_lambda(intend_state *s)
 
     --p->fn_arg_depth;
 
-    name = oom(malloc(strlen("\\lambda") + 1));
-    strcpy(name, "\\lambda");
+    name = parser_arena_intern(s, "\\lambda");
 
-    block = stmt_alloc();
+    block = stmt_alloc(s);
     block->type = STMT_BLOCK;
     block->block = (STMT_LIST *) stmt_stack_leave(s, 0);
 
-    st = stmt_alloc();
+    st = stmt_alloc(s);
     st->type = STMT_FUNC;
     st->true_case = block;
     st->name = name;
-    st->args = p->fn_arg_count[p->fn_arg_depth];
-    st->proto = p->fn_arg_types[p->fn_arg_depth];
+    end_args(s, st);
     st->rettype = '?';
-    st->names = p->fn_arg_names[p->fn_arg_depth];
 
-    ex = expr_alloc();
+    ex = expr_alloc(s);
     ex->file = s->source_file;
     ex->line = s->source_line;
     ex->type = EXPR_LAMBDA;
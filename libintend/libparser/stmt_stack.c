@@ -52,7 +52,7 @@ void stmt_stack_enter(intend_state *s)
 
     copy = oom(realloc(p->stack, (p->stack_depth + 1) * sizeof(stmt_list *)));
     p->stack = copy;
-    p->stack[p->stack_depth++] = stmt_list_alloc();
+    p->stack[p->stack_depth++] = stmt_list_alloc(s);
 }
 
 /*
@@ -76,7 +76,7 @@ stmt_list *stmt_stack_leave(intend_state *s, int free)
 
     p->stack_depth--;
     if (free) {
-        stmt_list_free(p->stack[p->stack_depth]);
+        stmt_list_release(p->stack[p->stack_depth]);
     } else {
         list = p->stack[p->stack_depth];
     }
@@ -97,7 +97,7 @@ void stmt_stack_push(intend_state *s, stmt *st)
 
     sanity(p->stack_depth > 0);
 
-    stmt_list_push(p->stack[p->stack_depth - 1], st);
+    stmt_list_push(s, p->stack[p->stack_depth - 1], st);
 }
 
 /*
@@ -144,8 +144,8 @@ const char *call_typename(value_type type)
 void call_check(intend_state *s, const char *name, signature *sig,
                 unsigned int argc, value **argv)
 {
-    char *arg;
-    unsigned int i = 0;
+    unsigned char check;
+    unsigned int i;
 
     sanity(name && sig && (argc == 0 || argv));
 
@@ -154,28 +154,49 @@ void call_check(intend_state *s, const char *name, signature *sig,
               argc, sig->args);
         return;
     }
-    if (sig->args == 0 && !sig->proto) {
-        return;
-    }
-    arg = sig->proto;
-    while (arg && *arg) {
-        if (*arg == '*') return;
+
+    for (i = 0; i < sig->nchecks && i < argc; i++) {
+        check = sig->checks[i];
 
         sanity(argv[i]);
 
-        if (*arg != '?' && call_typechar(argv[i]) != tolower(*arg)) {
-            if (islower(*arg)) {
-                fatal(s, "function `%s': arg %u type mismatch (`%s' instead of `%s')",
-                      name, i + 1, call_typename(argv[i]->type),
-                      call_typename(call_chartype(*arg))
-                     );
-                return;
-            } else {
-                value_cast_inplace(s, &argv[i], call_chartype(tolower(*arg)));
-            }
+        if ((check & CALL_CHECK_ANY) ||
+                argv[i]->type == (check & CALL_CHECK_TYPE)) {
+            continue;
+        }
+        if (!(check & CALL_CHECK_CAST)) {
+            fatal(s, "function `%s': arg %u type mismatch (`%s' instead of `%s')",
+                  name, i + 1, call_typename(argv[i]->type),
+                  call_typename(call_chartype(sig->proto[i]))
+                 );
+            return;
         }
+        value_cast_inplace(s, &argv[i], call_chartype(tolower(sig->proto[i])));
+    }
+}
+
+/*
+ * Type-check function result
+ *
+ * This function checks the result of a call against the return
+ * type of the function, as compiled into the check code. Results
+ * of calls that raised an exception or exited are left alone.
+ */
+void call_check_return(intend_state *s, const char *name, char rettype,
+                       unsigned char check, value **result)
+{
+    sanity(name && result && *result);
 
-        i++;
-        arg++;
+    if (s->except_flag || s->exit_flag || (check & CALL_CHECK_ANY) ||
+            (*result)->type == (check & CALL_CHECK_TYPE)) {
+        return;
+    }
+    if (!(check & CALL_CHECK_CAST)) {
+        fatal(s, "function `%s': return type mismatch (`%s' instead of `%s')",
+              name, call_typename((*result)->type),
+              call_typename(call_chartype(rettype))
+             );
+        return;
     }
+    value_cast_inplace(s, result, call_chartype(tolower(rettype)));
 }
@@ -45,8 +45,6 @@ value *call_function(intend_state *s, signature *sig, unsigned int argc,
                      value **argv)
 {
     value *result = NULL;
-    char rettype;
-    int realtype;
 
     sanity(sig && (argc == 0 || argv));
 
@@ -70,23 +68,7 @@ value *call_function(intend_state *s, signature *sig, unsigned int argc,
         result = value_make_void();
     }
 
-    if (s->except_flag || s->exit_flag) {
-        rettype = '?';
-    } else {
-        rettype = sig->rettype;
-    }
-
-    if (rettype != '?' && call_typechar(result) != tolower(rettype)) {
-        if (islower(rettype) || rettype == 'P') {
-            realtype = result->type;
-            fatal(s, "function `%s': return type mismatch (`%s' instead of `%s')",
-                  sig->name, call_typename(realtype),
-                  call_typename(call_chartype(rettype))
-                 );
-        } else {
-            value_cast_inplace(s, &result, call_chartype(tolower(rettype)));
-        }
-    }
+    call_check_return(s, sig->name, sig->rettype, sig->retcheck, &result);
     return result;
 }
 
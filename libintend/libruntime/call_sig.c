@@ -33,6 +33,7 @@
  * Intend C Function call memory
  */
 
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -50,6 +51,7 @@ signature *call_sig_alloc(void)
 
     sig = oom(calloc(sizeof(signature), 1));
     sig->rettype = '?';
+    sig->retcheck = CALL_CHECK_ANY;
 
     return sig;
 }
@@ -68,11 +70,12 @@ signature *call_sig_copy_to(signature *copy, const signature *sig)
     if (!sig) return NULL;
 
     proto = xstrdup(sig->proto);
-    name = xstrdup(sig->name);
+    name = intern(sig->name);
 
     memcpy(copy, sig, sizeof(signature));
     copy->proto = proto;
     copy->name  = name;
+    call_sig_compile(copy);
     return copy;
 }
 
@@ -104,8 +107,9 @@ void call_sig_cleanup(signature *sig)
     // Avoid null signatures
     if (!sig) return;
 
-    if (sig->name) free(sig->name);
+    intern_release(sig->name);
     if (sig->proto) free(sig->proto);
+    free(sig->checks);
     memset(sig, 0, sizeof(signature));
 }
 
@@ -140,8 +144,6 @@ signature *call_sig_builtin(const char *name, unsigned int args,
     signature *sig;
     int proto_len;
     char *proto_copy;
-    int name_len;
-    char *name_copy;
 
     sig = call_sig_alloc();
 
@@ -149,14 +151,73 @@ signature *call_sig_builtin(const char *name, unsigned int args,
     proto_copy = oom(malloc(proto_len + 1));
     strcpy(proto_copy, proto);
 
-    name_len = strlen(name);
-    name_copy = oom(malloc(name_len + 1));
-    strcpy(name_copy, name);
-
     sig->type = FUNCTION_TYPE_BUILTIN;
     sig->args = args;
-    sig->name = name_copy;
+    sig->name = intern(name);
     sig->proto = proto_copy;
     sig->call_u.builtin_vector = vector;
+    call_sig_compile(sig);
     return sig;
 }
+
+/*
+ * Compile type character of prototype
+ */
+static unsigned char compile_type(char type)
+{
+    unsigned char check;
+
+    if (type == '?') {
+        return CALL_CHECK_ANY;
+    }
+
+    check = call_chartype(tolower(type));
+    if (check == VALUE_TYPE_VOID && tolower(type) != 'v') {
+        check = CALL_CHECK_NONE;
+    }
+    if (isupper(type)) {
+        check |= CALL_CHECK_CAST;
+    }
+    return check;
+}
+
+/*
+ * Compile function prototype
+ *
+ * This function compiles the prototype and return type of the
+ * given signature, so that calls compare value types instead of
+ * type characters. Checks end at a `*' in the prototype, and
+ * trailing arguments of any type are left out. A forced fn is
+ * never cast to when returned.
+ */
+void call_sig_compile(signature *sig)
+{
+    unsigned int i, len = 0;
+
+    sanity(sig);
+
+    sig->checks = NULL;
+    sig->nchecks = 0;
+    sig->retcheck = compile_type(sig->rettype);
+    if (sig->rettype == 'P') {
+        sig->retcheck &= ~CALL_CHECK_CAST;
+    }
+
+    if (!sig->proto) {
+        return;
+    }
+    for (i = 0; sig->proto[i] && sig->proto[i] != '*'; i++) {
+        if (sig->proto[i] != '?') {
+            len = i + 1;
+        }
+    }
+    if (len == 0) {
+        return;
+    }
+
+    sig->checks = oom(malloc(len));
+    for (i = 0; i < len; i++) {
+        sig->checks[i] = compile_type(sig->proto[i]);
+    }
+    sig->nchecks = len;
+}
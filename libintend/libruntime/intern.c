@@ -0,0 +1,251 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Interned names
+ *
+ * Names of variables, functions, struct fields and array keys are
+ * kept once for the whole process. Every holder of a name counts
+ * as one reference, and the name is freed with its last reference.
+ * Equal names are the same pointer, so symbol tables compare names
+ * by address, and the hash value of a name is stored with it.
+ *
+ * Names are shared by all contexts. The table is only used under
+ * the lock, and reference counts are changed with atomic operations.
+ * A name can only lose its last reference under the lock, so it is
+ * never freed while intern() finds it.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "runtime.h"
+
+/*
+ * Interned name
+ */
+typedef struct {
+    unsigned int    refcount;   /* holders of the name */
+    unsigned int    hash;       /* symtab_hash_symbol() of name */
+    unsigned int    len;        /* length of name */
+    char            name[1];    /* the name itself */
+} intern_name;
+
+/*
+ * Header of interned name
+ */
+#define HEADER(n) ((intern_name *) ((n) - offsetof(intern_name, name)))
+
+/*
+ * Marker of deleted table positions
+ */
+#define DELETED ((intern_name *) 1)
+
+/*
+ * Order of the initial table
+ */
+#define INTERN_ORDER    10
+
+/*
+ * Open addressed table of all interned names
+ */
+static intern_name **table;
+static unsigned int order;
+static unsigned int count;
+static unsigned int deleted;
+
+/*
+ * Lock of table
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Find table position of name
+ *
+ * Returns the position of the name, or of the free position that
+ * ends its probe sequence if it is not interned.
+ */
+static unsigned int find(const char *str, unsigned int len,
+                         unsigned int hash)
+{
+    unsigned int mask, i;
+    intern_name *n;
+
+    mask = (1u << order) - 1;
+    for (i = hash & mask; (n = table[i]); i = (i + 1) & mask) {
+        if (n != DELETED && n->hash == hash && n->len == len &&
+                memcmp(n->name, str, len) == 0) {
+            break;
+        }
+    }
+    return i;
+}
+
+/*
+ * Rebuild table
+ *
+ * Moves all names to a table of the given order, dropping the
+ * markers of deleted names.
+ */
+static void rehash(unsigned int neworder)
+{
+    intern_name **old = table;
+    unsigned int size = 1u << order;
+    unsigned int mask, i, j;
+
+    table = oom(calloc(1u << neworder, sizeof(intern_name *)));
+    mask = (1u << neworder) - 1;
+    for (i = 0; old && i < size; i++) {
+        if (old[i] && old[i] != DELETED) {
+            for (j = old[i]->hash & mask; table[j]; j = (j + 1) & mask);
+            table[j] = old[i];
+        }
+    }
+    free(old);
+    order = neworder;
+    deleted = 0;
+}
+
+/*
+ * Intern name
+ *
+ * Returns the interned copy of the given string, which must be
+ * given back with intern_release().
+ */
+char *intern(const char *str)
+{
+    unsigned int hash, len, i;
+    intern_name *n;
+
+    if (!str) {
+        return NULL;
+    }
+
+    len = strlen(str);
+    hash = symtab_hash_symbol(str);
+
+    pthread_mutex_lock(&lock);
+    if (!table) {
+        rehash(INTERN_ORDER);
+    } else if ((count + deleted + 1) * 4 > (1u << order) * 3) {
+        rehash((count + 1) * 2 > (1u << order) ? order + 1 : order);
+    }
+
+    i = find(str, len, hash);
+    if (table[i]) {
+        n = table[i];
+        __sync_add_and_fetch(&n->refcount, 1);
+    } else {
+        n = oom(malloc(offsetof(intern_name, name) + len + 1));
+        n->refcount = 1;
+        n->hash = hash;
+        n->len = len;
+        memcpy(n->name, str, len + 1);
+
+        table[i] = n;
+        ++count;
+    }
+    pthread_mutex_unlock(&lock);
+
+    return n->name;
+}
+
+/*
+ * Reference interned name
+ *
+ * Counts one more holder of a name returned by intern().
+ */
+char *intern_ref(char *name)
+{
+    if (name) {
+        __sync_add_and_fetch(&HEADER(name)->refcount, 1);
+    }
+    return name;
+}
+
+/*
+ * Release interned name
+ *
+ * The name is freed when its last holder releases it, and the
+ * table once no names are left.
+ */
+void intern_release(char *name)
+{
+    intern_name *n;
+    unsigned int mask, i, refs;
+
+    if (!name) {
+        return;
+    }
+
+    /* names with other holders are released without the lock */
+    n = HEADER(name);
+    refs = __atomic_load_n(&n->refcount, __ATOMIC_RELAXED);
+    while (refs > 1) {
+        if (__sync_bool_compare_and_swap(&n->refcount, refs, refs - 1)) {
+            return;
+        }
+        refs = __atomic_load_n(&n->refcount, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_lock(&lock);
+    sanity(__atomic_load_n(&n->refcount, __ATOMIC_RELAXED) > 0);
+    if (__sync_sub_and_fetch(&n->refcount, 1) > 0) {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    mask = (1u << order) - 1;
+    for (i = n->hash & mask; table[i] != n; i = (i + 1) & mask);
+    table[i] = DELETED;
+    ++deleted;
+    free(n);
+
+    if (--count == 0) {
+        free(table);
+        table = NULL;
+        order = 0;
+        deleted = 0;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Get hash value of interned name
+ *
+ * Same as symtab_hash_symbol(), without hashing the name again.
+ */
+unsigned int intern_hash(const char *name)
+{
+    return HEADER(name)->hash;
+}
@@ -39,6 +39,8 @@
 #ifndef INTEND_RUNTIME_H
 #define INTEND_RUNTIME_H
 
+#include <stddef.h>
+
 #include "../libmisc/misc.h"
 
 #define DEBUG 0
@@ -64,34 +66,72 @@ typedef enum {
 } value_type;
 
 /*
- * Minimum string chars allocated
+ * String value structure
+ *
+ * Short strings are kept inside the value itself. The data of
+ * longer ones lives in a reference counted buffer that is shared
+ * by all copies of the value. String data is never modified once
+ * it is shared. Which storage a string uses only depends on its
+ * length, which is kept in the value header, see STRLEN_OF().
+ */
+typedef struct {
+    int     size;           /* allocated chars of buffer */
+    char    *value;         /* data of shared buffer */
+} value_heap_string;
+
+typedef union {
+    value_heap_string   heap;
+    char                local[sizeof(value_heap_string)];
+} value_string;
+
+/*
+ * Maximum string chars kept inside the value
  */
-#define STRING_MIN_CHARS 64
+#define STRING_INLINE_CHARS ((int) sizeof(((value_string *) 0)->local) - 1)
 
 /*
- * String value structure
+ * Shared string buffer
  */
 typedef struct {
-    int     len;
-    int     size;
-    char    *value;
-} value_string;
+    int     refcount;
+    char    data[1];
+} value_buffer;
 
 /*
  * Minimum array growth unit
  */
 #define ARRAY_GROWTH 32
 
+/*
+ * Array element kinds
+ *
+ * Typed arrays store raw numbers instead of values.
+ */
+typedef enum {
+    ARRAY_KIND_VALUE = 0,
+    ARRAY_KIND_INT,
+    ARRAY_KIND_FLOAT
+} array_kind;
+
 /*
  * Array value structure
+ *
+ * Elements are stored contiguously. Arrays indexed only by number
+ * have neither keys nor names; both are allocated once the first
+ * element is added with a string key. Typed arrays keep their
+ * elements in data instead and never have keys.
  */
 typedef struct symtab SYMTAB;
-typedef struct symtab_entry ENTRY;
 typedef struct {
-    int         len;
-    int         size;
-    SYMTAB      *keys;
-    ENTRY       **values;
+    int             refcount;
+    int             bound;      /* copies bound to calls */
+    int             len;
+    int             size;
+    array_kind      kind;
+    SYMTAB          *keys;      /* key to index, NULL without keys */
+    char            **names;    /* interned key of each element or NULL */
+    struct value    *values;    /* elements */
+    void            *data;      /* raw elements of typed arrays */
 } value_array;
 
 /*
@@ -104,17 +144,31 @@ typedef struct {
     void    *data;
 } value_res;
 
+/*
+ * Call bindings of array and struct values, see value_bind()
+ */
+#define VALUE_BIND_NONE     0
+#define VALUE_BIND_HOLD     1       /* held by the call */
+#define VALUE_BIND_WRITE    2       /* updated in place by the call */
+
 /*
  * Value union
+ *
+ * The header word after the type is only used by strings, arrays
+ * and structs, and only ever for one of them at a time.
  */
 typedef struct value {
     value_type          type;
+    union {
+        int             bind;       /* call binding of arrays and structs */
+        int             len;        /* chars of strings */
+    } head;
     union {
         int             bool_val;
         int             int_val;
         double          float_val;
         value_string    string_val;
-        value_array     array_val;
+        value_array     *array_val;
         value_res       *res_val;
         void            *struct_val;
         void            *fn_val;
@@ -128,26 +182,60 @@ typedef struct value {
 #define BOOL_OF(v) ((v)->value_u.bool_val)
 #define INT_OF(v) ((v)->value_u.int_val)
 #define FLOAT_OF(v) ((v)->value_u.float_val)
-#define STR_OF(v) ((v)->value_u.string_val.value)
-#define STRLEN_OF(v) ((v)->value_u.string_val.len)
-#define STRSIZE_OF(v) ((v)->value_u.string_val.size)
-#define ARR_OF(v) ((v)->value_u.array_val.values)
-#define ARRLEN_OF(v) ((v)->value_u.array_val.len)
-#define ARRSIZE_OF(v) ((v)->value_u.array_val.size)
-#define ARRKEYS_OF(v) ((v)->value_u.array_val.keys)
+#define BIND_OF(v) ((v)->head.bind)
+#define STRLEN_OF(v) ((v)->head.len)
+#define STRINLINE_OF(v) (STRLEN_OF(v) <= STRING_INLINE_CHARS)
+#define STR_OF(v) (STRINLINE_OF(v) ? (v)->value_u.string_val.local \
+                                   : (v)->value_u.string_val.heap.value)
+#define STRSIZE_OF(v) ((v)->value_u.string_val.heap.size)
+#define STRREF_OF(v) (((value_buffer *) ((v)->value_u.string_val.heap.value - \
+                                         offsetof(value_buffer, data)))->refcount)
+#define ARR_OF(v) ((v)->value_u.array_val->values)
+#define ARRLEN_OF(v) ((v)->value_u.array_val->len)
+#define ARRSIZE_OF(v) ((v)->value_u.array_val->size)
+#define ARRKEYS_OF(v) ((v)->value_u.array_val->keys)
+#define ARRNAMES_OF(v) ((v)->value_u.array_val->names)
+#define ARRKEY_OF(v, i) (ARRNAMES_OF(v) ? ARRNAMES_OF(v)[i] : NULL)
+#define ARRREF_OF(v) ((v)->value_u.array_val->refcount)
+#define ARRBOUND_OF(v) ((v)->value_u.array_val->bound)
+#define ARRKIND_OF(v) ((v)->value_u.array_val->kind)
+#define ARRINTS_OF(v) ((int *) (v)->value_u.array_val->data)
+#define ARRFLOATS_OF(v) ((double *) (v)->value_u.array_val->data)
 #define STRUCT_OF(v) ((v)->value_u.struct_val)
+#define STRUCTREF_OF(v) (((symtab *) STRUCT_OF(v))->refcount)
+#define STRUCTBOUND_OF(v) (((symtab *) STRUCT_OF(v))->bound)
 #define RES_OF(v) ((v)->value_u.res_val->data)
 #define RESREF_OF(v) ((v)->value_u.res_val->refcount)
 #define RESGET_OF(v) ((v)->value_u.res_val->get)
 #define RESRELEASE_OF(v) ((v)->value_u.res_val->release)
 #define FNSIG_OF(v) ((v)->value_u.fn_val)
 
+/*
+ * Small object allocation
+ */
+typedef struct slab_s slab;
+
+void *slab_alloc(unsigned int size);
+void slab_free(void *ptr, unsigned int size);
+slab *slab_new(void);
+void slab_release(slab *sl);
+
+/*
+ * Interned names
+ */
+char *intern(const char *str);
+char *intern_ref(char *name);
+void intern_release(char *name);
+unsigned int intern_hash(const char *name);
+
 /*
  * Memory management
  */
 value *value_alloc(value_type type);
+char *value_buffer_alloc(int size);
 void value_cleanup(value *val);
 void value_free(value *val);
+void value_move_to(value *copy, value *val);
 
 /*
  * Resource type management
@@ -164,6 +252,7 @@ value *value_make_float(double val);
 value *value_make_string(const char *str);
 value *value_make_memstring(const void *buf, int len);
 value *value_make_array(void);
+value *value_make_typed_array(array_kind kind);
 value *value_make_struct(void);
 value *value_make_fn(void *sig);
 value *value_make_resource(void *data, void (*release)(void *), void *(*get)(void *));
@@ -173,6 +262,17 @@ value *value_make_resource(void *data, void (*release)(void *), void *(*get)(voi
  */
 value *value_copy_to(value *copy, value *val);
 value *value_copy(value *val);
+void value_detach(value *val);
+void value_detach_fields(value *val);
+int value_bind(value *val, int bind);
+int value_bind_storage(value *val);
+void value_unbind(value *val);
+
+/*
+ * String management
+ */
+value *value_concat_string(value *a, value *b);
+void value_append_string(value *str, const void *data, int len);
 
 /*
  * Array management
@@ -180,11 +280,15 @@ value *value_copy(value *val);
 void value_add_to_array(value *arr, value *val);
 void value_set_array(value *arr, int pos, value *val);
 value *value_get_array(value *arr, int pos);
+value *value_ref_array(value *arr, int pos);
 void value_delete_array(value *arr, int pos);
+value *value_peek_array(value *arr, int pos, value *tmp);
+void value_array_to_kind(value *arr, array_kind kind);
 
 void value_add_to_key_array(value *arr, char *pos, value *val);
 void value_set_key_array(value *arr, char *pos, value *val);
 value *value_get_key_array(value *arr, char *pos);
+value *value_ref_key_array(value *arr, char *pos);
 void value_delete_key_array(value *arr, char *pos);
 
 /*
@@ -192,6 +296,7 @@ void value_delete_key_array(value *arr, char *pos);
  */
 void value_set_struct(value *st, const char *pos, value *val);
 value *value_get_struct(value *st, const char *pos);
+value *value_ref_struct(value *st, const char *pos);
 void value_delete_struct(value *st, const char *pos);
 
 /*
@@ -229,8 +334,24 @@ typedef value *(*call_func)(intend_state *s, unsigned int argc, value **argv);
 typedef value *(*user_func)(intend_state *s, void *data, void *def,
                             unsigned int args, unsigned int argc, value **argv);
 
+/*
+ * Compiled prototype entries
+ *
+ * Every argument type in a prototype is compiled to the value type
+ * it stands for, or the given flags for arguments of any type and
+ * for arguments that are cast to the type. Type characters that
+ * stand for no value type never match.
+ */
+#define CALL_CHECK_TYPE 0x0f
+#define CALL_CHECK_NONE 0x0f
+#define CALL_CHECK_ANY  0x10
+#define CALL_CHECK_CAST 0x20
+
 /*
  * Function call signature
+ *
+ * The prototype is compiled into checks when the signature is
+ * created or copied, see call_sig_compile().
  */
 typedef struct {
     function_type   type;
@@ -244,6 +365,9 @@ typedef struct {
         call_func   builtin_vector;
         user_func   userdef_vector;
     } call_u;
+    unsigned char   *checks;    /* compiled argument types */
+    unsigned int    nchecks;    /* number of checked arguments */
+    unsigned char   retcheck;   /* compiled return type */
 } signature;
 
 /*
@@ -262,12 +386,15 @@ signature *call_sig_copy(const signature *sig);
 void call_sig_cleanup(signature *sig);
 void call_sig_free(signature *sig);
 signature *call_sig_builtin(const char *name, unsigned int args, const char *p, call_func v);
+void call_sig_compile(signature *sig);
 
 /*
  * Function calls
  */
 void call_check(intend_state *s, const char *n, signature *sig,
                 unsigned int, value **);
+void call_check_return(intend_state *s, const char *n, char rettype,
+                       unsigned char check, value **result);
 value *call_function(intend_state *s, signature *sig, unsigned int, value **);
 value *call_named_function(intend_state *s, const char *n, unsigned int c,
                            value **argv);
@@ -286,14 +413,68 @@ value *value_call_struct_method(intend_state *s, const char *name, const char *m
  */
 
 /*
- * Symbol table size
+ * Order of the initial hash index of symbol tables
+ *
+ * Hash indexes are open addressed and grow with the number of
+ * entries, the order only sets the size they start with. Entries
+ * fill at most three quarters of the index.
+ */
+#define SYMTAB_DEFAULT_ORDER    8
+
+/*
+ * Order of local symbol tables
+ *
+ * Most names of function calls live in frame slots, so local
+ * symbol tables start with a small hash table.
+ */
+#define SYMTAB_LOCAL_ORDER      3
+
+/*
+ * Initial size of local symbol table stack
+ */
+#define SYMTAB_STACK_SIZE       16
+
+/*
+ * Order of struct symbol tables
+ *
+ * Fields of structs live in the slots of their shape, the hash
+ * table is only used for structs with many fields.
+ */
+#define SYMTAB_STRUCT_ORDER     1
+
+/*
+ * Maximum number of fields in struct shape
+ */
+#define SYMTAB_SHAPE_MAX        32
+
+/*
+ * Maximum number of shapes extending a shape
+ *
+ * Structs that would need further shapes keep their fields in the
+ * hash table instead, so structs used as dictionaries do not
+ * create shapes without bounds.
  */
-#define SYMTAB_DEFAULT_ORDER    11
+#define SYMTAB_SHAPE_FANOUT     16
 
 /*
- * Node default growth unit
+ * Frame layout growth unit
  */
-#define SYMTAB_NODE_GROWTH      20
+#define SYMTAB_FRAME_GROWTH     20
+
+/*
+ * Smallest order symbol tables shrink to
+ */
+#define SYMTAB_MIN_ORDER        6
+
+/*
+ * Hash index marker of deleted entries
+ *
+ * Free positions of the hash index are 0, deleted positions this
+ * one, so that probes go on past them. Other positions hold the
+ * position of their entry plus SYMTAB_INDEX_BASE.
+ */
+#define SYMTAB_DELETED          1
+#define SYMTAB_INDEX_BASE       2
 
 /*
  * Function signature growth
@@ -334,13 +515,16 @@ typedef struct {
     char        *parent;            /* name of parent class */
     void        *definition;        /* definition statement list for user defined classes */
     signature   *constructor;       /* constructor for builtin classes */
+    value       *proto;             /* cached instance of static classes */
+    unsigned long proto_version;    /* global table version of instance */
+    char        *proto_cons;        /* constructor name of instance */
 } class_decl;
 
 /*
  * Symbol table entry
  */
 typedef struct symtab_entry {
-    char                *symbol;    /* symbol name */
+    char                *symbol;    /* symbol name, interned */
     symtab_entry_type   type;       /* symbol type */
     union {
         value           var;        /* variable data */
@@ -350,20 +534,55 @@ typedef struct symtab_entry {
 } symtab_entry;
 
 /*
- * Symbol table node
- */
-typedef struct {
-    unsigned int        len;
-    unsigned int        size;
-    symtab_entry        *entries;
-} symtab_node;
+ * Symbol table frame layout
+ *
+ * Names of a function body that are resolved to slots before the
+ * body runs. Symbol tables of calls to that function keep these
+ * names in a flat slot array instead of the hash table.
+ *
+ * Struct shapes are layouts too. All structs that got the same
+ * fields in the same order share one shape, and adding a field
+ * moves a struct on to the shape that extends its own by that
+ * name. Shapes are counted by the tables and shapes using them.
+ */
+typedef struct symtab_frame {
+    unsigned int        len;        /* number of slots */
+    unsigned int        size;       /* allocated slots */
+    char                **names;    /* slot symbol names */
+    unsigned int        *hashes;    /* hash values of slot names */
+    unsigned long       version;    /* unique stamp of the layout */
+    int                 shape;      /* set for struct shapes */
+    unsigned int        refcount;   /* users of struct shape */
+    struct symtab_frame *parent;    /* shape extended by this one */
+    struct symtab_frame **next;     /* shapes extending this one */
+    unsigned int        next_len;   /* number of extending shapes */
+} symtab_frame;
 
 /*
  * Symbol table
+ *
+ * Entries that are not in frame slots are kept in insertion order
+ * in a dense array, found by name through an open addressed hash
+ * index of their positions. Deleted entries leave holes that are
+ * compacted away once they outnumber the live ones.
  */
 typedef struct symtab {
-    unsigned int        order;
-    symtab_node         **nodes;
+    unsigned int        order;      /* log2 of hash index size */
+    unsigned int        count;      /* live entries */
+    unsigned int        used;       /* entries including deleted ones */
+    unsigned int        size;       /* allocated entries */
+    symtab_entry        *entries;   /* entries in insertion order */
+    unsigned int        *hashes;    /* hash values of entries */
+    unsigned int        *index;     /* hash index into entries */
+    symtab_frame        *frame;     /* slot layout, NULL if none */
+    symtab_entry        *slots;     /* slot entries of frame */
+    unsigned int        slots_size; /* allocated slot entries */
+    unsigned long       version;    /* stamp of functions and layout */
+    unsigned int        refcount;   /* struct values sharing the table */
+    unsigned int        bound;      /* copies bound to calls */
+    int                 varargs;    /* argc and argv still to be added */
+    unsigned int        argc;       /* arguments of the call */
+    value               **argv;
 } symtab;
 
 /*
@@ -373,10 +592,11 @@ symtab_entry *symtab_entry_alloc(void);
 void symtab_entry_free(symtab_entry *entry);
 void symtab_entry_recycle(symtab_entry *entry);
 void symtab_entry_cleanup(symtab_entry *entry);
-symtab_node *symtab_node_alloc(void);
-void symtab_node_free(symtab_node *node);
 symtab *symtab_alloc(unsigned int order);
 symtab *symtab_copy(symtab *sym);
+void symtab_clear(symtab *symtab);
+unsigned long symtab_stamp(void);
+void symtab_touch(symtab *symtab);
 void symtab_free(symtab *symtab);
 
 /*
@@ -389,11 +609,37 @@ symtab_entry *symtab_add_class(symtab *, const char *n, const char *p, void *def
 symtab_entry *symtab_add_builtin_class(symtab *symtab, const char *name, const char *parent,
                                        signature *con);
 symtab_entry *symtab_lookup(symtab *symtab, const char *symbol);
+symtab_entry *symtab_lookup_name(symtab *symtab, const char *name);
 symtab_entry *symtab_get(symtab *symtab, const int index);
 value *symtab_get_variable(symtab *symtab, const char *name);
 signature *symtab_get_function(symtab *symtab, const char *name);
 void symtab_delete(symtab *symtab, const char *symbol);
 int symtab_num_entries(symtab *sym);
+symtab_entry *symtab_next(symtab *symtab, unsigned int *node,
+                          unsigned int *pos);
+unsigned int symtab_hash_symbol(const char *symbol);
+int symtab_locate(symtab *symtab, symtab_entry *entry, int *pos);
+void symtab_compact(symtab *symtab);
+
+/*
+ * Symbol table frame layouts
+ */
+symtab_frame *symtab_frame_alloc(void);
+void symtab_frame_free(symtab_frame *frame);
+int symtab_frame_add(symtab_frame *frame, const char *name);
+int symtab_frame_find(symtab_frame *frame, const char *name,
+                      unsigned int hash);
+void symtab_frame_attach(symtab *symtab, symtab_frame *frame);
+
+/*
+ * Struct shapes
+ */
+symtab *symtab_alloc_struct(void);
+void symtab_shape_ref(symtab_frame *shape);
+void symtab_shape_release(symtab_frame *shape);
+int symtab_shape_add(symtab *symtab, const char *name, unsigned int hash);
+void symtab_shape_build(symtab *symtab);
+void symtab_shape_delete(symtab *symtab, unsigned int slot);
 
 /*
  * Symbol table stack
@@ -401,6 +647,9 @@ int symtab_num_entries(symtab *sym);
 void symtab_stack_init(intend_state *s);
 void symtab_stack_teardown(intend_state *s);
 void symtab_stack_enter(intend_state *s);
+void symtab_stack_enter_frame(intend_state *s, symtab_frame *frame);
+void symtab_stack_attach_frame(intend_state *s, symtab_frame *frame);
+void symtab_stack_set_args(intend_state *s, unsigned int argc, value **argv);
 void symtab_stack_leave(intend_state *s);
 symtab *symtab_stack_pop(intend_state *s);
 unsigned int symtab_stack_depth(intend_state *s);
@@ -408,12 +657,21 @@ void symtab_stack_add(intend_state *s, symtab_entry entry);
 void symtab_stack_add_global_variable(intend_state *s, const char *name, value *val);
 void symtab_stack_add_global_function(intend_state *s, const char *name,
                                       signature *sig);
-void symtab_stack_add_variable(intend_state *s, const char *name, value *val);
+symtab_entry *symtab_stack_add_variable(intend_state *s, const char *name,
+                                        value *val);
 void symtab_stack_add_function(intend_state *s, const char *name,
                                signature *sig);
 void symtab_stack_add_class(intend_state *s, const char *name,
                             const char *parent, void *d);
 symtab_entry *symtab_stack_lookup(intend_state *s, const char *symbol);
+symtab_entry *symtab_stack_lookup_slot(intend_state *s, symtab_frame *frame,
+                                       int slot, const char *symbol);
+symtab_entry *symtab_stack_lookup_top(intend_state *s, const char *symbol);
+symtab_entry *symtab_stack_lookup_top_slot(intend_state *s,
+                                           symtab_frame *frame, int slot,
+                                           const char *symbol);
+void symtab_stack_add_variable_slot(intend_state *s, symtab_frame *frame,
+                                    int slot, const char *name, value *val);
 value *symtab_stack_get_variable(intend_state *s, const char *name);
 signature *symtab_stack_get_function(intend_state *s, const char *name);
 int symtab_stack_local(intend_state *s, const char *symbol);
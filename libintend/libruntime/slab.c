@@ -0,0 +1,320 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Small object allocator
+ *
+ * Values and symbol table entries are allocated and freed at a
+ * high rate. They are served from blocks of memory divided into
+ * objects of one size class each, and freed objects are kept on a
+ * free list for reuse. Every interpreter context has its own blocks,
+ * which are given back to the system when the context is freed.
+ * Building with SLAB_PLAIN_MALLOC defined makes every object a
+ * separate malloc() allocation again, which lets memory debuggers
+ * track each object on its own.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "runtime.h"
+
+/*
+ * Size classes, in steps of SLAB_ALIGN bytes
+ */
+#define SLAB_ALIGN      16
+#define SLAB_CLASSES    8
+
+/*
+ * Bytes per block, including the block header
+ *
+ * Blocks are aligned to their size, so the block of an object is
+ * found by masking its address.
+ */
+#define SLAB_BLOCK      16384
+
+#ifndef SLAB_PLAIN_MALLOC
+/*
+ * Block of objects
+ */
+typedef struct slab_block_s {
+    struct slab_block_s *next;  /* next block of the slab */
+    slab                *owner; /* slab the block belongs to */
+} slab_block;
+
+/*
+ * Offset of the first object in a block
+ */
+#define SLAB_HEADER ((sizeof(slab_block) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+
+/*
+ * Size class
+ */
+typedef struct {
+    void            *free;      /* free list, linked through objects */
+    void            *remote;    /* objects freed outside the context */
+    unsigned long   remotes;    /* number of objects on remote list */
+} slab_class;
+
+/*
+ * Objects of one interpreter context
+ *
+ * The free lists are only used while the context is running on
+ * the calling thread (see state_enter()), without locking. Objects
+ * freed anywhere else go to the remote lists under the lock, and
+ * are taken back when a free list runs empty. A slab whose context
+ * is freed while some of its objects are still in use, like values
+ * kept by the host program, lives on until the last one is freed.
+ */
+struct slab_s {
+    slab_class      classes[SLAB_CLASSES];
+    slab_block      *blocks;    /* allocated blocks */
+    unsigned long   live;       /* number of objects in use */
+    int             owned;      /* context of the slab still exists */
+};
+
+/*
+ * Lock of remote lists, of slabs without context and of the
+ * shared slab
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Slab of objects allocated while no context is running
+ */
+static slab shared;
+
+/*
+ * Get slab of running context
+ */
+static slab *running(void)
+{
+    intend_state *s = state_current();
+
+    return s ? s->slab : NULL;
+}
+
+/*
+ * Give slab back to the system
+ */
+static void destroy(slab *sl)
+{
+    slab_block *block, *next;
+
+    for (block = sl->blocks; block; block = next) {
+        next = block->next;
+        free(block);
+    }
+    free(sl);
+}
+
+/*
+ * Add free objects to size class
+ *
+ * Takes back the objects freed outside the context if there are
+ * any, else adds a new block.
+ */
+static void refill(slab *sl, slab_class *cl, unsigned int size)
+{
+    slab_block *block;
+    char *obj, *end;
+    void *mem;
+
+    if (sl->owned) {
+        pthread_mutex_lock(&lock);
+        cl->free = cl->remote;
+        sl->live -= cl->remotes;
+        cl->remote = NULL;
+        cl->remotes = 0;
+        pthread_mutex_unlock(&lock);
+        if (cl->free) {
+            return;
+        }
+    }
+
+    block = oom(posix_memalign(&mem, SLAB_BLOCK, SLAB_BLOCK) ? NULL : mem);
+    block->next = sl->blocks;
+    block->owner = sl;
+    sl->blocks = block;
+
+    obj = (char *) block + SLAB_HEADER;
+    end = (char *) block + SLAB_BLOCK - size;
+    for (; obj <= end; obj += size) {
+        *(void **) obj = cl->free;
+        cl->free = obj;
+    }
+}
+
+/*
+ * Take object from size class n
+ */
+static void *take(slab *sl, unsigned int n)
+{
+    slab_class *cl = &sl->classes[n - 1];
+    void *obj;
+
+    if (!cl->free) {
+        refill(sl, cl, n * SLAB_ALIGN);
+    }
+    obj = cl->free;
+    cl->free = *(void **) obj;
+    ++sl->live;
+    return obj;
+}
+#endif
+
+/*
+ * Allocate zeroed object
+ *
+ * Objects larger than the largest size class are allocated with
+ * calloc(). The size must be given again when the object is freed.
+ */
+void *slab_alloc(unsigned int size)
+{
+#ifdef SLAB_PLAIN_MALLOC
+    return oom(calloc(1, size));
+#else
+    unsigned int n;
+    slab *sl;
+    void *obj;
+
+    n = (size + SLAB_ALIGN - 1) / SLAB_ALIGN;
+    if (n == 0 || n > SLAB_CLASSES) {
+        return oom(calloc(1, size));
+    }
+
+    sl = running();
+    if (sl) {
+        obj = take(sl, n);
+    } else {
+        pthread_mutex_lock(&lock);
+        obj = take(&shared, n);
+        pthread_mutex_unlock(&lock);
+    }
+
+    memset(obj, 0, size);
+    return obj;
+#endif
+}
+
+/*
+ * Free object from slab_alloc()
+ *
+ * Objects may be freed by any context, or by none.
+ */
+void slab_free(void *ptr, unsigned int size)
+{
+#ifdef SLAB_PLAIN_MALLOC
+    free(ptr);
+#else
+    slab_class *cl;
+    unsigned int n;
+    slab *sl;
+
+    if (!ptr) {
+        return;
+    }
+
+    n = (size + SLAB_ALIGN - 1) / SLAB_ALIGN;
+    if (n == 0 || n > SLAB_CLASSES) {
+        free(ptr);
+        return;
+    }
+
+    sl = ((slab_block *) ((uintptr_t) ptr & ~(uintptr_t) (SLAB_BLOCK - 1)))->owner;
+    cl = &sl->classes[n - 1];
+    if (sl == running()) {
+        *(void **) ptr = cl->free;
+        cl->free = ptr;
+        --sl->live;
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    if (sl->owned) {
+        *(void **) ptr = cl->remote;
+        cl->remote = ptr;
+        ++cl->remotes;
+    } else if (sl == &shared) {
+        *(void **) ptr = cl->free;
+        cl->free = ptr;
+        --sl->live;
+    } else if (--sl->live == 0) {
+        destroy(sl);
+    }
+    pthread_mutex_unlock(&lock);
+#endif
+}
+
+/*
+ * Create slab for new context
+ */
+slab *slab_new(void)
+{
+#ifdef SLAB_PLAIN_MALLOC
+    return NULL;
+#else
+    slab *sl = oom(calloc(1, sizeof(slab)));
+
+    sl->owned = 1;
+    return sl;
+#endif
+}
+
+/*
+ * Release slab of freed context
+ *
+ * The blocks are given back to the system once no objects of the
+ * context are in use anymore, which may be right away. The context
+ * must not be running anymore.
+ */
+void slab_release(slab *sl)
+{
+#ifndef SLAB_PLAIN_MALLOC
+    int i;
+
+    if (!sl) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    for (i = 0; i < SLAB_CLASSES; i++) {
+        sl->live -= sl->classes[i].remotes;
+    }
+    sl->owned = 0;
+    if (sl->live == 0) {
+        destroy(sl);
+    }
+    pthread_mutex_unlock(&lock);
+#endif
+}
@@ -39,68 +39,253 @@
 #include "runtime.h"
 
 /*
- * Add entry to symbol table node
+ * Rotate 32 bit value left
+ */
+static unsigned int rotl(unsigned int x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+/*
+ * The MurmurHash3 32 bit hash algorithm
+ * (https://github.com/aappleby/smhasher)
  *
- * This function adds an entry to a symbol table node. The memory
- * allocated for the node is increased as needed.
+ * Symbols are mixed in four bytes at a time, and the final mix
+ * spreads all bits into the low bits used for table positions.
  */
-static symtab_entry *symtab_node_add(symtab_node *node, symtab_entry entry)
+static unsigned int murmur3(const char *str, unsigned int len, unsigned int h)
 {
-    symtab_entry *entries;
-    symtab_entry *res;
-    int oldsize;
-
-    sanity(node);
-
-    // Needs growth
-    if (node->len >= node->size) {
-        oldsize = node->size;
-        node->size += SYMTAB_NODE_GROWTH;
-        entries = oom(realloc(node->entries, (node->size + 1) * sizeof(symtab_entry)));
-        memset(entries + oldsize, 0, (node->size - oldsize + 1) * sizeof(symtab_entry));
-        node->entries = entries;
-    } else {
-        entries = node->entries;
+    static const unsigned int c1 = 0xcc9e2d51;
+    static const unsigned int c2 = 0x1b873593;
+    unsigned int i, k;
+
+    for (i = 0; i + 4 <= len; i += 4) {
+        memcpy(&k, str + i, 4);
+        k = rotl(k * c1, 15) * c2;
+        h = rotl(h ^ k, 13) * 5 + 0xe6546b64;
     }
 
-    entries[node->len] = entry;
+    k = 0;
+    switch (len & 3) {
+        case 3:
+            k ^= (unsigned char) str[i + 2] << 16;
+            /* fall through */
+        case 2:
+            k ^= (unsigned char) str[i + 1] << 8;
+            /* fall through */
+        case 1:
+            k ^= (unsigned char) str[i];
+            h ^= rotl(k * c1, 15) * c2;
+    }
 
-    res = &entries[node->len];
+    h ^= len;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
 
-    node->len++;
+/*
+ * Hash symbol name
+ *
+ * This function computes the full 32 bit hash value of a given
+ * symbol name.
+ */
+unsigned int symtab_hash_symbol(const char *symbol)
+{
+    return murmur3(symbol, strlen(symbol), 0);
+}
 
-    return res;
+/*
+ * Find slot of symbol
+ *
+ * Returns the slot the symbol is resolved to in the frame layout
+ * of the symbol table, or -1 if it has none.
+ */
+static int symtab_slot(symtab *symtab, const char *symbol, unsigned int hash)
+{
+    if (!symtab->frame) {
+        return -1;
+    }
+    return symtab_frame_find(symtab->frame, symbol, hash);
 }
 
 /*
- * The FNV1a-32 hash algorithm
- * (http://www.isthe.com/chongo/tech/comp/fnv/)
+ * Probe hash index for symbol
+ *
+ * Probes the hash index from the home position of the hash value
+ * on. Interned symbols match by address, others are compared by
+ * stored hash value before their names. Returns the position in
+ * the hash index, or -1 if the symbol is not in the table.
  */
-static unsigned int fnv1a(const char *str, unsigned int hval)
+static int symtab_probe(symtab *symtab, const char *symbol, unsigned int hash)
 {
-    static const unsigned int fnv_32_prime = 0x01000193;
+    symtab_entry *entry;
+    unsigned int mask, i, pos;
+
+    if (symtab->count == 0) {
+        return -1;
+    }
 
-    while (*str) {
-        hval ^= *str++;
-        hval *= fnv_32_prime;
+    mask = (1u << symtab->order) - 1;
+    for (i = hash & mask; ; i = (i + 1) & mask) {
+        pos = symtab->index[i];
+        if (pos == 0) {
+            return -1;
+        }
+        if (pos == SYMTAB_DELETED) {
+            continue;
+        }
+        pos -= SYMTAB_INDEX_BASE;
+        entry = &symtab->entries[pos];
+        if (entry->symbol == symbol || (symtab->hashes[pos] == hash &&
+                strcmp(entry->symbol, symbol) == 0)) {
+            return i;
+        }
     }
-    return hval;
 }
 
 /*
- * Hash symbol name
+ * Find position of symbol in entries
  *
- * This function computes the hash value of a given symbol
- * name. The 32 bit hash value is reduced to the actual
- * number of bits available for symbol table hash buckets.
+ * Returns -1 if the symbol is not in the table.
  */
-static unsigned int symtab_hash(const char *symbol, unsigned int order)
+static int symtab_find(symtab *symtab, const char *symbol, unsigned int hash)
 {
-    unsigned int hash;
+    int i;
 
-    hash = fnv1a(symbol, 0);
-    hash ^= (hash >> (32 - order));
-    return (hash & ((1 << order) - 1));
+    i = symtab_probe(symtab, symbol, hash);
+    return i >= 0 ? (int) (symtab->index[i] - SYMTAB_INDEX_BASE) : -1;
+}
+
+/*
+ * Place entry in hash index
+ *
+ * The position of the entry goes to the first free or deleted
+ * position probed from the home position of its hash value.
+ */
+static void symtab_place(symtab *symtab, unsigned int pos)
+{
+    unsigned int mask, i;
+
+    mask = (1u << symtab->order) - 1;
+    for (i = symtab->hashes[pos] & mask; symtab->index[i] > SYMTAB_DELETED;
+         i = (i + 1) & mask);
+    symtab->index[i] = pos + SYMTAB_INDEX_BASE;
+}
+
+/*
+ * Move live entries together
+ *
+ * Deleted entries leave holes in the entry array. This closes them,
+ * keeping the order of the live entries, and touches the table as
+ * the positions of entries change. The hash index is left stale.
+ */
+static void symtab_squeeze(symtab *symtab)
+{
+    unsigned int i, len = 0;
+
+    if (symtab->used == symtab->count) {
+        return;
+    }
+
+    for (i = 0; i < symtab->used; i++) {
+        if (!symtab->entries[i].symbol) {
+            continue;
+        }
+        if (i != len) {
+            symtab->entries[len] = symtab->entries[i];
+            symtab->hashes[len] = symtab->hashes[i];
+        }
+        ++len;
+    }
+    memset(symtab->entries + len, 0,
+           (symtab->used - len) * sizeof(symtab_entry));
+    symtab->used = len;
+    symtab->count = len;
+    symtab_touch(symtab);
+}
+
+/*
+ * Compact symbol table
+ *
+ * Closes the holes of deleted entries and rebuilds the hash index,
+ * which also drops its markers of deleted positions. Also used to
+ * index entries stored directly into the entry array.
+ */
+void symtab_compact(symtab *symtab)
+{
+    unsigned int i;
+
+    sanity(symtab);
+
+    if (!symtab->index) {
+        return;
+    }
+
+    symtab_squeeze(symtab);
+    memset(symtab->index, 0, (1u << symtab->order) * sizeof(unsigned int));
+    for (i = 0; i < symtab->used; i++) {
+        symtab_place(symtab, i);
+    }
+}
+
+/*
+ * Resize symbol table
+ *
+ * Compacts the entries into an entry array for a hash index of the
+ * given order. Entries fill at most three quarters of the index, so
+ * probes always reach a free position.
+ */
+static void symtab_resize(symtab *symtab, unsigned int order)
+{
+    unsigned int size, i;
+
+    size = (1u << order) - ((1u << order) + 3) / 4;
+
+    symtab_squeeze(symtab);
+    symtab->entries = oom(realloc(symtab->entries,
+                                  size * sizeof(symtab_entry)));
+    symtab->hashes = oom(realloc(symtab->hashes, size * sizeof(unsigned int)));
+    free(symtab->index);
+    symtab->index = oom(calloc(1u << order, sizeof(unsigned int)));
+    symtab->order = order;
+    symtab->size = size;
+
+    for (i = 0; i < symtab->used; i++) {
+        symtab_place(symtab, i);
+    }
+}
+
+/*
+ * Make room for one more entry
+ *
+ * The entry array and hash index are allocated with the first
+ * entry. Once the entry array is full, the table is compacted: into
+ * twice the size if the live entries alone fill half of it, at the
+ * same size otherwise.
+ */
+static void symtab_reserve(symtab *symtab)
+{
+    unsigned int order;
+
+    if (!symtab->index) {
+        symtab_resize(symtab, symtab->order);
+        return;
+    }
+
+    if (symtab->used < symtab->size) {
+        return;
+    }
+
+    order = symtab->order;
+    if ((symtab->count + 1) * 2 > symtab->size && order < 31) {
+        symtab_resize(symtab, order + 1);
+    } else {
+        symtab_compact(symtab);
+    }
 }
 
 /*
@@ -108,21 +293,62 @@ static unsigned int symtab_hash(const char *symbol, unsigned int order)
  *
  * This function adds an entry to a symbol table. It does not
  * check whether an entry with the same symbol name already
- * exists. If the node for the hash value of the symbol has not
- * yet been allocated, this function will allocate a new node.
+ * exists. The symbol of the entry must be interned, the table
+ * takes over its reference. The entry goes after all others, the
+ * table grows as needed.
  */
 symtab_entry *symtab_add(symtab *symtab, symtab_entry entry)
 {
-    unsigned int pos;
+    unsigned int hash, pos;
+    int slot;
 
     sanity(symtab && entry.symbol);
 
-    pos = symtab_hash(entry.symbol, symtab->order);
-    if (!symtab->nodes[pos]) {
-        symtab->nodes[pos] = symtab_node_alloc();
+    hash = intern_hash(entry.symbol);
+    slot = symtab_slot(symtab, entry.symbol, hash);
+    if (entry.type != SYMTAB_ENTRY_VAR) {
+        symtab_touch(symtab);
+    }
+    if (slot >= 0) {
+        symtab_entry_cleanup(&symtab->slots[slot]);
+        symtab->slots[slot] = entry;
+        return &symtab->slots[slot];
+    }
+    if (symtab->frame && symtab->frame->shape) {
+        slot = symtab_shape_add(symtab, entry.symbol, hash);
+        if (slot >= 0) {
+            symtab->slots[slot] = entry;
+            return &symtab->slots[slot];
+        }
+    }
+
+    symtab_reserve(symtab);
+    pos = symtab->used++;
+    symtab->entries[pos] = entry;
+    symtab->hashes[pos] = hash;
+    ++symtab->count;
+    symtab_place(symtab, pos);
+    return &symtab->entries[pos];
+}
+
+/*
+ * Locate entry in symbol table
+ *
+ * This function stores the position in the entry array of an entry
+ * returned by symtab_lookup(). It returns 0 if the entry is not
+ * kept in the entry array of the symbol table.
+ */
+int symtab_locate(symtab *symtab, symtab_entry *entry, int *pos)
+{
+    sanity(symtab && entry && pos);
+
+    if (!entry->symbol || !symtab->entries || entry < symtab->entries ||
+            entry >= symtab->entries + symtab->used) {
+        return 0;
     }
 
-    return symtab_node_add(symtab->nodes[pos], entry);
+    *pos = entry - symtab->entries;
+    return 1;
 }
 
 /*
@@ -134,8 +360,8 @@ symtab_entry *symtab_add(symtab *symtab, symtab_entry entry)
  */
 symtab_entry *symtab_lookup(symtab *symtab, const char *symbol)
 {
-    symtab_node *node;
-    unsigned int pos, i;
+    unsigned int hash;
+    int slot, pos;
 
     sanity(symtab);
 
@@ -143,18 +369,37 @@ symtab_entry *symtab_lookup(symtab *symtab, const char *symbol)
         return NULL;
     }
 
-    pos = symtab_hash(symbol, symtab->order);
-    if (!symtab->nodes[pos]) {
-        return NULL;
+    hash = symtab_hash_symbol(symbol);
+    slot = symtab_slot(symtab, symbol, hash);
+    if (slot >= 0) {
+        return symtab->slots[slot].symbol ? &symtab->slots[slot] : NULL;
     }
 
-    node = symtab->nodes[pos];
-    for (i = 0; i < node->len; i++) {
-        if (node->entries[i].symbol && strcmp(node->entries[i].symbol, symbol) == 0) {
-            return &node->entries[i];
-        }
+    pos = symtab_find(symtab, symbol, hash);
+    return pos >= 0 ? &symtab->entries[pos] : NULL;
+}
+
+/*
+ * Lookup interned name in symbol table
+ *
+ * Like symtab_lookup(), for names returned by intern(). Their hash
+ * value is not computed again.
+ */
+symtab_entry *symtab_lookup_name(symtab *symtab, const char *name)
+{
+    unsigned int hash;
+    int slot, pos;
+
+    sanity(symtab && name);
+
+    hash = intern_hash(name);
+    slot = symtab_slot(symtab, name, hash);
+    if (slot >= 0) {
+        return symtab->slots[slot].symbol ? &symtab->slots[slot] : NULL;
     }
-    return NULL;
+
+    pos = symtab_find(symtab, name, hash);
+    return pos >= 0 ? &symtab->entries[pos] : NULL;
 }
 
 /*
@@ -162,36 +407,34 @@ symtab_entry *symtab_lookup(symtab *symtab, const char *symbol)
  *
  * This function gets the given symbol at an index and returns a
  * pointer to entry if the symbol is found in the symbol table. If
- * the symbol is not found, NULL is returned.
+ * the symbol is not found, NULL is returned. Indexes follow the
+ * order of symtab_next(). Entries outside the slots are found
+ * directly, after compacting away deleted entries if needed.
  */
 symtab_entry *symtab_get(symtab *symtab, const int index)
 {
-    symtab_node *node;
-    unsigned int max, pos, i, count;
+    unsigned int i, left;
 
     sanity(symtab);
 
-    if (index < 0 || index > symtab_num_entries(symtab)) {
+    if (index < 0) {
         return NULL;
     }
 
-    max = 1 << symtab->order;
-
-    count = 0;
-    for (pos = 0; pos < max; pos++) {
-        if (!symtab->nodes[pos]) {
-            continue;
-        }
-
-        node = symtab->nodes[pos];
-        for (i = 0; i < node->len; i++) {
-            if (node->entries[i].symbol) {
-                if (index == count) return &node->entries[i];
-                count++;
+    left = index;
+    if (symtab->frame) {
+        for (i = 0; i < symtab->frame->len; i++) {
+            if (symtab->slots[i].symbol && left-- == 0) {
+                return &symtab->slots[i];
             }
         }
     }
-    return NULL;
+
+    if (left >= symtab->count) {
+        return NULL;
+    }
+    symtab_compact(symtab);
+    return &symtab->entries[left];
 }
 
 /*
@@ -199,15 +442,17 @@ symtab_entry *symtab_get(symtab *symtab, const int index)
  *
  * This function removes the given symbol from the symbol table.
  * It is not an error if the symbol is not contained in the table.
- * Note that this function does not shrink the memory used by
- * the symbol table node that contained the symbol -- the memory
- * will be reused when another symbol is added to that node.
+ * The entry leaves a hole in the entry array and its position in
+ * the hash index is marked deleted, so probes for other symbols
+ * pass it. Once holes outnumber the live entries, the table is
+ * compacted, and shrinks if it is less than an eighth full.
+ * Structs with a shape move on to the shape of their remaining
+ * fields instead.
  */
 void symtab_delete(symtab *symtab, const char *symbol)
 {
-    symtab_node *node;
-    unsigned int pos, i, size;
-    void *cur, *next;
+    unsigned int hash, order;
+    int slot, i;
 
     sanity(symtab);
 
@@ -215,18 +460,39 @@ void symtab_delete(symtab *symtab, const char *symbol)
         return;
     }
 
-    pos = symtab_hash(symbol, symtab->order);
-    if (!symtab->nodes[pos]) {
+    hash = symtab_hash_symbol(symbol);
+    slot = symtab_slot(symtab, symbol, hash);
+    if (slot >= 0 && symtab->frame->shape) {
+        symtab_shape_delete(symtab, slot);
+        return;
+    }
+    if (slot >= 0) {
+        symtab_entry_cleanup(&symtab->slots[slot]);
+        symtab_touch(symtab);
         return;
     }
 
-    node = symtab->nodes[pos];
-    for (i = 0; i < node->len; i++) {
-        if (node->entries[i].symbol && strcmp(node->entries[i].symbol, symbol) == 0) {
-            // Just clean the entry
-            symtab_entry_cleanup(&node->entries[i]);
-            break;
-        }
+    i = symtab_probe(symtab, symbol, hash);
+    if (i < 0) {
+        return;
+    }
+
+    symtab_entry_cleanup(&symtab->entries[symtab->index[i] - SYMTAB_INDEX_BASE]);
+    symtab->index[i] = SYMTAB_DELETED;
+    --symtab->count;
+    symtab_touch(symtab);
+
+    if (symtab->used - symtab->count <= symtab->count) {
+        return;
+    }
+    order = symtab->order;
+    while (order > SYMTAB_MIN_ORDER && symtab->count * 8 < (1u << order)) {
+        --order;
+    }
+    if (order < symtab->order) {
+        symtab_resize(symtab, order);
+    } else {
+        symtab_compact(symtab);
     }
 }
 
@@ -256,14 +522,15 @@ symtab_entry *symtab_add_variable(symtab *symtab, const char *name, value *val)
         // If not the same type
         if (entry->type != SYMTAB_ENTRY_VAR) {
             symtab_entry_cleanup(entry);
-            entry->symbol = xstrdup(name);
+            entry->symbol = intern(name);
             entry->type = SYMTAB_ENTRY_VAR;
+            symtab_touch(symtab);
         }
         value_copy_to(&entry->entry_u.var, val);
     } else {
         memset(&new, 0, sizeof(symtab_entry));
         new.type = SYMTAB_ENTRY_VAR;
-        new.symbol = xstrdup(name);
+        new.symbol = intern(name);
         value_copy_to(&new.entry_u.var, val);
         entry = symtab_add(symtab, new);
     }
@@ -295,11 +562,15 @@ symtab_entry *symtab_add_function(symtab *symtab, const char *name,
         return entry;
 
     // If not the same entry type
-    if (entry && entry->type != SYMTAB_ENTRY_FUNCTION)
+    if (entry && entry->type != SYMTAB_ENTRY_FUNCTION) {
         symtab_entry_cleanup(entry);
+        entry->symbol = intern(name);
+        entry->type = SYMTAB_ENTRY_FUNCTION;
+    }
 
     // If entry already in symbol table
     if (entry && entry->symbol) {
+        symtab_touch(symtab);
         symtab_entry_recycle(entry);
         if (entry->entry_u.fnc.len >= entry->entry_u.fnc.size) {
             entry->entry_u.fnc.size += FUNCTION_SIG_GROWTH;
@@ -313,7 +584,7 @@ symtab_entry *symtab_add_function(symtab *symtab, const char *name,
     } else {
         memset(&new, 0, sizeof(symtab_entry));
         new.type = SYMTAB_ENTRY_FUNCTION;
-        new.symbol = xstrdup(name);
+        new.symbol = intern(name);
         new.entry_u.fnc.len = 1;
         new.entry_u.fnc.size = FUNCTION_SIG_GROWTH;
         new.entry_u.fnc.sigs = oom(malloc(FUNCTION_SIG_GROWTH * sizeof(signature)));
@@ -400,8 +671,7 @@ symtab_entry *symtab_add_class(symtab *symtab, const char *name, const char *par
     if (entry && entry->entry_u.cls.definition == def)
         return entry;
 
-    symbol = oom(malloc(strlen(name) + 1));
-    strcpy(symbol, name);
+    symbol = intern(name);
 
     if (parent) {
         pcopy = oom(malloc(strlen(parent) + 1));
@@ -417,6 +687,10 @@ symtab_entry *symtab_add_class(symtab *symtab, const char *name, const char *par
         entry->entry_u.cls.parent = pcopy;
         entry->entry_u.cls.definition = def;
         entry->entry_u.cls.constructor = NULL;
+        entry->entry_u.cls.proto = NULL;
+        entry->entry_u.cls.proto_version = 0;
+        entry->entry_u.cls.proto_cons = NULL;
+        symtab_touch(symtab);
     } else {
         new.type = SYMTAB_ENTRY_CLASS;
         new.symbol = symbol;
@@ -424,6 +698,9 @@ symtab_entry *symtab_add_class(symtab *symtab, const char *name, const char *par
         new.entry_u.cls.parent = pcopy;
         new.entry_u.cls.definition = def;
         new.entry_u.cls.constructor = NULL;
+        new.entry_u.cls.proto = NULL;
+        new.entry_u.cls.proto_version = 0;
+        new.entry_u.cls.proto_cons = NULL;
         entry = symtab_add(symtab, new);
     }
 
@@ -452,8 +729,7 @@ symtab_entry *symtab_add_builtin_class(symtab *symtab, const char *name, const c
     if (entry && entry->entry_u.cls.constructor == con)
         return entry;
 
-    symbol = oom(malloc(strlen(name) + 1));
-    strcpy(symbol, name);
+    symbol = intern(name);
 
     if (parent) {
         pcopy = oom(malloc(strlen(parent) + 1));
@@ -469,6 +745,10 @@ symtab_entry *symtab_add_builtin_class(symtab *symtab, const char *name, const c
         entry->entry_u.cls.parent = pcopy;
         entry->entry_u.cls.definition = NULL;
         entry->entry_u.cls.constructor = call_sig_copy(con);
+        entry->entry_u.cls.proto = NULL;
+        entry->entry_u.cls.proto_version = 0;
+        entry->entry_u.cls.proto_cons = NULL;
+        symtab_touch(symtab);
     } else {
         new.type = SYMTAB_ENTRY_CLASS;
         new.symbol = symbol;
@@ -476,30 +756,67 @@ symtab_entry *symtab_add_builtin_class(symtab *symtab, const char *name, const c
         new.entry_u.cls.parent = pcopy;
         new.entry_u.cls.definition = NULL;
         new.entry_u.cls.constructor = call_sig_copy(con);
+        new.entry_u.cls.proto = NULL;
+        new.entry_u.cls.proto_version = 0;
+        new.entry_u.cls.proto_cons = NULL;
         entry = symtab_add(symtab, new);
     }
 
     return entry;
 }
 
+/*
+ * Iterate symbol table entries
+ *
+ * Returns the next entry of the symbol table, or NULL once all
+ * entries have been returned. Slot entries come first, in slot
+ * order, then the other entries in the order they were added.
+ * Both positions must be 0 for the first call.
+ */
+symtab_entry *symtab_next(symtab *symtab, unsigned int *node,
+                          unsigned int *pos)
+{
+    symtab_entry *entry;
+
+    sanity(symtab && node && pos);
+
+    // Node 0 is the slot array, node 1 the entry array
+    while (*node == 0) {
+        if (!symtab->frame || *pos >= symtab->frame->len) {
+            *node = 1;
+            *pos = 0;
+            break;
+        }
+        entry = &symtab->slots[(*pos)++];
+        if (entry->symbol) {
+            return entry;
+        }
+    }
+
+    while (*pos < symtab->used) {
+        entry = &symtab->entries[(*pos)++];
+        if (entry->symbol) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
 /*
  * Count number of symtab entries
  */
 int symtab_num_entries(symtab *sym)
 {
-    symtab_node *node;
-    unsigned int i, j;
-    int count = 0;
+    unsigned int i;
+    int count;
 
     sanity(sym);
 
-    for (i = 0; i < (unsigned int)(1 << sym->order); i++) {
-        node = sym->nodes[i];
-        if (node) {
-            for (j = 0; j < node->len; j++) {
-                if (node->entries[j].symbol) {
-                    ++count;
-                }
+    count = sym->count;
+    if (sym->frame) {
+        for (i = 0; i < sym->frame->len; i++) {
+            if (sym->slots[i].symbol) {
+                ++count;
             }
         }
     }
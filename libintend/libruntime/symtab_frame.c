@@ -0,0 +1,169 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Symbol table frame layouts
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "runtime.h"
+
+/*
+ * Allocate frame layout
+ */
+symtab_frame *symtab_frame_alloc(void)
+{
+    symtab_frame *frame;
+
+    frame = oom(calloc(sizeof(symtab_frame), 1));
+    frame->version = symtab_stamp();
+    return frame;
+}
+
+/*
+ * Free frame layout
+ */
+void symtab_frame_free(symtab_frame *frame)
+{
+    unsigned int i;
+
+    if (!frame) {
+        return;
+    }
+
+    for (i = 0; i < frame->len; i++) {
+        intern_release(frame->names[i]);
+    }
+    free(frame->names);
+    free(frame->hashes);
+    free(frame);
+}
+
+/*
+ * Find slot of name in frame layout
+ *
+ * The hash value must be the one computed by symtab_hash_symbol()
+ * for the name. Returns -1 if the name has no slot.
+ */
+int symtab_frame_find(symtab_frame *frame, const char *name,
+                      unsigned int hash)
+{
+    unsigned int i;
+
+    for (i = 0; i < frame->len; i++) {
+        if (frame->names[i] == name || (frame->hashes[i] == hash &&
+                strcmp(frame->names[i], name) == 0)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Add name to frame layout
+ *
+ * This function returns the slot of the given name, adding a new
+ * slot if the name has none yet. A layout must not grow once it
+ * has been attached to a symbol table.
+ */
+int symtab_frame_add(symtab_frame *frame, const char *name)
+{
+    unsigned int hash;
+    int slot;
+
+    sanity(frame && name);
+
+    hash = symtab_hash_symbol(name);
+    slot = symtab_frame_find(frame, name, hash);
+    if (slot >= 0) {
+        return slot;
+    }
+
+    if (frame->len >= frame->size) {
+        frame->size += SYMTAB_FRAME_GROWTH;
+        frame->names = oom(realloc(frame->names,
+                                   frame->size * sizeof(char *)));
+        frame->hashes = oom(realloc(frame->hashes,
+                                    frame->size * sizeof(unsigned int)));
+    }
+    frame->names[frame->len] = intern(name);
+    frame->hashes[frame->len] = hash;
+
+    return frame->len++;
+}
+
+/*
+ * Attach frame layout to symbol table
+ *
+ * Entries already in the symbol table whose names have a slot in
+ * the layout are moved to their slots. A symbol table keeps the
+ * first layout attached to it.
+ */
+void symtab_frame_attach(symtab *symtab, symtab_frame *frame)
+{
+    symtab_entry *entry;
+    unsigned int i;
+    int slot;
+
+    sanity(symtab && frame);
+
+    if (symtab->frame || frame->len == 0) {
+        return;
+    }
+
+    if (symtab->slots_size < frame->len) {
+        free(symtab->slots);
+        symtab->slots = oom(calloc(frame->len, sizeof(symtab_entry)));
+        symtab->slots_size = frame->len;
+    }
+    symtab->frame = frame;
+
+    if (symtab->count == 0) {
+        return;
+    }
+    symtab_touch(symtab);
+
+    for (i = 0; i < symtab->used; i++) {
+        entry = &symtab->entries[i];
+        if (!entry->symbol) {
+            continue;
+        }
+        slot = symtab_frame_find(frame, entry->symbol, symtab->hashes[i]);
+        if (slot >= 0) {
+            symtab->slots[slot] = *entry;
+            memset(entry, 0, sizeof(symtab_entry));
+            --symtab->count;
+        }
+    }
+    symtab_compact(symtab);
+}
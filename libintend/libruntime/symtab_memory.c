@@ -43,7 +43,7 @@
  */
 symtab_entry *symtab_entry_alloc(void)
 {
-    return oom(calloc(sizeof(symtab_entry), 1));
+    return slab_alloc(sizeof(symtab_entry));
 }
 
 /*
@@ -72,6 +72,8 @@ void symtab_entry_recycle(symtab_entry *entry)
             break;
         case SYMTAB_ENTRY_CLASS:
             if (entry->entry_u.cls.parent) free(entry->entry_u.cls.parent);
+            if (entry->entry_u.cls.proto) value_free(entry->entry_u.cls.proto);
+            if (entry->entry_u.cls.proto_cons) free(entry->entry_u.cls.proto_cons);
             if (entry->entry_u.cls.type == CLASS_TYPE_BUILTIN) {
                 if (entry->entry_u.cls.constructor) call_sig_free(entry->entry_u.cls.constructor);
             }
@@ -92,7 +94,7 @@ void symtab_entry_cleanup(symtab_entry *entry)
     // Avoid null entries
     if (!entry) return;
 
-    if (entry->symbol) free(entry->symbol);
+    intern_release(entry->symbol);
     switch (entry->type) {
         case SYMTAB_ENTRY_VAR:
             value_cleanup(&entry->entry_u.var);
@@ -107,6 +109,8 @@ void symtab_entry_cleanup(symtab_entry *entry)
             break;
         case SYMTAB_ENTRY_CLASS:
             if (entry->entry_u.cls.parent) free(entry->entry_u.cls.parent);
+            if (entry->entry_u.cls.proto) value_free(entry->entry_u.cls.proto);
+            if (entry->entry_u.cls.proto_cons) free(entry->entry_u.cls.proto_cons);
             if (entry->entry_u.cls.type == CLASS_TYPE_BUILTIN) {
                 if (entry->entry_u.cls.constructor) call_sig_free(entry->entry_u.cls.constructor);
             }
@@ -127,50 +131,47 @@ void symtab_entry_free(symtab_entry *entry)
     symtab_entry_cleanup(entry);
 
     // Free self
-    free(entry);
+    slab_free(entry, sizeof(symtab_entry));
 }
 
 /*
- * Allocate symbol table node
+ * Last issued version stamp
  */
-symtab_node *symtab_node_alloc(void)
+static unsigned long stamp = 0;
+
+/*
+ * Issue version stamp
+ *
+ * Returns a new stamp, distinct from all stamps issued before by
+ * any context, as tables and shapes move between contexts with
+ * their values.
+ */
+unsigned long symtab_stamp(void)
 {
-    return oom(calloc(sizeof(symtab_node), 1));
+    return __sync_add_and_fetch(&stamp, 1);
 }
 
 /*
- * Free symbol table node
+ * Renew symbol table version
  *
- * This function frees a symbol table node and all contained
- * symbol table entries.
+ * The version of a symbol table changes whenever a function or class
+ * entry is added, replaced or removed, or entries move to other
+ * positions. Two tables with the same version thus hold the same
+ * functions at the same positions; copies keep the version of
+ * their original. Inline caches rely on this to skip lookups.
  */
-void symtab_node_free(symtab_node *node)
+void symtab_touch(symtab *symtab)
 {
-    unsigned int i;
-
-    if (!node) {
-        return;
-    }
-
-    // Cleanup all entries in node
-    for (i = 0; i < node->len; i++)
-        symtab_entry_cleanup(&node->entries[i]);
-
-    // Free the entries array
-    free(node->entries);
-#if DEBUG == 1
-    memset(node, 0, sizeof(symtab_node));
-#endif
-    free(node);
+    symtab->version = symtab_stamp();
 }
 
 /*
  * Allocate symbol table
  *
- * This function allocates a symbol table of the given order,
- * where the order is the power of two used as the number of
- * hash buckets. If 0 is passed, a default of 11 is used, which
- * results in 2048 hash table buckets.
+ * This function allocates a symbol table whose hash index starts
+ * with two to the given order positions. If 0 is passed, the
+ * default order is used. The entries and index are only allocated
+ * when the first entry is added.
  */
 symtab *symtab_alloc(unsigned int order)
 {
@@ -180,8 +181,9 @@ symtab *symtab_alloc(unsigned int order)
     if (order <= 0) order = SYMTAB_DEFAULT_ORDER;
 
     table = oom(calloc(sizeof(symtab), 1));
-    table->nodes = oom(calloc(sizeof(symtab_node *), 1 << order));
     table->order = order;
+    table->refcount = 1;
+    symtab_touch(table);
 
     return table;
 }
@@ -197,11 +199,12 @@ static symtab_entry *entrydup(symtab_entry *copy, symtab_entry *orig)
         return NULL;
     }
 
-    copy->symbol = xstrdup(orig->symbol);
+    copy->symbol = intern_ref(orig->symbol);
     copy->type   = orig->type;
 
     switch (orig->type) {
         case SYMTAB_ENTRY_VAR:
+            value_unbind(&orig->entry_u.var);
             value_copy_to(&copy->entry_u.var, &orig->entry_u.var);
             break;
         case SYMTAB_ENTRY_FUNCTION:
@@ -222,24 +225,49 @@ static symtab_entry *entrydup(symtab_entry *copy, symtab_entry *orig)
 
 /*
  * Copy a symbol table and return new address
+ *
+ * Variables of the original that are bound to a call lose their
+ * binding, since the call may store back to either table.
  */
 symtab *symtab_copy(symtab *sym)
 {
     symtab *copy;
-    symtab_node *node, *nnode;
-    unsigned int i, j;
+    unsigned int i, size;
 
     copy = symtab_alloc(sym->order);
-    for (i = 0; i < (unsigned int)(1 << sym->order); i++) {
-        node = sym->nodes[i];
-        if (node) {
-            copy->nodes[i] = nnode = symtab_node_alloc();
-            nnode->len = node->len;
-            nnode->size = node->size;
-            nnode->entries =
-                oom(calloc(sizeof(symtab_entry *) * node->size, 1));
-            for (j = 0; j < node->len; j++) {
-                entrydup(&nnode->entries[j], &node->entries[j]);
+    copy->version = sym->version;
+    if (sym->index) {
+        size = 1u << sym->order;
+        copy->size = sym->size;
+        copy->used = sym->used;
+        copy->entries = oom(calloc(sym->size, sizeof(symtab_entry)));
+        copy->hashes = oom(malloc(sym->size * sizeof(unsigned int)));
+        copy->index = oom(malloc(size * sizeof(unsigned int)));
+        memcpy(copy->hashes, sym->hashes, sym->used * sizeof(unsigned int));
+        memcpy(copy->index, sym->index, size * sizeof(unsigned int));
+        for (i = 0; i < sym->used; i++) {
+            if (sym->entries[i].symbol &&
+                    entrydup(&copy->entries[i], &sym->entries[i])) {
+                ++copy->count;
+            }
+        }
+        // Entries keep their positions, unless some were not copied
+        if (copy->count != sym->count) {
+            symtab_compact(copy);
+        }
+    }
+    if (sym->frame) {
+        copy->frame = sym->frame;
+        if (sym->frame->shape) {
+            symtab_shape_ref(sym->frame);
+        }
+        if (sym->frame->len > 0) {
+            copy->slots = oom(calloc(sym->frame->len, sizeof(symtab_entry)));
+            copy->slots_size = sym->frame->len;
+        }
+        for (i = 0; i < sym->frame->len; i++) {
+            if (sym->slots[i].symbol) {
+                entrydup(&copy->slots[i], &sym->slots[i]);
             }
         }
     }
@@ -247,27 +275,75 @@ symtab *symtab_copy(symtab *sym)
     return copy;
 }
 
+/*
+ * Clear symbol table
+ *
+ * This function removes all entries and the frame layout from a
+ * symbol table, but keeps its memory for reuse.
+ */
+void symtab_clear(symtab *symtab)
+{
+    unsigned int i;
+
+    sanity(symtab);
+
+    if (symtab->used > 0) {
+        for (i = 0; i < symtab->used; i++) {
+            if (symtab->entries[i].symbol) {
+                symtab_entry_cleanup(&symtab->entries[i]);
+            }
+        }
+        memset(symtab->index, 0, (1u << symtab->order) * sizeof(unsigned int));
+    }
+    symtab->count = 0;
+    symtab->used = 0;
+    symtab->varargs = 0;
+    if (symtab->frame) {
+        for (i = 0; i < symtab->frame->len; i++) {
+            symtab_entry_cleanup(&symtab->slots[i]);
+        }
+        if (symtab->frame->shape) {
+            symtab_shape_release(symtab->frame);
+        }
+        symtab->frame = NULL;
+    }
+    symtab_touch(symtab);
+}
+
 /*
  * Free symbol table
  *
- * This function frees a symbol table and all contained nodes
- * and entries.
+ * This function frees a symbol table and all contained entries.
  */
 void symtab_free(symtab *symtab)
 {
-    int i;
-    int j;
+    unsigned int i;
+
     if (!symtab) {
         return;
     }
 
-    for (i = 0; i < (1 << symtab->order); i++) {
-        symtab_node_free(symtab->nodes[i]);
+    if (symtab->count > 0) {
+        for (i = 0; i < symtab->used; i++) {
+            if (symtab->entries[i].symbol) {
+                symtab_entry_cleanup(&symtab->entries[i]);
+            }
+        }
+    }
+    if (symtab->frame) {
+        for (i = 0; i < symtab->frame->len; i++) {
+            symtab_entry_cleanup(&symtab->slots[i]);
+        }
+        if (symtab->frame->shape) {
+            symtab_shape_release(symtab->frame);
+        }
     }
+    free(symtab->slots);
+    free(symtab->entries);
+    free(symtab->hashes);
+    free(symtab->index);
 #if DEBUG == 1
-    memset(symtab->nodes, 0, sizeof(symtab_node *) * (1 << symtab->order));
+    memset(symtab, 0, sizeof(*symtab));
 #endif
-    symtab->order = 0;
-    free(symtab->nodes);
     free(symtab);
 }
@@ -0,0 +1,334 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C Struct shapes
+ *
+ * Structs move between contexts with their values, so all contexts
+ * share the shapes. Shapes are only extended and unlinked under the
+ * lock. Reference counts change with atomic operations, and a shape
+ * only loses its last reference under the lock, so it is never freed
+ * while another struct moves on to it.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "runtime.h"
+
+/*
+ * Shape of structs without fields
+ */
+static symtab_frame root;
+static pthread_once_t root_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Lock of the shapes extending each shape
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Set up root shape
+ *
+ * The root shape is never freed, it holds one reference to itself.
+ */
+static void root_init(void)
+{
+    root.shape = 1;
+    root.refcount = 1;
+    root.version = symtab_stamp();
+}
+
+/*
+ * Get root shape
+ */
+static symtab_frame *shape_root(void)
+{
+    pthread_once(&root_once, root_init);
+    return &root;
+}
+
+/*
+ * Allocate struct symbol table
+ *
+ * The new table starts with the shape of structs without fields.
+ */
+symtab *symtab_alloc_struct(void)
+{
+    symtab *table;
+
+    table = symtab_alloc(SYMTAB_STRUCT_ORDER);
+    table->frame = shape_root();
+    symtab_shape_ref(table->frame);
+    return table;
+}
+
+/*
+ * Reference shape
+ */
+void symtab_shape_ref(symtab_frame *shape)
+{
+    sanity(shape && shape->shape);
+
+    __sync_add_and_fetch(&shape->refcount, 1);
+}
+
+/*
+ * Release shape
+ *
+ * A shape that is no longer used is removed from the shapes
+ * extending its parent and freed. All names but the last one
+ * belong to the parent shapes.
+ */
+void symtab_shape_release(symtab_frame *shape)
+{
+    symtab_frame *parent;
+    unsigned int i, refs;
+
+    sanity(shape && shape->shape &&
+           __atomic_load_n(&shape->refcount, __ATOMIC_RELAXED) > 0);
+
+    /* shapes with other users are released without the lock */
+    refs = __atomic_load_n(&shape->refcount, __ATOMIC_RELAXED);
+    while (refs > 1) {
+        if (__sync_bool_compare_and_swap(&shape->refcount, refs, refs - 1)) {
+            return;
+        }
+        refs = __atomic_load_n(&shape->refcount, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_lock(&lock);
+    while (__sync_sub_and_fetch(&shape->refcount, 1) == 0) {
+        parent = shape->parent;
+        for (i = 0; i < parent->next_len; i++) {
+            if (parent->next[i] == shape) {
+                parent->next[i] = parent->next[--parent->next_len];
+                break;
+            }
+        }
+
+        intern_release(shape->names[shape->len - 1]);
+        free(shape->names);
+        free(shape->hashes);
+        free(shape->next);
+        free(shape);
+
+        shape = parent;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Get shape extended by name
+ *
+ * Returns the shape with the slots of the given one followed by a
+ * slot for the name, creating it if needed. Returns NULL if the
+ * shape may not be extended any further. Called under the lock.
+ */
+static symtab_frame *shape_next(symtab_frame *shape, const char *name,
+                                unsigned int hash)
+{
+    symtab_frame *next;
+    unsigned int i, len = shape->len;
+
+    for (i = 0; i < shape->next_len; i++) {
+        next = shape->next[i];
+        if (next->names[len] == name || (next->hashes[len] == hash &&
+                strcmp(next->names[len], name) == 0)) {
+            return next;
+        }
+    }
+
+    if (len >= SYMTAB_SHAPE_MAX || shape->next_len >= SYMTAB_SHAPE_FANOUT) {
+        return NULL;
+    }
+
+    next = oom(calloc(sizeof(symtab_frame), 1));
+    next->len = next->size = len + 1;
+    next->names = oom(malloc(next->len * sizeof(char *)));
+    next->hashes = oom(malloc(next->len * sizeof(unsigned int)));
+    if (len > 0) {
+        memcpy(next->names, shape->names, len * sizeof(char *));
+        memcpy(next->hashes, shape->hashes, len * sizeof(unsigned int));
+    }
+    next->names[len] = intern(name);
+    next->hashes[len] = hash;
+    next->version = symtab_stamp();
+    next->shape = 1;
+    next->parent = shape;
+    symtab_shape_ref(shape);
+
+    shape->next = oom(realloc(shape->next,
+                              (shape->next_len + 1) * sizeof(symtab_frame *)));
+    shape->next[shape->next_len++] = next;
+    return next;
+}
+
+/*
+ * Move struct fields to hash table
+ *
+ * Used for structs whose shape cannot be extended. They keep all
+ * their fields in the hash table from then on.
+ */
+static void shape_drop(symtab *symtab)
+{
+    symtab_frame *shape = symtab->frame;
+    symtab_entry *slots = symtab->slots;
+    unsigned int i;
+
+    symtab->frame = NULL;
+    symtab->slots = NULL;
+    symtab->slots_size = 0;
+
+    for (i = 0; i < shape->len; i++) {
+        if (slots[i].symbol) {
+            symtab_add(symtab, slots[i]);
+        }
+    }
+    free(slots);
+    symtab_shape_release(shape);
+    symtab_touch(symtab);
+}
+
+/*
+ * Add field slot to struct
+ *
+ * Moves the struct on to the shape that extends its own by the
+ * given name and returns the new slot, which is empty. Existing
+ * fields keep their slots. Returns -1 if the struct fell back to
+ * the hash table instead.
+ */
+int symtab_shape_add(symtab *symtab, const char *name, unsigned int hash)
+{
+    symtab_frame *shape = symtab->frame, *next;
+    unsigned int size;
+
+    sanity(shape && shape->shape && name);
+
+    pthread_mutex_lock(&lock);
+    next = shape_next(shape, name, hash);
+    if (next) {
+        symtab_shape_ref(next);
+    }
+    pthread_mutex_unlock(&lock);
+    if (!next) {
+        shape_drop(symtab);
+        return -1;
+    }
+
+    if (symtab->slots_size < next->len) {
+        size = symtab->slots_size ? symtab->slots_size * 2 : 4;
+        symtab->slots = oom(realloc(symtab->slots,
+                                    size * sizeof(symtab_entry)));
+        memset(symtab->slots + symtab->slots_size, 0,
+               (size - symtab->slots_size) * sizeof(symtab_entry));
+        symtab->slots_size = size;
+    }
+
+    symtab->frame = next;
+    symtab_shape_release(shape);
+
+    return next->len - 1;
+}
+
+/*
+ * Give struct a shape
+ *
+ * Structs built as local symbol tables, like class instances, keep
+ * their fields in the entry array. This moves them to the slots of
+ * a shape, in the order they were added, and drops the array.
+ */
+void symtab_shape_build(symtab *symtab)
+{
+    symtab_entry *entries;
+    unsigned int i, used;
+
+    sanity(symtab);
+
+    if (symtab->frame || symtab->count > SYMTAB_SHAPE_MAX) {
+        return;
+    }
+
+    entries = symtab->entries;
+    used = symtab->used;
+    free(symtab->hashes);
+    free(symtab->index);
+    symtab->entries = NULL;
+    symtab->hashes = NULL;
+    symtab->index = NULL;
+    symtab->order = SYMTAB_STRUCT_ORDER;
+    symtab->count = 0;
+    symtab->used = 0;
+    symtab->size = 0;
+
+    symtab->frame = shape_root();
+    symtab_shape_ref(symtab->frame);
+    for (i = 0; i < used; i++) {
+        if (entries[i].symbol) {
+            symtab_add(symtab, entries[i]);
+        }
+    }
+    free(entries);
+    symtab_touch(symtab);
+}
+
+/*
+ * Remove field from struct
+ *
+ * Frees the field in the given slot and moves the struct on to the
+ * shape of its remaining fields, in the order they were added. A
+ * field added back later goes after all others.
+ */
+void symtab_shape_delete(symtab *symtab, unsigned int slot)
+{
+    symtab_frame *shape = symtab->frame;
+    symtab_entry *slots = symtab->slots;
+    unsigned int i;
+
+    sanity(shape && shape->shape && slot < shape->len);
+
+    symtab_entry_cleanup(&slots[slot]);
+
+    symtab->frame = shape_root();
+    symtab_shape_ref(symtab->frame);
+    symtab->slots = NULL;
+    symtab->slots_size = 0;
+
+    for (i = 0; i < shape->len; i++) {
+        if (slots[i].symbol) {
+            symtab_add(symtab, slots[i]);
+        }
+    }
+    free(slots);
+    symtab_shape_release(shape);
+    symtab_touch(symtab);
+}
@@ -34,9 +34,52 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "runtime.h"
 
+/*
+ * Put pending arguments into symbol table
+ *
+ * This function adds variables named "argc" and "argv" for the
+ * arguments kept with the given table.
+ */
+static void add_args(symtab *sym)
+{
+    value *count, *vector;
+    unsigned int i;
+
+    sym->varargs = 0;
+    count = value_make_int(sym->argc);
+    vector = value_make_array();
+    for (i = 0; i < sym->argc; i++) {
+        value_add_to_array(vector, sym->argv[i]);
+    }
+    symtab_add_variable(sym, "argc", count);
+    symtab_add_variable(sym, "argv", vector);
+    value_free(count);
+    value_free(vector);
+}
+
+/*
+ * Get topmost local symbol table for symbol
+ *
+ * If the symbol is argc or argv and the table still keeps the
+ * arguments of its call, both variables are added first, see
+ * symtab_stack_set_args().
+ */
+static symtab *local_table(intend_state *s, const char *symbol)
+{
+    symtab **local = s->local_tables;
+    symtab *top = local[s->local_depth-1];
+
+    if (top->varargs && symbol[0] == 'a' &&
+            (!strcmp(symbol, "argc") || !strcmp(symbol, "argv"))) {
+        add_args(top);
+    }
+    return top;
+}
+
 /*
  * Tear down symbol table stack
  *
@@ -44,14 +87,22 @@
  */
 void symtab_stack_teardown(intend_state *s)
 {
+    symtab **local;
+    int i;
+
     sanity(s->global_table);
 
     while (s->local_depth > 0) {
         symtab_stack_leave(s);
     }
 
+    local = s->local_tables;
+    for (i = 0; i < s->local_size; i++) {
+        symtab_free(local[i]);
+    }
     free(s->local_tables);
     s->local_tables = NULL;
+    s->local_size = 0;
 
     symtab_free(s->global_table);
     s->global_table = NULL;
@@ -69,6 +120,7 @@ void symtab_stack_init(intend_state *s)
         s->global_table = oom(symtab_alloc(0));
 
         s->local_depth = 0;
+        s->local_size = 0;
         s->local_tables = NULL;
     }
 }
@@ -78,27 +130,92 @@ void symtab_stack_init(intend_state *s)
  *
  * This function adds a new local symbol table to the stack. The
  * new symbol table obscures the previous toplevel local table.
+ * Tables left above the current depth are cleared and reused, so
+ * entering a scope does not allocate once the stack has been
+ * that deep before.
  */
 void symtab_stack_enter(intend_state *s)
+{
+    symtab **local = s->local_tables;
+    int size;
+
+    if (s->local_depth >= s->local_size) {
+        size = s->local_size ? s->local_size * 2 : SYMTAB_STACK_SIZE;
+        local = oom(realloc(local, size * sizeof(symtab *)));
+        memset(local + s->local_size, 0,
+               (size - s->local_size) * sizeof(symtab *));
+        s->local_tables = local;
+        s->local_size = size;
+    }
+
+    if (!local[s->local_depth]) {
+        local[s->local_depth] = symtab_alloc(SYMTAB_LOCAL_ORDER);
+    }
+    ++s->local_depth;
+}
+
+/*
+ * Enter local symbol table of function frame
+ *
+ * Like symtab_stack_enter(), but the new symbol table keeps the
+ * names of the given frame layout in slots.
+ */
+void symtab_stack_enter_frame(intend_state *s, symtab_frame *frame)
 {
     symtab **local;
-    symtab *newtab;
 
-    newtab = symtab_alloc(7);
+    symtab_stack_enter(s);
+    if (frame) {
+        local = s->local_tables;
+        symtab_frame_attach(local[s->local_depth-1], frame);
+    }
+}
+
+/*
+ * Attach frame layout to local symbol table
+ *
+ * This function attaches the given layout to the topmost local
+ * symbol table, unless it already has one. Nothing is done if
+ * no local symbol table exists.
+ */
+void symtab_stack_attach_frame(intend_state *s, symtab_frame *frame)
+{
+    symtab **local = s->local_tables;
 
-    local = oom(realloc(s->local_tables,
-                        (s->local_depth + 1) * sizeof(symtab *)));
+    sanity(frame);
 
-    s->local_tables = local;
-    local[s->local_depth] = newtab;
-    ++s->local_depth;
+    if (s->local_depth > 0) {
+        symtab_frame_attach(local[s->local_depth-1], frame);
+    }
+}
+
+/*
+ * Keep arguments of call with local symbol table
+ *
+ * The variables "argc" and "argv" of the topmost local symbol
+ * table are only set up once they are looked up, added, or
+ * deleted by name. The arguments must stay valid until the table
+ * is left or set up again.
+ */
+void symtab_stack_set_args(intend_state *s, unsigned int argc, value **argv)
+{
+    symtab **local = s->local_tables;
+    symtab *top;
+
+    sanity(s->local_depth > 0 && (argc == 0 || argv));
+
+    top = local[s->local_depth-1];
+    top->varargs = 1;
+    top->argc = argc;
+    top->argv = argv;
 }
 
 /*
  * Leave local symbol table
  *
- * This function removes and frees the topmost local symbol table.
- * The previous local symbol table becomes visible again.
+ * This function removes and clears the topmost local symbol table
+ * and keeps it for reuse. The previous local symbol table becomes
+ * visible again.
  */
 void symtab_stack_leave(intend_state *s)
 {
@@ -108,7 +225,7 @@ void symtab_stack_leave(intend_state *s)
         return;
     }
     --s->local_depth;
-    symtab_free(local[s->local_depth]);
+    symtab_clear(local[s->local_depth]);
 }
 
 /*
@@ -120,11 +237,15 @@ void symtab_stack_leave(intend_state *s)
 symtab *symtab_stack_pop(intend_state *s)
 {
     symtab **local = s->local_tables;
+    symtab *top;
 
     sanity(s->local_depth > 0);
 
     --s->local_depth;
-    return local[s->local_depth];
+    top = local[s->local_depth];
+    local[s->local_depth] = NULL;
+    top->varargs = 0;
+    return top;
 }
 
 /*
@@ -148,10 +269,8 @@ unsigned int symtab_stack_depth(intend_state *s)
  */
 void symtab_stack_add(intend_state *s, symtab_entry entry)
 {
-    symtab **local = s->local_tables;
-
     if (s->local_depth > 0) {
-        symtab_add(local[s->local_depth-1], entry);
+        symtab_add(local_table(s, entry.symbol), entry);
     } else {
         symtab_add(s->global_table, entry);
     }
@@ -186,20 +305,18 @@ void symtab_stack_add_global_function(intend_state *s, const char *name,
  * Add variable entry to stack
  *
  * This functions adds the given variable to the topmost symbol
- * table of the stack. This means the global table if no local
- * symbol table exists.
+ * table of the stack and returns its entry. This means the global
+ * table if no local symbol table exists.
  */
-void symtab_stack_add_variable(intend_state *s, const char *name, value *val)
+symtab_entry *symtab_stack_add_variable(intend_state *s, const char *name,
+                                        value *val)
 {
-    symtab **local = s->local_tables;
-
     sanity(name && val);
 
     if (s->local_depth > 0) {
-        symtab_add_variable(local[s->local_depth-1], name, val);
-    } else {
-        symtab_add_variable(s->global_table, name, val);
+        return symtab_add_variable(local_table(s, name), name, val);
     }
+    return symtab_add_variable(s->global_table, name, val);
 }
 
 /*
@@ -212,12 +329,10 @@ void symtab_stack_add_variable(intend_state *s, const char *name, value *val)
 void symtab_stack_add_function(intend_state *s, const char *name,
                                signature *sig)
 {
-    symtab **local = s->local_tables;
-
     sanity(name && sig);
 
     if (s->local_depth > 0) {
-        symtab_add_function(local[s->local_depth-1], name, sig);
+        symtab_add_function(local_table(s, name), name, sig);
     } else {
         symtab_add_function(s->global_table, name, sig);
     }
@@ -233,12 +348,10 @@ void symtab_stack_add_function(intend_state *s, const char *name,
 void symtab_stack_add_class(intend_state *s, const char *name,
                             const char *parent, void *def)
 {
-    symtab **local = s->local_tables;
-
     sanity(name && def);
 
     if (s->local_depth > 0) {
-        symtab_add_class(local[s->local_depth-1], name, parent, def);
+        symtab_add_class(local_table(s, name), name, parent, def);
     } else {
         symtab_add_class(s->global_table, name, parent, def);
     }
@@ -268,11 +381,10 @@ void symtab_stack_add_builtin_class(intend_state *s, const char *name,
  */
 symtab_entry *symtab_stack_lookup(intend_state *s, const char *symbol)
 {
-    symtab **local = s->local_tables;
     symtab_entry *entry = NULL;
 
     if (s->local_depth > 0) {
-        entry = symtab_lookup(local[s->local_depth-1], symbol);
+        entry = symtab_lookup(local_table(s, symbol), symbol);
     }
     if (!entry) {
         entry = symtab_lookup(s->global_table, symbol);
@@ -280,6 +392,109 @@ symtab_entry *symtab_stack_lookup(intend_state *s, const char *symbol)
     return entry;
 }
 
+/*
+ * Lookup slot symbol in stack
+ *
+ * Fast variant of symtab_stack_lookup() for interned names, which
+ * may be resolved to a slot of a frame layout. If the topmost
+ * local symbol table uses that layout, the slot is read directly
+ * and the global table is only searched if the slot is unset. Any
+ * other symbol table is searched by name.
+ */
+symtab_entry *symtab_stack_lookup_slot(intend_state *s, symtab_frame *frame,
+                                       int slot, const char *symbol)
+{
+    symtab **local = s->local_tables;
+    symtab_entry *entry;
+    symtab *top;
+
+    if (s->local_depth > 0) {
+        top = local[s->local_depth-1];
+        if (frame && top->frame == frame) {
+            if (top->slots[slot].symbol) {
+                return &top->slots[slot];
+            }
+            return symtab_lookup_name(s->global_table, symbol);
+        }
+        entry = symtab_lookup_name(local_table(s, symbol), symbol);
+        if (entry) {
+            return entry;
+        }
+    }
+    return symtab_lookup_name(s->global_table, symbol);
+}
+
+/*
+ * Lookup symbol in topmost table
+ *
+ * This function looks for the given symbol name only in the
+ * symbol table that new variables are added to. This means the
+ * global table if no local symbol table exists.
+ */
+symtab_entry *symtab_stack_lookup_top(intend_state *s, const char *symbol)
+{
+    if (s->local_depth > 0) {
+        return symtab_lookup(local_table(s, symbol), symbol);
+    }
+    return symtab_lookup(s->global_table, symbol);
+}
+
+/*
+ * Lookup slot symbol in topmost table
+ *
+ * Fast variant of symtab_stack_lookup_top() for interned names,
+ * which may be resolved to a slot of a frame layout.
+ */
+symtab_entry *symtab_stack_lookup_top_slot(intend_state *s,
+                                           symtab_frame *frame, int slot,
+                                           const char *symbol)
+{
+    symtab **local = s->local_tables;
+    symtab *top;
+
+    if (s->local_depth > 0) {
+        top = local[s->local_depth-1];
+        if (frame && top->frame == frame) {
+            if (top->slots[slot].symbol) {
+                return &top->slots[slot];
+            }
+            return NULL;
+        }
+        return symtab_lookup_name(local_table(s, symbol), symbol);
+    }
+    return symtab_lookup_name(s->global_table, symbol);
+}
+
+/*
+ * Add variable entry to stack by slot
+ *
+ * Fast variant of symtab_stack_add_variable() for names resolved
+ * to a slot of a frame layout.
+ */
+void symtab_stack_add_variable_slot(intend_state *s, symtab_frame *frame,
+                                    int slot, const char *name, value *val)
+{
+    symtab **local = s->local_tables;
+    symtab_entry *entry;
+    symtab *top;
+
+    sanity(name && val);
+
+    if (s->local_depth > 0) {
+        top = local[s->local_depth-1];
+        if (top->frame == frame) {
+            entry = &top->slots[slot];
+            if (entry->symbol && entry->type == SYMTAB_ENTRY_VAR) {
+                if (&entry->entry_u.var != val) {
+                    value_copy_to(&entry->entry_u.var, val);
+                }
+                return;
+            }
+        }
+    }
+    symtab_stack_add_variable(s, name, val);
+}
+
 /*
  * Get variable from stack
  *
@@ -289,11 +504,10 @@ symtab_entry *symtab_stack_lookup(intend_state *s, const char *symbol)
  */
 value *symtab_stack_get_variable(intend_state *s, const char *name)
 {
-    symtab **local = s->local_tables;
     value *val = NULL;
 
     if (s->local_depth > 0) {
-        val = symtab_get_variable(local[s->local_depth-1], name);
+        val = symtab_get_variable(local_table(s, name), name);
     }
     if (!val) {
         val = symtab_get_variable(s->global_table, name);
@@ -310,11 +524,10 @@ value *symtab_stack_get_variable(intend_state *s, const char *name)
  */
 signature *symtab_stack_get_function(intend_state *s, const char *name)
 {
-    symtab **local = s->local_tables;
     signature *func = NULL;
 
     if (s->local_depth > 0) {
-        func = symtab_get_function(local[s->local_depth-1], name);
+        func = symtab_get_function(local_table(s, name), name);
     }
     if (!func) {
         func = symtab_get_function(s->global_table, name);
@@ -331,11 +544,10 @@ signature *symtab_stack_get_function(intend_state *s, const char *name)
  */
 int symtab_stack_local(intend_state *s, const char *symbol)
 {
-    symtab **local = s->local_tables;
     symtab_entry *entry;
 
     if (s->local_depth > 0) {
-        entry = symtab_lookup(local[s->local_depth-1], symbol);
+        entry = symtab_lookup(local_table(s, symbol), symbol);
         return (entry != NULL);
     }
     return 1;
@@ -350,10 +562,8 @@ int symtab_stack_local(intend_state *s, const char *symbol)
  */
 void symtab_stack_delete(intend_state *s, const char *symbol)
 {
-    symtab **local = s->local_tables;
-
     if (s->local_depth > 0) {
-        symtab_delete(local[s->local_depth-1], symbol);
+        symtab_delete(local_table(s, symbol), symbol);
     } else {
         symtab_delete(s->global_table, symbol);
     }
@@ -38,40 +38,207 @@
 
 #include "runtime.h"
 
+/*
+ * Size of raw element of typed array
+ */
+static size_t number_size(value *arr)
+{
+    if (ARRKIND_OF(arr) == ARRAY_KIND_INT) {
+        return sizeof(int);
+    } else {
+        return sizeof(double);
+    }
+}
+
+/*
+ * Make room for one more element
+ *
+ * The storage of the elements, and of their names if the array
+ * has keys, doubles in size when it is full.
+ */
+static void grow_array(value *arr)
+{
+    value_array *array = arr->value_u.array_val;
+    int size;
+
+    if (ARRLEN_OF(arr) < ARRSIZE_OF(arr)) {
+        return;
+    }
+
+    size = ARRSIZE_OF(arr) * 2;
+    if (size < ARRAY_GROWTH) {
+        size = ARRAY_GROWTH;
+    }
+    if (ARRKIND_OF(arr) != ARRAY_KIND_VALUE) {
+        array->data = oom(realloc(array->data, size * number_size(arr)));
+    } else {
+        ARR_OF(arr) = oom(realloc(ARR_OF(arr), size * sizeof(value)));
+    }
+    if (ARRNAMES_OF(arr)) {
+        ARRNAMES_OF(arr) = oom(realloc(ARRNAMES_OF(arr), size * sizeof(char *)));
+    }
+    ARRSIZE_OF(arr) = size;
+}
+
+/*
+ * Check whether value can be stored in typed array
+ *
+ * Bools are not numbers here, a typed array would read them back
+ * as 0 and 1.
+ */
+static int is_number(value *val)
+{
+    return val->type == VALUE_TYPE_INT || val->type == VALUE_TYPE_FLOAT;
+}
+
+/*
+ * Store number in typed array element
+ *
+ * The number is converted to the kind of the array like the int
+ * and float casts do.
+ */
+static void store_number(value *arr, int pos, value *val)
+{
+    double num;
+
+    if (val->type == VALUE_TYPE_FLOAT) {
+        num = FLOAT_OF(val);
+    } else {
+        num = INT_OF(val);
+    }
+
+    if (ARRKIND_OF(arr) == ARRAY_KIND_INT) {
+        ARRINTS_OF(arr)[pos] = (int) num;
+    } else {
+        ARRFLOATS_OF(arr)[pos] = num;
+    }
+}
+
+/*
+ * Append zero to typed array
+ *
+ * Returns the index of the new element.
+ */
+static int append_number(value *arr)
+{
+    size_t size = number_size(arr);
+
+    grow_array(arr);
+    memset((char *) arr->value_u.array_val->data + ARRLEN_OF(arr) * size, 0, size);
+    return ARRLEN_OF(arr)++;
+}
+
+/*
+ * Turn typed array into array of values
+ *
+ * Typed arrays hold values once they get a key, an element that
+ * is not a number, an element past their end or an element that
+ * is updated in place.
+ */
+static void untype_array(value *arr)
+{
+    if (ARRKIND_OF(arr) != ARRAY_KIND_VALUE) {
+        value_array_to_kind(arr, ARRAY_KIND_VALUE);
+    }
+}
+
+/*
+ * Append void element to array
+ *
+ * Returns the storage of the new element, which gets the given
+ * interned name if the array has keys.
+ */
+static value *append_element(value *arr, char *name)
+{
+    value *elem;
+
+    grow_array(arr);
+
+    if (ARRNAMES_OF(arr)) {
+        ARRNAMES_OF(arr)[ARRLEN_OF(arr)] = name;
+    }
+    elem = &ARR_OF(arr)[ARRLEN_OF(arr)++];
+    memset(elem, 0, sizeof(value));
+    elem->type = VALUE_TYPE_VOID;
+    return elem;
+}
+
+/*
+ * Append void elements up to the given length
+ *
+ * Typed arrays only grow by the element about to be stored, which
+ * is set to zero until then.
+ */
+static void fill_array(value *arr, int len)
+{
+    while (ARRLEN_OF(arr) < len) {
+        if (ARRKIND_OF(arr) != ARRAY_KIND_VALUE) {
+            append_number(arr);
+        } else {
+            append_element(arr, NULL);
+        }
+    }
+}
+
+/*
+ * Find array element by key
+ *
+ * The keys symbol table maps each key to the index of its
+ * element. Arrays without keys have no such table.
+ */
+static value *key_element(value *arr, char *pos)
+{
+    symtab_entry *entry;
+
+    if (!ARRKEYS_OF(arr)) {
+        return NULL;
+    }
+
+    entry = symtab_lookup(ARRKEYS_OF(arr), pos);
+    if (!entry) {
+        return NULL;
+    }
+    return &ARR_OF(arr)[INT_OF(&entry->entry_u.var)];
+}
+
 /*
  * Append value to end of array with a given key
  *
  * This function appends a copy of the given value to the
- * end of the array and assigns it the given key.
+ * end of the array and assigns it the given key. The first key
+ * turns the array into one with keys and names.
  */
 void value_add_to_key_array(value *arr, char *pos, value *val)
 {
-    symtab_entry *entry;
-    symtab_entry **entries;
+    symtab_entry *key;
+    value *elem;
+    value index;
 
     sanity(arr && val && arr->type == VALUE_TYPE_ARRAY);
+    untype_array(arr);
+    value_detach(arr);
 
-    if (ARRSIZE_OF(arr) <= ARRLEN_OF(arr)) {
-        ARRSIZE_OF(arr) += ARRAY_GROWTH;
-        entries = oom(realloc(ARR_OF(arr), (ARRSIZE_OF(arr) + 1) * sizeof(symtab_entry *)));
-        ARR_OF(arr) = entries;
-    } else {
-        entries = ARR_OF(arr);
+    elem = key_element(arr, pos);
+    if (elem) {
+        value_copy_to(elem, val);
+        return;
     }
 
-    // Add value to keys symbol table
-    entry = symtab_lookup(ARRKEYS_OF(arr), pos);
-    if (entry) {
-        value_cleanup(&entry->entry_u.var);
-        value_copy_to(&entry->entry_u.var, val);
-    } else {
-        // Add to symbol table
-        entry = symtab_add_variable(ARRKEYS_OF(arr), pos, val);
-        // Add to the data array
-        entries[ARRLEN_OF(arr)++] = entry;
-        // Add NULL sentinel
-        entries[ARRLEN_OF(arr)] = NULL;
+    if (!ARRKEYS_OF(arr)) {
+        grow_array(arr);
+        ARRKEYS_OF(arr) = symtab_alloc(5);
+        ARRNAMES_OF(arr) = oom(calloc(ARRSIZE_OF(arr), sizeof(char *)));
     }
+
+    // Add index to keys symbol table
+    memset(&index, 0, sizeof(value));
+    index.type = VALUE_TYPE_INT;
+    INT_OF(&index) = ARRLEN_OF(arr);
+    key = symtab_add_variable(ARRKEYS_OF(arr), pos, &index);
+
+    // Add to the data array, sharing the interned key
+    elem = append_element(arr, intern_ref(key->symbol));
+    value_copy_to(elem, val);
 }
 
 /*
@@ -82,31 +249,21 @@ void value_add_to_key_array(value *arr, char *pos, value *val)
  */
 void value_add_to_array(value *arr, value *val)
 {
-    symtab_entry *entry;
-    symtab_entry **entries;
+    value *elem;
 
     sanity(arr && val && arr->type == VALUE_TYPE_ARRAY);
 
-    if (ARRSIZE_OF(arr) <= ARRLEN_OF(arr)) {
-        ARRSIZE_OF(arr) += ARRAY_GROWTH;
-        entries = oom(realloc(ARR_OF(arr), (ARRSIZE_OF(arr) + 1) * sizeof(symtab_entry *)));
-        ARR_OF(arr) = entries;
-    } else {
-        entries = ARR_OF(arr);
+    if (ARRKIND_OF(arr) != ARRAY_KIND_VALUE && is_number(val)) {
+        value_detach(arr);
+        store_number(arr, append_number(arr), val);
+        return;
     }
 
-    // Add to the data array
-    entry = symtab_entry_alloc();
-    entry->symbol = NULL;
-    entry->type = SYMTAB_ENTRY_VAR;
-    value_copy_to(&entry->entry_u.var, val);
-    entries[ARRLEN_OF(arr)++] = entry;
+    untype_array(arr);
+    value_detach(arr);
 
-    /*
-     * Maintain a NULL sentinel at the end of the pointer array.
-     * This makes iteration over the array entries easy.
-     */
-    entries[ARRLEN_OF(arr)] = NULL;
+    elem = append_element(arr, NULL);
+    value_copy_to(elem, val);
 }
 
 /*
@@ -118,16 +275,16 @@ void value_add_to_array(value *arr, value *val)
  */
 void value_set_key_array(value *arr, char *pos, value *val)
 {
-    symtab_entry *entry;
-    value *copy;
+    value *elem;
 
     sanity(arr && val && arr->type == VALUE_TYPE_ARRAY);
+    untype_array(arr);
+    value_detach(arr);
 
-    entry = symtab_lookup(ARRKEYS_OF(arr), pos);
+    elem = key_element(arr, pos);
 
-    if (entry) {
-        value_cleanup(&entry->entry_u.var);
-        value_copy_to(&entry->entry_u.var, val);
+    if (elem) {
+        value_copy_to(elem, val);
     } else {
         value_add_to_key_array(arr, pos, val);
     }
@@ -143,9 +300,6 @@ void value_set_key_array(value *arr, char *pos, value *val)
  */
 void value_set_array(value *arr, int pos, value *val)
 {
-    value *copy;
-    symtab_entry *entry;
-
     sanity(arr && val && arr->type == VALUE_TYPE_ARRAY);
 
     if (pos < 0) {
@@ -155,21 +309,70 @@ void value_set_array(value *arr, int pos, value *val)
         pos = 0;
     }
 
-    if (pos > ARRLEN_OF(arr)) {
-        value *fill = value_make_void();
-        while (pos > ARRLEN_OF(arr)) {
-            value_add_to_array(arr, fill);
-        }
-        value_free(fill);
+    if (!is_number(val) || pos > ARRLEN_OF(arr)) {
+        untype_array(arr);
     }
+    value_detach(arr);
 
-    if (pos == ARRLEN_OF(arr)) {
-        value_add_to_array(arr, val);
+    fill_array(arr, pos + 1);
+    if (ARRKIND_OF(arr) != ARRAY_KIND_VALUE) {
+        store_number(arr, pos, val);
     } else {
-        entry = ARR_OF(arr)[pos];
-        value_cleanup(&entry->entry_u.var);
-        value_copy_to(&entry->entry_u.var, val);
+        value_copy_to(&ARR_OF(arr)[pos], val);
+    }
+}
+
+/*
+ * Get array element by key for update
+ *
+ * This function returns the storage of the element with the given
+ * key, so that it can be modified in place. If the key does not
+ * exist, a void element is added at the end of the array. The
+ * storage moves when elements are added to the array.
+ */
+value *value_ref_key_array(value *arr, char *pos)
+{
+    value *elem, *fill;
+
+    sanity(arr && arr->type == VALUE_TYPE_ARRAY);
+    untype_array(arr);
+    value_detach(arr);
+
+    elem = key_element(arr, pos);
+    if (!elem) {
+        fill = value_make_void();
+        value_add_to_key_array(arr, pos, fill);
+        value_free(fill);
+        elem = &ARR_OF(arr)[ARRLEN_OF(arr) - 1];
+    }
+    return elem;
+}
+
+/*
+ * Get array element for update
+ *
+ * This function returns the storage of the element at the given
+ * position, so that it can be modified in place. Missing elements
+ * are filled in with void values like value_set_array() does.
+ * The storage moves when elements are added to the array. Typed
+ * arrays have no storage for values and turn into arrays of
+ * values.
+ */
+value *value_ref_array(value *arr, int pos)
+{
+    sanity(arr && arr->type == VALUE_TYPE_ARRAY);
+    untype_array(arr);
+    value_detach(arr);
+
+    if (pos < 0) {
+        pos = ARRLEN_OF(arr) + pos;
     }
+    if (pos < 0) {
+        pos = 0;
+    }
+
+    fill_array(arr, pos + 1);
+    return &ARR_OF(arr)[pos];
 }
 
 /*
@@ -181,14 +384,14 @@ void value_set_array(value *arr, int pos, value *val)
  */
 value *value_get_key_array(value *arr, char *pos)
 {
-    symtab_entry *entry;
+    value *elem;
 
     sanity(arr && arr->type == VALUE_TYPE_ARRAY);
 
-    entry = symtab_lookup(ARRKEYS_OF(arr), pos);
+    elem = key_element(arr, pos);
 
-    if (entry) {
-        return value_copy(&entry->entry_u.var);
+    if (elem) {
+        return value_copy(elem);
     } else {
         return value_make_void();
     }
@@ -203,8 +406,6 @@ value *value_get_key_array(value *arr, char *pos)
  */
 value *value_get_array(value *arr, int pos)
 {
-    symtab_entry *entry;
-
     sanity(arr && arr->type == VALUE_TYPE_ARRAY);
 
     if (pos < 0) {
@@ -215,8 +416,14 @@ value *value_get_array(value *arr, int pos)
         return value_make_void();
     }
 
-    entry = ARR_OF(arr)[pos];
-    return value_copy(&entry->entry_u.var);
+    switch (ARRKIND_OF(arr)) {
+        case ARRAY_KIND_INT:
+            return value_make_int(ARRINTS_OF(arr)[pos]);
+        case ARRAY_KIND_FLOAT:
+            return value_make_float(ARRFLOATS_OF(arr)[pos]);
+        default:
+            return value_copy(&ARR_OF(arr)[pos]);
+    }
 }
 
 /*
@@ -227,16 +434,17 @@ value *value_get_array(value *arr, int pos)
  */
 void value_delete_key_array(value *arr, char *pos)
 {
-    symtab_entry *entry;
+    value *elem;
 
     sanity(arr && arr->type == VALUE_TYPE_ARRAY);
+    value_detach(arr);
 
-    entry = symtab_lookup(ARRKEYS_OF(arr), pos);
+    elem = key_element(arr, pos);
 
-    if (entry) {
-        value_cleanup(&entry->entry_u.var);
-        memset(&entry->entry_u.var, 0, sizeof(value));
-        entry->entry_u.var.type = VALUE_TYPE_VOID;
+    if (elem) {
+        value_cleanup(elem);
+        memset(elem, 0, sizeof(value));
+        elem->type = VALUE_TYPE_VOID;
     }
 }
 
@@ -244,13 +452,15 @@ void value_delete_key_array(value *arr, char *pos)
  * Delete element from array
  *
  * This function removes the array element at the given index.
- * The element is freed and replaced by a void value.
+ * The element is freed and replaced by a void value, or by zero
+ * in typed arrays.
  */
 void value_delete_array(value *arr, int pos)
 {
-    symtab_entry *entry;
+    value *elem;
 
     sanity(arr && arr->type == VALUE_TYPE_ARRAY);
+    value_detach(arr);
 
     if (pos < 0) {
         pos = ARRLEN_OF(arr) + pos;
@@ -260,8 +470,78 @@ void value_delete_array(value *arr, int pos)
         return;
     }
 
-    entry = ARR_OF(arr)[pos];
-    value_cleanup(&entry->entry_u.var);
-    memset(&entry->entry_u.var, 0, sizeof(value));
-    entry->entry_u.var.type = VALUE_TYPE_VOID;
+    if (ARRKIND_OF(arr) == ARRAY_KIND_INT) {
+        ARRINTS_OF(arr)[pos] = 0;
+        return;
+    } else if (ARRKIND_OF(arr) == ARRAY_KIND_FLOAT) {
+        ARRFLOATS_OF(arr)[pos] = 0;
+        return;
+    }
+
+    elem = &ARR_OF(arr)[pos];
+    value_cleanup(elem);
+    memset(elem, 0, sizeof(value));
+    elem->type = VALUE_TYPE_VOID;
+}
+
+/*
+ * Get array element for reading
+ *
+ * Returns the storage of the element at the given index, which
+ * must exist. Elements of typed arrays are stored in tmp, which
+ * is returned instead and needs no cleanup.
+ */
+value *value_peek_array(value *arr, int pos, value *tmp)
+{
+    sanity(arr && tmp && arr->type == VALUE_TYPE_ARRAY &&
+           pos >= 0 && pos < ARRLEN_OF(arr));
+
+    switch (ARRKIND_OF(arr)) {
+        case ARRAY_KIND_INT:
+            tmp->type = VALUE_TYPE_INT;
+            INT_OF(tmp) = ARRINTS_OF(arr)[pos];
+            return tmp;
+        case ARRAY_KIND_FLOAT:
+            tmp->type = VALUE_TYPE_FLOAT;
+            FLOAT_OF(tmp) = ARRFLOATS_OF(arr)[pos];
+            return tmp;
+        default:
+            return &ARR_OF(arr)[pos];
+    }
+}
+
+/*
+ * Change kind of array elements
+ *
+ * This function converts the array to an array of values or to
+ * a typed array. Elements that are not numbers are cast to the
+ * type of a typed array, and lose their keys.
+ */
+void value_array_to_kind(value *arr, array_kind kind)
+{
+    value *fresh, *elem, *num;
+    value tmp;
+    int i;
+
+    sanity(arr && arr->type == VALUE_TYPE_ARRAY);
+
+    if (ARRKIND_OF(arr) == kind) {
+        return;
+    }
+
+    fresh = value_make_typed_array(kind);
+    for (i = 0; i < ARRLEN_OF(arr); i++) {
+        elem = value_peek_array(arr, i, &tmp);
+        if (kind != ARRAY_KIND_VALUE && !is_number(elem)) {
+            num = value_cast(NULL, elem, kind == ARRAY_KIND_INT ?
+                             VALUE_TYPE_INT : VALUE_TYPE_FLOAT);
+            value_add_to_array(fresh, num);
+            value_free(num);
+        } else {
+            value_add_to_array(fresh, elem);
+        }
+    }
+
+    value_cleanup(arr);
+    value_move_to(arr, fresh);
 }
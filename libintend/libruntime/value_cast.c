@@ -190,29 +190,16 @@ static value *cast_to_float(value *val)
 static value *cast_array_to_string(value *val)
 {
     int max = ARRLEN_OF(val);
-    int i, len, curr = 0;
-    char *buf = NULL;
+    int i;
     value *res, *elem;
 
+    res = value_make_string(NULL);
     for (i = 0; i < max; i++) {
         elem = value_get_array(val, i);
         value_cast_inplace(NULL, &elem, VALUE_TYPE_STRING);
-        len = STRLEN_OF(elem);
-        if (!buf) {
-            curr += len;
-            buf = oom(malloc(curr + 1));
-            buf[0] = '\0';
-        } else {
-            curr += len;
-            buf = oom(realloc(buf, curr + 1));
-        }
-        if (len) {
-            strcat(buf, STR_OF(elem));
-        }
+        value_append_string(res, STR_OF(elem), STRLEN_OF(elem));
         value_free(elem);
     }
-    res = value_make_string(buf);
-    free(buf);
     return res;
 }
 
@@ -303,8 +290,7 @@ static value *cast_to_array(value *val)
     } else if (val->type == VALUE_TYPE_STRING) {
         res = cast_string_to_array(val);
     } else {
-        res = value_alloc(VALUE_TYPE_ARRAY);
-        ARRKEYS_OF(res) = symtab_alloc(5);
+        res = value_make_array();
         value_add_to_array(res, val);
     }
     return res;
@@ -430,7 +416,7 @@ void value_cast_inplace(intend_state *s, value **val, value_type type)
  */
 int value_str_compat(const value *val)
 {
-    void *data;
+    const void *data;
     int len;
 
     if (!val || val->type != VALUE_TYPE_STRING) {
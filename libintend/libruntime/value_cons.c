@@ -100,39 +100,47 @@ value *value_make_float(double val)
 }
 
 /*
- * Make string value
+ * Make string value of given length
  *
- * This function returns a new string value with the same
- * content as the given C string. The value contains a
- * newly allocated copy of the string data.
+ * Strings short enough are stored inside the value, longer ones
+ * get a shared buffer of just their length.
  */
-value *value_make_string(const char *str)
+static value *make_string(const void *buf, int len)
 {
-    int len, size;
-    char *cstr;
     value *copy;
-
-    if (str) {
-        len = strlen(str);
-    } else {
-        len = 0;
-    }
+    char *data;
 
     copy = value_alloc(VALUE_TYPE_STRING);
-
-    size = len < STRING_MIN_CHARS ? STRING_MIN_CHARS : len;
-    cstr = oom(calloc(size + 1, 1));
     STRLEN_OF(copy) = len;
-    STRSIZE_OF(copy) = size;
-    STR_OF(copy) = cstr;
+
+    if (STRINLINE_OF(copy)) {
+        data = copy->value_u.string_val.local;
+    } else {
+        data = value_buffer_alloc(len);
+        copy->value_u.string_val.heap.value = data;
+        STRSIZE_OF(copy) = len;
+    }
 
     if (len > 0) {
-        memcpy(cstr, str, len + 1);
+        memcpy(data, buf, len);
     }
+    data[len] = 0;
 
     return copy;
 }
 
+/*
+ * Make string value
+ *
+ * This function returns a new string value with the same
+ * content as the given C string. The value contains a
+ * copy of the string data.
+ */
+value *value_make_string(const char *str)
+{
+    return make_string(str, str ? strlen(str) : 0);
+}
+
 /*
  * Make string from memory buffer
  *
@@ -142,27 +150,10 @@ value *value_make_string(const char *str)
  */
 value *value_make_memstring(const void *buf, int len)
 {
-    int size;
-    char *mem;
-    value *copy;
-
-    if (!buf || len == 0) {
-        return value_make_string(NULL);
-    }
-
-    copy = value_alloc(VALUE_TYPE_STRING);
-
-    size = len < STRING_MIN_CHARS ? STRING_MIN_CHARS : len;
-    mem = oom(calloc(size + 1, 1));
-    STRLEN_OF(copy) = len;
-    STRSIZE_OF(copy) = size;
-    STR_OF(copy) = mem;
-
-    if (len > 0) {
-        memcpy(mem, buf, len);
+    if (!buf) {
+        len = 0;
     }
-
-    return copy;
+    return make_string(buf, len);
 }
 
 /*
@@ -176,7 +167,23 @@ value *value_make_array(void)
     value *copy;
 
     copy = value_alloc(VALUE_TYPE_ARRAY);
-    ARRKEYS_OF(copy) = symtab_alloc(5);
+    copy->value_u.array_val = oom(calloc(1, sizeof(value_array)));
+    ARRREF_OF(copy) = 1;
+    return copy;
+}
+
+/*
+ * Make typed array value
+ *
+ * This functions returns a new empty array that stores its
+ * elements as raw numbers of the given kind.
+ */
+value *value_make_typed_array(array_kind kind)
+{
+    value *copy;
+
+    copy = value_make_array();
+    ARRKIND_OF(copy) = kind;
     return copy;
 }
 
@@ -190,7 +197,7 @@ value *value_make_struct(void)
     value *copy;
 
     copy = value_alloc(VALUE_TYPE_STRUCT);
-    copy->value_u.struct_val = symtab_alloc(5);
+    copy->value_u.struct_val = symtab_alloc_struct();
 
     return copy;
 }
@@ -39,46 +39,217 @@
 #include "runtime.h"
 
 /*
- * Copy array value
+ * Duplicate array data
  *
- * This functions returns a full recursive copy of the
- * given input array.
+ * This function gives the array value a private copy of its
+ * elements. The elements themselves are shared with the
+ * original array as usual. Elements bound to a call lose their
+ * binding, since the call may store back to either array.
  */
-static value *copy_array(value *copy, value *val)
+static void detach_array(value *val)
 {
-    int size  = ARRSIZE_OF(val);
-    symtab_entry **next = ARR_OF(val);
+    value_array *orig = val->value_u.array_val;
+    size_t size;
+    int i;
 
-    if (!ARRKEYS_OF(copy))
-        ARRKEYS_OF(copy) = symtab_alloc(5);
+    --orig->refcount;
+    val->value_u.array_val = oom(calloc(1, sizeof(value_array)));
+    ARRREF_OF(val) = 1;
+    ARRKIND_OF(val) = orig->kind;
 
-    if (next) {
-        while (*next) {
-            if ((*next)->symbol) {
-                value_add_to_key_array(copy, (*next)->symbol, &(*next)->entry_u.var);
+    if (orig->kind != ARRAY_KIND_VALUE) {
+        if (orig->len > 0) {
+            size = orig->kind == ARRAY_KIND_INT ? sizeof(int) : sizeof(double);
+            ARRSIZE_OF(val) = orig->len;
+            val->value_u.array_val->data = oom(malloc(orig->len * size));
+            memcpy(val->value_u.array_val->data, orig->data, orig->len * size);
+            ARRLEN_OF(val) = orig->len;
+        }
+        return;
+    }
+
+    if (orig->keys) {
+        for (i = 0; i < orig->len; i++) {
+            value_unbind(&orig->values[i]);
+            if (orig->names[i]) {
+                value_add_to_key_array(val, orig->names[i], &orig->values[i]);
             } else {
-                value_add_to_array(copy, &(*next)->entry_u.var);
+                value_add_to_array(val, &orig->values[i]);
             }
-            next++;
         }
+        return;
+    }
+
+    if (orig->len > 0) {
+        ARRSIZE_OF(val) = orig->len;
+        ARR_OF(val) = oom(calloc(orig->len, sizeof(value)));
+        for (i = 0; i < orig->len; i++) {
+            value_unbind(&orig->values[i]);
+            value_copy_to(&ARR_OF(val)[i], &orig->values[i]);
+        }
+        ARRLEN_OF(val) = orig->len;
     }
-    return copy;
 }
 
 /*
- * Copy struct value
+ * Duplicate struct data
  *
- * This functions returns a full recursive copy of the
- * given input struct.
+ * This function gives the struct value a private copy of its
+ * fields, see symtab_copy().
  */
-static value *copy_struct(value *copy, value *val)
+static void detach_struct(value *val)
 {
-    symtab *nsym, *sym = STRUCT_OF(val);
+    symtab *sym = STRUCT_OF(val);
 
-    nsym = symtab_copy(sym);
-    STRUCT_OF(copy) = nsym;
+    --sym->refcount;
+    STRUCT_OF(val) = symtab_copy(sym);
+}
 
-    return copy;
+/*
+ * Make value data private
+ *
+ * Copies of strings, arrays and structs share their data. This
+ * function must be called before modifying the data of such a
+ * value in place; it duplicates the data if other values still
+ * share it. A copy bound to a call for update keeps the data as
+ * long as all copies sharing it are bound, see value_bind().
+ */
+void value_detach(value *val)
+{
+    symtab *sym;
+
+    sanity(val);
+
+    switch (val->type) {
+        case VALUE_TYPE_ARRAY:
+            if (ARRREF_OF(val) > 1 && (BIND_OF(val) != VALUE_BIND_WRITE ||
+                                       ARRREF_OF(val) > ARRBOUND_OF(val))) {
+                value_unbind(val);
+                detach_array(val);
+            }
+            break;
+        case VALUE_TYPE_STRUCT:
+            sym = STRUCT_OF(val);
+            if (sym->refcount > 1 && (BIND_OF(val) != VALUE_BIND_WRITE ||
+                                      sym->refcount > sym->bound)) {
+                value_unbind(val);
+                detach_struct(val);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Make struct private for changes to its fields
+ *
+ * Like value_detach(), but bound copies are counted as well:
+ * adding, replacing or removing fields may move entries that
+ * the running method still uses.
+ */
+void value_detach_fields(value *val)
+{
+    sanity(val && val->type == VALUE_TYPE_STRUCT);
+
+    if (STRUCTREF_OF(val) > 1) {
+        value_unbind(val);
+        detach_struct(val);
+    }
+}
+
+/*
+ * Bind array or struct to call
+ *
+ * A call that takes an array or struct by reference holds copies
+ * of it besides the storage it is read from and stored back to:
+ * its own handle, the argument and the variable the function
+ * works on, `this' for methods. Such copies are marked bound to
+ * the call, and counted in the shared data. The copy bound for
+ * update is not detached while all copies sharing the data are
+ * bound, so the function updates the storage in place. Any other
+ * copy still detaches before it is changed. A copy is unbound
+ * when it is cleaned or detached, and returns 0 if it is already
+ * bound.
+ */
+int value_bind(value *val, int bind)
+{
+    sanity(val && bind != VALUE_BIND_NONE);
+
+    if (BIND_OF(val) != VALUE_BIND_NONE) {
+        return 0;
+    }
+
+    switch (val->type) {
+        case VALUE_TYPE_ARRAY:
+            ++ARRBOUND_OF(val);
+            break;
+        case VALUE_TYPE_STRUCT:
+            ++STRUCTBOUND_OF(val);
+            break;
+        default:
+            sanity(0);
+            break;
+    }
+    BIND_OF(val) = bind;
+    return 1;
+}
+
+/*
+ * Bind storage of array or struct to call
+ *
+ * The storage that a call stores an array or struct back to is
+ * bound to hold it. Returns 1 if it is bound here, and 0 if it is
+ * already bound for update by a call further out, which then
+ * makes its updates in place through this one. Returns -1 if the
+ * data is bound to another call through some other copy: nothing
+ * may be bound for update then, since the updates would show
+ * through that copy.
+ */
+int value_bind_storage(value *val)
+{
+    sanity(val && (val->type == VALUE_TYPE_ARRAY ||
+                   val->type == VALUE_TYPE_STRUCT));
+
+    if (BIND_OF(val) == VALUE_BIND_WRITE) {
+        return 0;
+    }
+    if (val->type == VALUE_TYPE_ARRAY ? ARRBOUND_OF(val) > 0 :
+                                        STRUCTBOUND_OF(val) > 0) {
+        return -1;
+    }
+    return value_bind(val, VALUE_BIND_HOLD);
+}
+
+/*
+ * Unbind array or struct from call
+ *
+ * Other values are left alone, strings keep their length where
+ * arrays and structs keep their binding.
+ */
+void value_unbind(value *val)
+{
+    sanity(val);
+
+    switch (val->type) {
+        case VALUE_TYPE_ARRAY:
+            if (BIND_OF(val) == VALUE_BIND_NONE) {
+                return;
+            }
+            sanity(ARRBOUND_OF(val) > 0);
+            --ARRBOUND_OF(val);
+            break;
+        case VALUE_TYPE_STRUCT:
+            if (BIND_OF(val) == VALUE_BIND_NONE) {
+                return;
+            }
+            sanity(STRUCTBOUND_OF(val) > 0);
+            --STRUCTBOUND_OF(val);
+            break;
+        default:
+            return;
+    }
+    BIND_OF(val) = VALUE_BIND_NONE;
 }
 
 /*
@@ -98,18 +269,29 @@ value *copy_resource(value *copy, value *val)
 /*
  * Copy value to pre-allocated value
  *
- * This function makes a recursive copy of the input value
- * to a pre-allocated destination.
+ * This function copies the input value to a pre-allocated
+ * destination. Strings, arrays and structs share their data
+ * with the original until either value is modified.
  */
 value *value_copy_to(value *copy, value *val)
 {
-    int len;
-    int size;
-    char *str;
-
     sanity(copy && val);
 
-    if (copy->type != val->type || val->type > VALUE_TYPE_STRING) {
+    if (copy == val) {
+        return copy;
+    }
+
+    // A copy bound for update keeps its binding to the same data
+    if (copy->type == val->type &&
+            ((val->type == VALUE_TYPE_ARRAY &&
+              copy->value_u.array_val == val->value_u.array_val) ||
+             (val->type == VALUE_TYPE_STRUCT &&
+              STRUCT_OF(copy) == STRUCT_OF(val))) &&
+            BIND_OF(copy) == VALUE_BIND_WRITE) {
+        return copy;
+    }
+
+    if (copy->type != val->type || val->type >= VALUE_TYPE_STRING) {
         value_cleanup(copy);
         copy->type = val->type;
     }
@@ -122,34 +304,19 @@ value *value_copy_to(value *copy, value *val)
             *copy = *val;
             break;
         case VALUE_TYPE_STRING:
-            // Get the dimensions of source
-            len = STRLEN_OF(val);
-            size = STRSIZE_OF(val);
-            // Get the string of copy
-            str = STR_OF(copy);
-            // Alloc or realloc if size does not match
-            if (!str) {
-                str = oom(malloc(size + 1));
-                STR_OF(copy) = str;
-            } else if (STRSIZE_OF(copy) != size) {
-                str = oom(realloc(str, size + 1));
-                STR_OF(copy) = str;
-            }
-            // Clear the string
-            memset(str, 0, size + 1);
-            // Copy the string from source if any
-            if (len > 0) {
-                memcpy(str, STR_OF(val), len);
+            STRLEN_OF(copy) = STRLEN_OF(val);
+            copy->value_u.string_val = val->value_u.string_val;
+            if (!STRINLINE_OF(copy)) {
+                ++STRREF_OF(copy);
             }
-            // Set the destination dimensions
-            STRLEN_OF(copy) = len;
-            STRSIZE_OF(copy) = size;
             break;
         case VALUE_TYPE_ARRAY:
-            copy_array(copy, val);
+            copy->value_u.array_val = val->value_u.array_val;
+            ++ARRREF_OF(copy);
             break;
         case VALUE_TYPE_STRUCT:
-            copy_struct(copy, val);
+            STRUCT_OF(copy) = STRUCT_OF(val);
+            ++STRUCTREF_OF(copy);
             break;
         case VALUE_TYPE_FN:
             FNSIG_OF(copy) = call_sig_copy(FNSIG_OF(val));
@@ -164,7 +331,7 @@ value *value_copy_to(value *copy, value *val)
 /*
  * Copy value
  *
- * This function makes a recursive copy of the input value.
+ * This function makes a copy of the input value.
  */
 value *value_copy(value *val)
 {
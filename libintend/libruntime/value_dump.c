@@ -66,7 +66,7 @@ static void print_fn(intend_state *s, signature *sig)
 static void escape_str(intend_state *s, const value *val)
 {
     const char *hex = "0123456789abcdef";
-    char *str = STR_OF(val);
+    const char *str = STR_OF(val);
     int len   = STRLEN_OF(val);
     int i;
 
@@ -132,10 +132,9 @@ static void depth_prefix(intend_state *s, int depth)
 void value_dump(intend_state *s, const value *val, int depth, int skip_flag)
 {
     symtab *sym;
-    symtab_node *node;
     symtab_entry *entry;
     unsigned int si, sj;
-    value *next;
+    value *next, tmp;
     int i, len;
 
     if (!val) {
@@ -176,9 +175,9 @@ void value_dump(intend_state *s, const value *val, int depth, int skip_flag)
                 depth += 2;
                 for (i = 0; i < ARRLEN_OF(val); i++) {
                     depth_prefix(s, depth);
-                    next = (value *) &(ARR_OF(val)[i]->entry_u.var);
-                    if (ARR_OF(val)[i]->symbol) {
-                        len = fprintf(s->stdout, "[\"%s\"] ", ARR_OF(val)[i]->symbol);
+                    next = value_peek_array((value *) val, i, &tmp);
+                    if (ARRKEY_OF(val, i)) {
+                        len = fprintf(s->stdout, "[\"%s\"] ", ARRKEY_OF(val, i));
                     } else {
                         len = fprintf(s->stdout, "[%i] ", i);
                     }
@@ -195,26 +194,21 @@ void value_dump(intend_state *s, const value *val, int depth, int skip_flag)
                 fprintf(s->stdout, "struct(%i): {\n", symtab_num_entries(val->value_u.struct_val));
                 depth += 2;
                 sym = val->value_u.struct_val;
-                for (si = 0; si < (unsigned int)(1 << sym->order); si++) {
-                    node = sym->nodes[si];
-                    if (node) {
-                        for (sj = 0; sj < node->len; sj++) {
-                            entry = &node->entries[sj];
-                            if (entry && entry->type == SYMTAB_ENTRY_VAR) {
-                                depth_prefix(s, depth);
-                                len = fprintf(s->stdout, ".%s = ", entry->symbol);
-                                depth += len;
-                                skip_flag = 1;
-                                value_dump(s, &entry->entry_u.var, depth, skip_flag);
-                                depth -= len;
-                            }
-                            if (entry && entry->type == SYMTAB_ENTRY_FUNCTION) {
-                                depth_prefix(s, depth);
-                                fprintf(s->stdout, ".%s = ", entry->symbol);
-                                print_fn(s, &(entry->entry_u.fnc.sigs[0]));
-                                fprintf(s->stdout, "\n");
-                            }
-                        }
+                si = sj = 0;
+                while ((entry = symtab_next(sym, &si, &sj))) {
+                    if (entry->type == SYMTAB_ENTRY_VAR) {
+                        depth_prefix(s, depth);
+                        len = fprintf(s->stdout, ".%s = ", entry->symbol);
+                        depth += len;
+                        skip_flag = 1;
+                        value_dump(s, &entry->entry_u.var, depth, skip_flag);
+                        depth -= len;
+                    }
+                    if (entry->type == SYMTAB_ENTRY_FUNCTION) {
+                        depth_prefix(s, depth);
+                        fprintf(s->stdout, ".%s = ", entry->symbol);
+                        print_fn(s, &(entry->entry_u.fnc.sigs[0]));
+                        fprintf(s->stdout, "\n");
                     }
                 }
                 depth -= 2;
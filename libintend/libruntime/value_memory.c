@@ -42,27 +42,53 @@
  * Allocate new value
  *
  * This function allocates storage for a new value of the
- * given type and returns a pointer to the new value.
+ * given type and returns a pointer to the new value. The value
+ * is counted in the value_allocs of the running context. Values
+ * stored in place, like variables, array elements and scalar
+ * temporaries of both engines, are not counted.
  */
 value *value_alloc(value_type type)
 {
+    intend_state *s = state_current();
     value *val;
 
-    val = oom(calloc(1, sizeof(value)));
+    val = slab_alloc(sizeof(value));
     val->type = type;
+    BIND_OF(val) = VALUE_BIND_NONE;
+    if (s) {
+        ++s->value_allocs;
+    }
     return val;
 }
 
+/*
+ * Allocate string buffer
+ *
+ * This function allocates a shared string buffer for size
+ * characters plus a terminating 0 byte, and returns a pointer
+ * to its data. The characters are left uninitialized.
+ */
+char *value_buffer_alloc(int size)
+{
+    value_buffer *buf;
+
+    buf = oom(malloc(offsetof(value_buffer, data) + size + 1));
+    buf->refcount = 1;
+    buf->data[size] = 0;
+    return buf->data;
+}
+
 /*
  * Cleans a value
  *
  * This function frees the memory occupied by a value.
- * For an array, all its elements are freed before
- * the array itself is.
+ * Shared string, array and struct data is only freed
+ * when the last value using it is cleaned. For an array,
+ * all its elements are freed before the array itself is.
  */
 void value_cleanup(value *val)
 {
-    symtab_entry **next;
+    int i;
 
     // Avoid null values
     if (!val) return;
@@ -74,25 +100,39 @@ void value_cleanup(value *val)
         case VALUE_TYPE_FLOAT:
             break;
         case VALUE_TYPE_STRING:
-            free(STR_OF(val));
+            if (!STRINLINE_OF(val) && --STRREF_OF(val) == 0) {
+                free(STR_OF(val) - offsetof(value_buffer, data));
+            }
             break;
         case VALUE_TYPE_ARRAY:
-            next = ARR_OF(val);
-            if (next) {
-                while (*next) {
-                    if ((*next)->symbol) {
-                        symtab_delete(ARRKEYS_OF(val), (*next)->symbol);
-                    } else {
-                        symtab_entry_free(*next);
-                    }
-                    next++;
+            if (!val->value_u.array_val) {
+                break;
+            }
+            if (BIND_OF(val)) {
+                value_unbind(val);
+            }
+            if (--ARRREF_OF(val) > 0) {
+                break;
+            }
+            for (i = 0; ARR_OF(val) && i < ARRLEN_OF(val); i++) {
+                value_cleanup(&ARR_OF(val)[i]);
+                if (ARRNAMES_OF(val)) {
+                    intern_release(ARRNAMES_OF(val)[i]);
                 }
             }
             free(ARR_OF(val));
+            free(val->value_u.array_val->data);
+            free(ARRNAMES_OF(val));
             symtab_free(ARRKEYS_OF(val));
+            free(val->value_u.array_val);
             break;
         case VALUE_TYPE_STRUCT:
-            symtab_free(val->value_u.struct_val);
+            if (STRUCT_OF(val) && BIND_OF(val)) {
+                value_unbind(val);
+            }
+            if (STRUCT_OF(val) && --STRUCTREF_OF(val) == 0) {
+                symtab_free(STRUCT_OF(val));
+            }
             break;
         case VALUE_TYPE_FN:
             call_sig_free(FNSIG_OF(val));
@@ -125,5 +165,20 @@ void value_free(value *val)
 
     value_cleanup(val);
 
-    free(val);
+    slab_free(val, sizeof(value));
+}
+
+/*
+ * Move value to pre-allocated value
+ *
+ * This function moves the contents of a value allocated with
+ * value_alloc() to a clean destination and frees the emptied
+ * value.
+ */
+void value_move_to(value *copy, value *val)
+{
+    sanity(copy && val && copy != val);
+
+    *copy = *val;
+    slab_free(val, sizeof(value));
 }
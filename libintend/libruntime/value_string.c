@@ -0,0 +1,123 @@
+/***************************************************************************
+ *                                                                         *
+ *   Intend C - Embeddable Scripting Language                              *
+ *                                                                         *
+ *   Copyright (C) 2008 by Pedro Reis Colaço <info@intendc.org>            *
+ *   http://www.intendc.org                                                *
+ *                                                                         *
+ *   LICENSE INFORMATION:                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Library General Public License as       *
+ *   published by the Free Software Foundation; either version 2 of the    *
+ *   License, or (at your option) any later version.                       *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU Library General Public     *
+ *   License along with this program; if not, write to the                 *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ *                                                                         *
+ *   ACKNOWLEDGEMENTS:                                                     *
+ *                                                                         *
+ *   This project was based on the work of Pascal Schmidt in project       *
+ *   Arena. See http://www.minimalinux.org/arena/ for more information.    *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+ * Intend C String functions
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "runtime.h"
+
+/*
+ * Concatenate strings
+ *
+ * Returns a new string value holding the contents of both given
+ * strings, in storage of just their joint length.
+ */
+value *value_concat_string(value *a, value *b)
+{
+    value *res;
+    char *buf;
+    int len;
+
+    sanity(a && b && a->type == VALUE_TYPE_STRING &&
+           b->type == VALUE_TYPE_STRING);
+
+    len = STRLEN_OF(a) + STRLEN_OF(b);
+    res = value_alloc(VALUE_TYPE_STRING);
+
+    if (len <= STRING_INLINE_CHARS) {
+        buf = res->value_u.string_val.local;
+    } else {
+        buf = value_buffer_alloc(len);
+        res->value_u.string_val.heap.value = buf;
+        STRSIZE_OF(res) = len;
+    }
+    memcpy(buf, STR_OF(a), STRLEN_OF(a));
+    memcpy(buf + STRLEN_OF(a), STR_OF(b), STRLEN_OF(b));
+    buf[len] = 0;
+    STRLEN_OF(res) = len;
+
+    return res;
+}
+
+/*
+ * Append to string in place
+ *
+ * Appends len chars of data to the given string value. A buffer
+ * that is not shared with other values and has room left is
+ * extended in place. Otherwise the string moves to a new buffer
+ * of at least twice the size, so that building a string by
+ * repeated appends takes amortized linear time. The data may be
+ * part of the string itself.
+ */
+void value_append_string(value *str, const void *data, int len)
+{
+    int oldlen, newlen, size;
+    char *buf;
+
+    sanity(str && str->type == VALUE_TYPE_STRING && len >= 0);
+
+    if (len == 0) {
+        return;
+    }
+
+    oldlen = STRLEN_OF(str);
+    newlen = oldlen + len;
+
+    if (newlen <= STRING_INLINE_CHARS) {
+        buf = str->value_u.string_val.local;
+    } else if (!STRINLINE_OF(str) && STRREF_OF(str) == 1 &&
+               newlen <= STRSIZE_OF(str)) {
+        buf = str->value_u.string_val.heap.value;
+    } else {
+        size = STRINLINE_OF(str) ? oldlen : STRSIZE_OF(str);
+        size = size * 2 > newlen ? size * 2 : newlen;
+
+        buf = value_buffer_alloc(size);
+        memcpy(buf, STR_OF(str), oldlen);
+        memcpy(buf + oldlen, data, len);
+        buf[newlen] = 0;
+
+        value_cleanup(str);
+        str->type = VALUE_TYPE_STRING;
+        STRLEN_OF(str) = newlen;
+        STRSIZE_OF(str) = size;
+        str->value_u.string_val.heap.value = buf;
+        return;
+    }
+
+    memmove(buf + oldlen, data, len);
+    buf[newlen] = 0;
+    STRLEN_OF(str) = newlen;
+}
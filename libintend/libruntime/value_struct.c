@@ -45,6 +45,7 @@ void value_set_struct(value *st, const char *pos, value *val)
     symtab *sym;
 
     sanity(st && pos && val);
+    value_detach_fields(st);
     sym = st->value_u.struct_val;
     sanity(sym);
 
@@ -78,6 +79,42 @@ value *value_get_struct(value *st, const char *pos)
     }
 }
 
+/*
+ * Get struct field for update
+ *
+ * Returns the storage of the field, so that it can be modified in
+ * place. Missing fields and methods are replaced by a void field.
+ */
+value *value_ref_struct(value *st, const char *pos)
+{
+    symtab *sym;
+    symtab_entry *entry;
+    value *fill;
+
+    sanity(st && pos);
+    sym = st->value_u.struct_val;
+    sanity(sym);
+
+    entry = symtab_lookup(sym, pos);
+    if (entry && entry->type == SYMTAB_ENTRY_VAR) {
+        value_detach(st);
+    } else {
+        value_detach_fields(st);
+    }
+    if (st->value_u.struct_val != sym) {
+        sym = st->value_u.struct_val;
+        entry = symtab_lookup(sym, pos);
+    }
+
+    if (!entry || entry->type != SYMTAB_ENTRY_VAR) {
+        fill = value_make_void();
+        symtab_add_variable(sym, pos, fill);
+        value_free(fill);
+        entry = symtab_lookup(sym, pos);
+    }
+    return &entry->entry_u.var;
+}
+
 /*
  * Delete struct field
  */
@@ -86,6 +123,7 @@ void value_delete_struct(value *st, const char *pos)
     symtab *sym;
 
     sanity(st && pos);
+    value_detach_fields(st);
     sym = st->value_u.struct_val;
     sanity(sym);
 
@@ -101,6 +139,7 @@ void value_set_struct_method(value *st, const char *method, call_func vector, un
     signature sig;
 
     sanity(st && method && vector && proto);
+    value_detach_fields(st);
 
     sig.type = FUNCTION_TYPE_BUILTIN;
     sig.args  = args;
@@ -113,11 +152,23 @@ void value_set_struct_method(value *st, const char *method, call_func vector, un
 
 /*
  * Enter struct namespace
+ *
+ * The struct is bound to the call, see value_bind(): the handle
+ * of the call holds it and `this' is updated in place. If the
+ * variable holding it is the one it is stored back to, that
+ * variable is bound as well and shares the updates of the method.
+ * Nothing is bound if it could not be, see value_bind_storage().
  */
-static void enter_struct(intend_state *s, value *val)
+static void enter_struct(intend_state *s, value *val, int receiver)
 {
+    symtab_entry *entry;
+
     symtab_stack_enter(s);
-    symtab_stack_add_variable(s, "this", val);
+    entry = symtab_stack_add_variable(s, "this", val);
+    if (receiver >= 0) {
+        value_bind(val, VALUE_BIND_HOLD);
+        value_bind(&entry->entry_u.var, VALUE_BIND_WRITE);
+    }
 }
 
 /*
@@ -142,9 +193,10 @@ static value *leave_struct(intend_state *s)
 value *value_call_struct_method(intend_state *s, const char *name, const char *method,
                          unsigned int argc, value **argv)
 {
-    symtab_entry *entry;
+    symtab_entry *entry, *method_entry;
     value *st = NULL;
     value *res, *temp;
+    int receiver;
 
     sanity(name && method && argv);
 
@@ -159,28 +211,41 @@ value *value_call_struct_method(intend_state *s, const char *name, const char *m
     }
 
     // Lookup for method inside struct
-    entry = symtab_lookup(st->value_u.struct_val, method);
-    if (!entry || entry->type != SYMTAB_ENTRY_FUNCTION) {
+    method_entry = symtab_lookup(st->value_u.struct_val, method);
+    if (!method_entry || method_entry->type != SYMTAB_ENTRY_FUNCTION) {
         fatal(s, "call to undefined method `%s'", method);
         return value_make_void();
     }
 
     // Enter the struct namespace
-    enter_struct(s, st);
+    if (entry == symtab_stack_lookup_top(s, name)) {
+        receiver = value_bind_storage(st);
+    } else {
+        receiver = STRUCTBOUND_OF(st) > 0 ? -1 : 0;
+    }
+    st = value_copy(st);
+    enter_struct(s, st, receiver);
 
     // Call the method
-    res = call_function(s, &(entry->entry_u.fnc.sigs[0]), argc, argv);
+    res = call_function(s, &(method_entry->entry_u.fnc.sigs[0]), argc, argv);
 
     // Exit the struct namespace and get result struct
     temp = leave_struct(s);
+    value_free(st);
 
     if (temp) {
         // Set struct to result struct
-        symtab_stack_add_variable(s, name, st);
+        symtab_stack_add_variable(s, name, temp);
         // Free the result struct
         value_free(temp);
+    } else if (receiver > 0) {
+        // Unbind the variable that is not stored back to
+        entry = symtab_stack_lookup_top(s, name);
+        if (entry && entry->type == SYMTAB_ENTRY_VAR &&
+                BIND_OF(&entry->entry_u.var) == VALUE_BIND_HOLD) {
+            value_unbind(&entry->entry_u.var);
+        }
     }
 
     return res;
 }
-
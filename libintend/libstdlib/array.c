@@ -44,6 +44,12 @@
 static register_func_data array_funcs[] = {
     { "mkarray",        array_mkarray,      0,  "",     'a' },
     { "mkkeyarray",     array_mkkeyarray,   0,  "",     'a' },
+    { "mkintarray",     array_mkintarray,   0,  "",     'a' },
+    { "mkfloatarray",   array_mkfloatarray, 0,  "",     'a' },
+    { "array_int",      array_int,          1,  "a",    'a' },
+    { "array_float",    array_float,        1,  "a",    'a' },
+    { "array_plain",    array_plain,        1,  "a",    'a' },
+    { "array_type",     array_type,         1,  "a",    's' },
     { "qsort",          array_sort,         1,  "a",    'a' },
     { "is_sorted",      array_is_sorted,    1,  "a",    'b' },
     { "array_unset",    array_unset,        2,  "ai",   'a' },
@@ -70,8 +76,8 @@ void array_init(intend_state *s)
  */
 static int compar(const void *a, const void *b)
 {
-    value *first = &(*(symtab_entry **)a)->entry_u.var;
-    value *second = &(*(symtab_entry **)b)->entry_u.var;
+    value *first = (value *) a;
+    value *second = (value *) b;
     value *res, *cast = NULL;
     int order;
 
@@ -93,6 +99,68 @@ static int compar(const void *a, const void *b)
     }
 }
 
+/*
+ * Comparison function for qsort of element pointers
+ */
+static int compar_ref(const void *a, const void *b)
+{
+    return compar(*(value **) a, *(value **) b);
+}
+
+/*
+ * Comparison function for qsort of int arrays
+ */
+static int compar_int(const void *a, const void *b)
+{
+    int first = *(const int *) a;
+    int second = *(const int *) b;
+
+    return (first > second) - (first < second);
+}
+
+/*
+ * Comparison function for qsort of float arrays
+ */
+static int compar_float(const void *a, const void *b)
+{
+    double first = *(const double *) a;
+    double second = *(const double *) b;
+
+    return (first > second) - (first < second);
+}
+
+/*
+ * Create typed array from parameter values
+ *
+ * The values are cast to the element type of the array.
+ */
+static value *mktyped(intend_state *s, array_kind kind, unsigned int argc,
+                      value **argv)
+{
+    value *arr;
+    unsigned int i;
+
+    arr = value_make_typed_array(kind);
+    for (i = 0; i < argc; i++) {
+        value_cast_inplace(s, &argv[i], kind == ARRAY_KIND_INT ?
+                           VALUE_TYPE_INT : VALUE_TYPE_FLOAT);
+        value_add_to_array(arr, argv[i]);
+    }
+    return arr;
+}
+
+/*
+ * Convert copy of array to given kind
+ */
+static value *tokind(value *arr, array_kind kind)
+{
+    value *res;
+
+    res = value_copy(arr);
+    value_array_to_kind(res, kind);
+    return res;
+}
+
 /*
  * Create array from parameter values
  */
@@ -108,6 +176,72 @@ value *array_mkarray(intend_state *s, unsigned int argc, value **argv)
     return arr;
 }
 
+/*
+ * Create int array from parameter values
+ *
+ * Int arrays store their elements as raw C ints.
+ */
+value *array_mkintarray(intend_state *s, unsigned int argc, value **argv)
+{
+    return mktyped(s, ARRAY_KIND_INT, argc, argv);
+}
+
+/*
+ * Create float array from parameter values
+ *
+ * Float arrays store their elements as raw C doubles.
+ */
+value *array_mkfloatarray(intend_state *s, unsigned int argc, value **argv)
+{
+    return mktyped(s, ARRAY_KIND_FLOAT, argc, argv);
+}
+
+/*
+ * Convert array to int array
+ *
+ * Elements are cast to int and keys are dropped.
+ */
+value *array_int(intend_state *s, unsigned int argc, value **argv)
+{
+    return tokind(argv[0], ARRAY_KIND_INT);
+}
+
+/*
+ * Convert array to float array
+ *
+ * Elements are cast to float and keys are dropped.
+ */
+value *array_float(intend_state *s, unsigned int argc, value **argv)
+{
+    return tokind(argv[0], ARRAY_KIND_FLOAT);
+}
+
+/*
+ * Convert typed array to regular array
+ */
+value *array_plain(intend_state *s, unsigned int argc, value **argv)
+{
+    return tokind(argv[0], ARRAY_KIND_VALUE);
+}
+
+/*
+ * Get element type of array
+ *
+ * Returns "int" or "float" for typed arrays, and "mixed" for
+ * regular arrays.
+ */
+value *array_type(intend_state *s, unsigned int argc, value **argv)
+{
+    switch (ARRKIND_OF(argv[0])) {
+        case ARRAY_KIND_INT:
+            return value_make_string("int");
+        case ARRAY_KIND_FLOAT:
+            return value_make_string("float");
+        default:
+            return value_make_string("mixed");
+    }
+}
+
 /*
  * Create key array from parameter value pairs
  */
@@ -142,14 +276,52 @@ value *array_mkkeyarray(intend_state *s, unsigned int argc, value **argv)
 /*
  * Quicksort
  *
- * This function sorts a numerically indexed array based on the
- * contained values.
+ * This function sorts an array based on the contained values.
+ * Arrays without keys are sorted in place; elements with keys
+ * keep them, so such arrays are rebuilt in sorted order.
  */
 value *array_sort(intend_state *s, unsigned int argc, value **argv)
 {
-    qsort(ARR_OF(argv[0]), ARRLEN_OF(argv[0]),
-          sizeof(symtab_entry *), compar);
-    return value_copy(argv[0]);
+    value *arr = argv[0];
+    value **order;
+    value *res;
+    int i, pos;
+
+    if (ARRKIND_OF(arr) != ARRAY_KIND_VALUE) {
+        res = value_copy(arr);
+        value_detach(res);
+        if (ARRKIND_OF(res) == ARRAY_KIND_INT) {
+            qsort(ARRINTS_OF(res), ARRLEN_OF(res), sizeof(int), compar_int);
+        } else {
+            qsort(ARRFLOATS_OF(res), ARRLEN_OF(res), sizeof(double), compar_float);
+        }
+        return res;
+    }
+
+    if (!ARRNAMES_OF(arr)) {
+        res = value_copy(arr);
+        value_detach(res);
+        qsort(ARR_OF(res), ARRLEN_OF(res), sizeof(value), compar);
+        return res;
+    }
+
+    order = oom(malloc((ARRLEN_OF(arr) + 1) * sizeof(value *)));
+    for (i = 0; i < ARRLEN_OF(arr); i++) {
+        order[i] = &ARR_OF(arr)[i];
+    }
+    qsort(order, ARRLEN_OF(arr), sizeof(value *), compar_ref);
+
+    res = value_make_array();
+    for (i = 0; i < ARRLEN_OF(arr); i++) {
+        pos = order[i] - ARR_OF(arr);
+        if (ARRKEY_OF(arr, pos)) {
+            value_add_to_key_array(res, ARRKEY_OF(arr, pos), order[i]);
+        } else {
+            value_add_to_array(res, order[i]);
+        }
+    }
+    free(order);
+    return res;
 }
 
 /*
@@ -159,16 +331,16 @@ value *array_sort(intend_state *s, unsigned int argc, value **argv)
  */
 value *array_is_sorted(intend_state *s, unsigned int argc, value **argv)
 {
-    symtab_entry **next = ARR_OF(argv[0]);
     int max = ARRLEN_OF(argv[0]);
+    value one, two;
     int i, res;
 
     for (i = 0; i < max - 1; i++) {
-        res = compar(next, next + 1);
+        res = compar(value_peek_array(argv[0], i, &one),
+                     value_peek_array(argv[0], i + 1, &two));
         if (res > 0) {
             return value_make_bool(0);
         }
-        next++;
     }
     return value_make_bool(1);
 }
@@ -181,8 +353,11 @@ value *array_is_sorted(intend_state *s, unsigned int argc, value **argv)
  */
 value *array_unset(intend_state *s, unsigned int argc, value **argv)
 {
-    value_delete_array(argv[0], INT_OF(argv[1]));
-    return value_copy(argv[0]);
+    value *res;
+
+    res = value_copy(argv[0]);
+    value_delete_array(res, INT_OF(argv[1]));
+    return res;
 }
 
 /*
@@ -194,17 +369,17 @@ value *array_unset(intend_state *s, unsigned int argc, value **argv)
 value *array_compact(intend_state *s, unsigned int argc, value **argv)
 {
     value *arr = argv[0];
-    value *copy;
+    value *copy, *elem, tmp;
     int i;
 
-    copy = value_make_array();
+    copy = value_make_typed_array(ARRKIND_OF(arr));
     for (i = 0; i < ARRLEN_OF(arr); i++) {
-        if (ARR_OF(arr)[i] &&
-                ARR_OF(arr)[i]->entry_u.var.type != VALUE_TYPE_VOID) {
-            if (ARR_OF(arr)[i]->symbol) {
-                value_add_to_key_array(copy, ARR_OF(arr)[i]->symbol, &ARR_OF(arr)[i]->entry_u.var);
+        elem = value_peek_array(arr, i, &tmp);
+        if (elem->type != VALUE_TYPE_VOID) {
+            if (ARRKEY_OF(arr, i)) {
+                value_add_to_key_array(copy, ARRKEY_OF(arr, i), elem);
             } else {
-                value_add_to_array(copy, &ARR_OF(arr)[i]->entry_u.var);
+                value_add_to_array(copy, elem);
             }
         }
     }
@@ -219,11 +394,11 @@ value *array_compact(intend_state *s, unsigned int argc, value **argv)
  */
 value *array_search(intend_state *s, unsigned int argc, value **argv)
 {
-    value *cmp;
+    value *cmp, tmp;
     int i, cmpval;
 
     for (i = 0; i < ARRLEN_OF(argv[0]); i++) {
-        cmp = eval_order_equal(&ARR_OF(argv[0])[i]->entry_u.var, argv[1]);
+        cmp = eval_order_equal(value_peek_array(argv[0], i, &tmp), argv[1]);
         cmpval = BOOL_OF(cmp);
         value_free(cmp);
         if (cmpval) {
@@ -236,23 +411,33 @@ value *array_search(intend_state *s, unsigned int argc, value **argv)
 /*
  * Merge multiple arrays
  *
- * Returns a new array with the values from all input arrays.
+ * Returns a new array with the values from all input arrays. The
+ * result is a typed array if all input arrays are typed alike.
  */
 value *array_merge(intend_state *s, unsigned int argc, value **argv)
 {
     unsigned int i;
     int j;
-    value *arr;
-
-    arr = value_make_array();
+    array_kind kind = ARRAY_KIND_VALUE;
+    value *arr, tmp;
 
     for (i = 0; i < argc; i++) {
         value_cast_inplace(s, &argv[i], VALUE_TYPE_ARRAY);
+        if (i == 0) {
+            kind = ARRKIND_OF(argv[i]);
+        } else if (ARRKIND_OF(argv[i]) != kind) {
+            kind = ARRAY_KIND_VALUE;
+        }
+    }
+
+    arr = value_make_typed_array(kind);
+
+    for (i = 0; i < argc; i++) {
         for (j = 0; j < ARRLEN_OF(argv[i]); j++) {
-            if (ARR_OF(argv[i])[j]->symbol) {
-                value_add_to_key_array(arr, ARR_OF(arr)[j]->symbol, &ARR_OF(argv[i])[j]->entry_u.var);
+            if (ARRKEY_OF(argv[i], j)) {
+                value_add_to_key_array(arr, ARRKEY_OF(argv[i], j), &ARR_OF(argv[i])[j]);
             } else {
-                value_add_to_array(arr, &ARR_OF(argv[i])[j]->entry_u.var);
+                value_add_to_array(arr, value_peek_array(argv[i], j, &tmp));
             }
         }
     }
@@ -269,14 +454,14 @@ value *array_reverse(intend_state *s, unsigned int argc, value **argv)
 {
     int i;
     int len = ARRLEN_OF(argv[0]);
-    value *arr;
+    value *arr, tmp;
 
-    arr = value_make_array();
+    arr = value_make_typed_array(ARRKIND_OF(argv[0]));
     for (i = 0; i < len; i++) {
-        if (ARR_OF(argv[0])[len - i - 1]->symbol) {
-            value_add_to_key_array(arr, ARR_OF(argv[0])[len - i - 1]->symbol, &ARR_OF(argv[0])[len - i - 1]->entry_u.var);
+        if (ARRKEY_OF(argv[0], len - i - 1)) {
+            value_add_to_key_array(arr, ARRKEY_OF(argv[0], len - i - 1), &ARR_OF(argv[0])[len - i - 1]);
         } else {
-            value_add_to_array(arr, &ARR_OF(argv[0])[len - i - 1]->entry_u.var);
+            value_add_to_array(arr, value_peek_array(argv[0], len - i - 1, &tmp));
         }
     }
     return arr;
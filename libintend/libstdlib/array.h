@@ -40,6 +40,12 @@ void array_init(intend_state *s);
 
 value *array_mkarray(intend_state *s, unsigned int, value **);
 value *array_mkkeyarray(intend_state *s, unsigned int argc, value **argv);
+value *array_mkintarray(intend_state *s, unsigned int argc, value **argv);
+value *array_mkfloatarray(intend_state *s, unsigned int argc, value **argv);
+value *array_int(intend_state *s, unsigned int, value **);
+value *array_float(intend_state *s, unsigned int, value **);
+value *array_plain(intend_state *s, unsigned int, value **);
+value *array_type(intend_state *s, unsigned int, value **);
 value *array_sort(intend_state *s, unsigned int, value **);
 value *array_is_sorted(intend_state *s, unsigned int, value **);
 value *array_unset(intend_state *s, unsigned int, value **);
@@ -98,17 +98,19 @@ value *fn_call_array(intend_state *s, unsigned int argc, value **argv)
 {
     signature *sig = FNSIG_OF(argv[0]);
     int uargc      = ARRLEN_OF(argv[1]);
-    value **uargv;
+    value **uargv, *uargs;
     value *res;
     int i;
 
     symtab_stack_enter(s);
     if (uargc > 0) {
         uargv = oom(calloc(uargc, sizeof(value *)));
+        uargs = oom(calloc(uargc, sizeof(value)));
         for (i = 0; i < uargc; i++) {
-            uargv[i] = &ARR_OF(argv[1])[i]->entry_u.var;
+            uargv[i] = value_peek_array(argv[1], i, &uargs[i]);
         }
         res = call_function(s, sig, uargc, uargv);
+        free(uargs);
         free(uargv);
     } else {
         res = call_function(s, sig, 0, NULL);
@@ -196,14 +198,13 @@ value *fn_map(intend_state *s, unsigned int argc, value **argv)
 {
     signature *sig = FNSIG_OF(argv[0]);
     value *array   = argv[1];
-    symtab_entry **data   = ARR_OF(array);
     int len        = ARRLEN_OF(array);
-    value *res, *elem;
+    value *res, *elem, tmp;
     int i;
 
     res = value_make_array();
     for (i = 0; i < len; i++) {
-        argv[1] = &data[i]->entry_u.var;
+        argv[1] = value_peek_array(array, i, &tmp);
         symtab_stack_enter(s);
         elem = call_function(s, sig, argc - 1, argv + 1);
         symtab_stack_leave(s);
@@ -222,20 +223,19 @@ value *fn_filter(intend_state *s, unsigned int argc, value **argv)
 {
     signature *sig = FNSIG_OF(argv[0]);
     value *array   = argv[1];
-    symtab_entry **data   = ARR_OF(array);
     int len        = ARRLEN_OF(array);
-    value *res, *test;
+    value *res, *test, tmp;
     int i;
 
     res = value_make_array();
     for (i = 0; i < len; i++) {
-        argv[1] = &data[i]->entry_u.var;
+        argv[1] = value_peek_array(array, i, &tmp);
         symtab_stack_enter(s);
         test = call_function(s, sig, argc - 1, argv + 1);
         symtab_stack_leave(s);
         value_cast_inplace(s, &test, VALUE_TYPE_BOOL);
         if (BOOL_OF(test)) {
-            value_add_to_array(res, &data[i]->entry_u.var);
+            value_add_to_array(res, value_peek_array(array, i, &tmp));
         }
         value_free(test);
     }
@@ -252,15 +252,14 @@ value *fn_foldl(intend_state *s, unsigned int argc, value **argv)
     signature *sig = FNSIG_OF(argv[0]);
     value *init    = argv[1];
     value *array   = argv[2];
-    symtab_entry **data   = ARR_OF(array);
     int len        = ARRLEN_OF(array);
     value *temp    = value_copy(init);
-    value *step;
+    value *step, tmp;
     int i;
 
     for (i = 0; i < len; i++) {
         argv[1] = temp;
-        argv[2] = &data[i]->entry_u.var;
+        argv[2] = value_peek_array(array, i, &tmp);
         symtab_stack_enter(s);
         step = call_function(s, sig, argc - 1, argv + 1);
         symtab_stack_leave(s);
@@ -280,15 +279,14 @@ value *fn_foldr(intend_state *s, unsigned int argc, value **argv)
 {
     signature *sig = FNSIG_OF(argv[0]);
     value *array   = argv[1];
-    symtab_entry **data   = ARR_OF(array);
     int len        = ARRLEN_OF(array);
     value *init    = argv[2];
     value *temp    = value_copy(init);
-    value *step;
+    value *step, tmp;
     int i;
 
     for (i = len - 1; i >= 0; i--) {
-        argv[1] = &data[i]->entry_u.var;
+        argv[1] = value_peek_array(array, i, &tmp);
         argv[2] = temp;
         symtab_stack_enter(s);
         step = call_function(s, sig, argc - 1, argv + 1);
@@ -309,14 +307,13 @@ value *fn_take_while(intend_state *s, unsigned int argc, value **argv)
 {
     signature *sig = FNSIG_OF(argv[0]);
     value *array   = argv[1];
-    symtab_entry **data   = ARR_OF(array);
     int len        = ARRLEN_OF(array);
     int i, flag;
-    value *check, *res;
+    value *check, *res, tmp;
 
     res = value_make_array();
     for (i = 0; i < len; i++) {
-        argv[1] = &data[i]->entry_u.var;
+        argv[1] = value_peek_array(array, i, &tmp);
         symtab_stack_enter(s);
         check = call_function(s, sig, argc - 1, argv + 1);
         symtab_stack_leave(s);
@@ -324,7 +321,7 @@ value *fn_take_while(intend_state *s, unsigned int argc, value **argv)
         flag = BOOL_OF(check);
         value_free(check);
         if (flag) {
-            value_add_to_array(res, &data[i]->entry_u.var);
+            value_add_to_array(res, value_peek_array(array, i, &tmp));
         } else {
             break;
         }
@@ -341,13 +338,12 @@ value *fn_drop_while(intend_state *s, unsigned int argc, value **argv)
 {
     signature *sig = FNSIG_OF(argv[0]);
     value *array   = argv[1];
-    symtab_entry **data   = ARR_OF(array);
     int len        = ARRLEN_OF(array);
     int i, flag;
-    value *check, *res;
+    value *check, *res, tmp;
 
     for (i = 0; i < len; i++) {
-        argv[1] = &data[i]->entry_u.var;
+        argv[1] = value_peek_array(array, i, &tmp);
         symtab_stack_enter(s);
         check = call_function(s, sig, argc - 1, argv + 1);
         symtab_stack_leave(s);
@@ -362,7 +358,7 @@ value *fn_drop_while(intend_state *s, unsigned int argc, value **argv)
 
     res = value_make_array();
     for (; i < len; i++) {
-        value_add_to_array(res, &data[i]->entry_u.var);
+        value_add_to_array(res, value_peek_array(array, i, &tmp));
     }
 
     return res;
@@ -391,7 +387,7 @@ value *fn_call_method_array(intend_state *s, unsigned int argc, value **argv)
 {
     signature *sig = FNSIG_OF(argv[0]);
     int     uargc  = ARRLEN_OF(argv[2]);
-    value **uargv;
+    value **uargv, *uargs;
     value *res;
     int i;
 
@@ -399,10 +395,12 @@ value *fn_call_method_array(intend_state *s, unsigned int argc, value **argv)
     symtab_stack_add_variable(s, "this", argv[1]);
     if (uargc > 0) {
         uargv = oom(calloc(uargc, sizeof(value *)));
+        uargs = oom(calloc(uargc, sizeof(value)));
         for (i = 0; i < uargc; i++) {
-            uargv[i] = &ARR_OF(argv[2])[i]->entry_u.var;
+            uargv[i] = value_peek_array(argv[2], i, &uargs[i]);
         }
         res = call_function(s, sig, uargc, uargv);
+        free(uargs);
         free(uargv);
     } else {
         res = call_function(s, sig, 0, NULL);
@@ -69,6 +69,7 @@ static register_func_data rt_funcs[] = {
     { "global",			rt_global,		0,	"",		'v'	},
     { "cast_to",		rt_cast_to,		2,	"?s",	'?'	},
     { "versions",		rt_versions,	0,	"",		'c'	},
+    { "value_allocs",	rt_value_allocs,	0,	"",		'i'	},
     { "exit",			rt_exit,		1,	"i",	'v'	},
 
     /* list terminator */
@@ -622,6 +623,14 @@ value *rt_versions(intend_state *s, unsigned int argc, value **argv)
     return res;
 }
 
+/*
+ * Get number of values allocated by the context
+ */
+value *rt_value_allocs(intend_state *s, unsigned int argc, value **argv)
+{
+    return value_make_int((int) s->value_allocs);
+}
+
 /*
  * Terminate program
  *
@@ -64,6 +64,7 @@ value *rt_assert(intend_state *s, unsigned int, value **);
 value *rt_global(intend_state *s, unsigned int, value **);
 value *rt_cast_to(intend_state *s, unsigned int, value **);
 value *rt_versions(intend_state *s, unsigned int, value **);
+value *rt_value_allocs(intend_state *s, unsigned int, value **);
 value *rt_exit(intend_state *s, unsigned int, value **);
 
 #endif
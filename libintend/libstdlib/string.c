@@ -77,6 +77,10 @@ static register_func_data str_funcs[] = {
     { "ltrim",		str_ltrim,		1,	"S",	's'	},
     { "rtrim",		str_rtrim,		1,	"S",	's'	},
     { "trim",		str_trim,		1,	"S",	's'	},
+    { "strbuf",		str_buf,		0,	"",		'r'	},
+    { "strbuf_add",	str_buf_add,	1,	"r*",	'?'	},
+    { "strbuf_get",	str_buf_get,	1,	"r",	'?'	},
+    { "strbuf_len",	str_buf_len,	1,	"r",	'?'	},
 
     /* list terminator */
     { NULL,			NULL,			0,	NULL,	0	}
@@ -837,10 +841,9 @@ value *str_explode(intend_state *s, unsigned int argc, value **argv)
 value *str_implode(intend_state *s, unsigned int argc, value **argv)
 {
     int max = ARRLEN_OF(argv[0]);
-    int i, len, curr = 0;
+    int i;
     char *sep   = NULL;
     int   slen  = 0;
-    char *buf = NULL;
     value *res, *elem;
 
     // Check if we received a separator
@@ -855,42 +858,22 @@ value *str_implode(intend_state *s, unsigned int argc, value **argv)
     }
 
     // Implode the array using sep as separator
+    res = value_make_string(NULL);
     for (i = 0; i < max; i++) {
         // Get temporary element and cast it to string
         elem = value_get_array(argv[0], i);
         value_cast_inplace(s, &elem, VALUE_TYPE_STRING);
 
-        // Get the len of element
-        len = STRLEN_OF(elem);
-
-        // Is this the first element
-        if (!buf) {
-            // Allocate space
-            curr += len;
-            buf = oom(malloc(curr + 1));
-            buf[0] = 0;
-        } else {
-            // Allocate more space and add separator
-            curr += slen + len;
-            buf = oom(realloc(buf, curr + 1));
-            strcat(buf, sep);
-        }
-
-        // If element not empty add it to buffer
-        if (len > 0) {
-            strcat(buf, STR_OF(elem));
+        // Append separator and element to the result
+        if (i > 0) {
+            value_append_string(res, sep, slen);
         }
+        value_append_string(res, STR_OF(elem), STRLEN_OF(elem));
 
         // Free the temporary element
         value_free(elem);
     }
 
-    // Create result string value
-    res = value_make_string(buf);
-
-    // Free the buffer
-    free(buf);
-
     // Return the result string
     return res;
 }
@@ -945,3 +928,92 @@ value *str_trim(intend_state *s, unsigned int argc, value **argv)
     while (len > 1 && isspace(*(str + len - 1))) --len;
     return value_make_memstring(str, len);
 }
+
+/*
+ * Release string builder
+ */
+static void strbuf_release(void *data)
+{
+    value_free(data);
+}
+
+/*
+ * Get contents of string builder
+ */
+static void *strbuf_data(void *data)
+{
+    return STR_OF((value *) data);
+}
+
+/*
+ * Get string of string builder resource
+ *
+ * Returns NULL if the resource is not a string builder.
+ */
+static value *strbuf_of(value *res)
+{
+    if (RESRELEASE_OF(res) != strbuf_release) {
+        return NULL;
+    }
+    return RES_OF(res);
+}
+
+/*
+ * Create string builder
+ *
+ * A string builder is a resource holding a string that grows in
+ * place as more is appended to it.
+ */
+value *str_buf(intend_state *s, unsigned int argc, value **argv)
+{
+    return value_make_resource(value_make_string(NULL), strbuf_release,
+                               strbuf_data);
+}
+
+/*
+ * Append to string builder
+ *
+ * Appends the string forms of all further arguments. Returns the
+ * new length of the built string.
+ */
+value *str_buf_add(intend_state *s, unsigned int argc, value **argv)
+{
+    value *str = strbuf_of(argv[0]);
+    unsigned int i;
+
+    if (!str) {
+        return value_make_void();
+    }
+
+    for (i = 1; i < argc; i++) {
+        value_cast_inplace(s, &argv[i], VALUE_TYPE_STRING);
+        value_append_string(str, STR_OF(argv[i]), STRLEN_OF(argv[i]));
+    }
+    return value_make_int(STRLEN_OF(str));
+}
+
+/*
+ * Get built string
+ */
+value *str_buf_get(intend_state *s, unsigned int argc, value **argv)
+{
+    value *str = strbuf_of(argv[0]);
+
+    if (!str) {
+        return value_make_void();
+    }
+    return value_copy(str);
+}
+
+/*
+ * Get length of built string
+ */
+value *str_buf_len(intend_state *s, unsigned int argc, value **argv)
+{
+    value *str = strbuf_of(argv[0]);
+
+    if (!str) {
+        return value_make_void();
+    }
+    return value_make_int(STRLEN_OF(str));
+}
@@ -71,5 +71,9 @@ value *str_implode(intend_state *s, unsigned int argc, value **argv);
 value *str_ltrim(intend_state *s, unsigned int argc, value **argv);
 value *str_rtrim(intend_state *s, unsigned int argc, value **argv);
 value *str_trim(intend_state *s, unsigned int argc, value **argv);
+value *str_buf(intend_state *s, unsigned int argc, value **argv);
+value *str_buf_add(intend_state *s, unsigned int argc, value **argv);
+value *str_buf_get(intend_state *s, unsigned int argc, value **argv);
+value *str_buf_len(intend_state *s, unsigned int argc, value **argv);
 
 #endif
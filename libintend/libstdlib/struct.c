@@ -98,11 +98,13 @@ value *struct_mkstruct(intend_state *s, unsigned int argc, value **argv)
 value *struct_unset(intend_state *s, unsigned int argc, value **argv)
 {
     char *field = STR_OF(argv[1]);
+    value *res;
 
+    res = value_copy(argv[0]);
     if (field) {
-        value_delete_struct(argv[0], field);
+        value_delete_struct(res, field);
     }
-    return value_copy(argv[0]);
+    return res;
 }
 
 /*
@@ -124,11 +126,13 @@ value *struct_get(intend_state *s, unsigned int argc, value **argv)
 value *struct_set(intend_state *s, unsigned int argc, value **argv)
 {
     char *field = STR_OF(argv[1]);
+    value *res;
 
+    res = value_copy(argv[0]);
     if (field) {
-        value_set_struct(argv[0], field, argv[2]);
+        value_set_struct(res, field, argv[2]);
     }
-    return value_copy(argv[0]);
+    return res;
 }
 
 /*
@@ -137,24 +141,17 @@ value *struct_set(intend_state *s, unsigned int argc, value **argv)
 static value *getelements(value *val, unsigned int wanted)
 {
     symtab *sym = val->value_u.struct_val;
-    symtab_node *node;
     symtab_entry *entry;
     value *name, *arr;
-    unsigned int i, j;
+    unsigned int node = 0, pos = 0;
 
     arr = value_make_array();
 
-    for (i = 0; i < (unsigned int)(1 << sym->order); i++) {
-        node = sym->nodes[i];
-        if (node) {
-            for (j = 0; j < node->len; j++) {
-                entry = &node->entries[j];
-                if (entry && entry->type == wanted) {
-                    name = value_make_string(entry->symbol);
-                    value_add_to_array(arr, name);
-                    value_free(name);
-                }
-            }
+    while ((entry = symtab_next(sym, &node, &pos))) {
+        if (entry->type == wanted) {
+            name = value_make_string(entry->symbol);
+            value_add_to_array(arr, name);
+            value_free(name);
         }
     }
     return arr;
@@ -227,9 +224,8 @@ value *struct_is_method(intend_state *s, unsigned int argc, value **argv)
 value *struct_merge(intend_state *s, unsigned int argc, value **argv)
 {
     symtab *sym;
-    symtab_node *node;
     symtab_entry *entry;
-    unsigned int i, si, sj;
+    unsigned int i, node, pos;
     value *st;
 
     st = value_make_struct();
@@ -237,19 +233,14 @@ value *struct_merge(intend_state *s, unsigned int argc, value **argv)
     for (i = 0; i < argc; i++) {
         value_cast_inplace(s, &argv[i], VALUE_TYPE_STRUCT);
         sym = argv[i]->value_u.struct_val;
-        for (si = 0; si < (unsigned int)(1 << sym->order); si++) {
-            node = sym->nodes[si];
-            if (node) {
-                for (sj = 0; sj < node->len; sj++) {
-                    entry = &node->entries[sj];
-                    if (entry && entry->type == SYMTAB_ENTRY_VAR) {
-                        value_set_struct(st, entry->symbol, &entry->entry_u.var);
-                    }
-                    if (entry && entry->type == SYMTAB_ENTRY_FUNCTION) {
-                        symtab_add_function(st->value_u.struct_val, entry->symbol,
-                                            &(entry->entry_u.fnc.sigs[0]));
-                    }
-                }
+        node = pos = 0;
+        while ((entry = symtab_next(sym, &node, &pos))) {
+            if (entry->type == SYMTAB_ENTRY_VAR) {
+                value_set_struct(st, entry->symbol, &entry->entry_u.var);
+            }
+            if (entry->type == SYMTAB_ENTRY_FUNCTION) {
+                symtab_add_function(st->value_u.struct_val, entry->symbol,
+                                    &(entry->entry_u.fnc.sigs[0]));
             }
         }
     }
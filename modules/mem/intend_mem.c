@@ -53,6 +53,7 @@ static intend_function_data mem_funcs[] = {
     { "cnull",              mem_cnull,          0,  "",     'r' },
     { "is_null",            mem_is_null,        1,  "r",    'b' },
     { "cstring",            mem_cstring,        1,  "S",    '?' },
+    { "marray",             mem_array,          1,  "a",    '?' },
     { "mputchar",           mem_put_char,       3,  "rii",  'b' },
     { "mputshort",          mem_put_short,      3,  "rii",  'b' },
     { "mputint",            mem_put_int,        3,  "rii",  'b' },
@@ -104,21 +105,28 @@ static memblock *mem_init(int size, void *data)
     memblock *mem;
 
     mem = intend_oom(malloc(sizeof(memblock)));
-    mem->size = size;
-    mem->data = data;
-    mem->rw   = 1;
+    mem->size  = size;
+    mem->data  = data;
+    mem->rw    = 1;
+    mem->owner = NULL;
 
     return mem;
 }
 
 /*
  * Clean up memory block structure
+ *
+ * Memory of typed arrays is released with the array.
  */
 static void mem_cleanup(void *data)
 {
     memblock *mem = data;
 
-    if (mem) free(mem->data);
+    if (mem && mem->owner) {
+        intend_free_value(mem->owner);
+    } else if (mem) {
+        free(mem->data);
+    }
     free(mem);
 }
 
@@ -205,7 +213,7 @@ intend_value mem_realloc(intend_ctx ctx, unsigned int argc, intend_value *argv)
     void *data;
     int res = 0;
 
-    if (!is_mem(argv[0]) || !mem || size < 0) {
+    if (!is_mem(argv[0]) || !mem || mem->owner || size < 0) {
         return intend_create_value(INTEND_TYPE_BOOL, &res);
     }
 
@@ -279,6 +287,33 @@ intend_value mem_cstring(intend_ctx ctx, unsigned int argc, intend_value *argv)
     return res;
 }
 
+/*
+ * Create read-only resource from typed array
+ *
+ * The resource shares the raw elements of the array and holds a
+ * copy of the array, so the elements stay unchanged while the
+ * resource exists.
+ */
+intend_value mem_array(intend_ctx ctx, unsigned int argc, intend_value *argv)
+{
+    memblock *mem;
+    void *data;
+    int size;
+    intend_value res;
+
+    data = intend_array_data(argv[0], &size);
+    if (!data) {
+        return intend_create_value(INTEND_TYPE_VOID, NULL);
+    }
+
+    mem = mem_init(size, data);
+    mem->rw = 0;
+    mem->owner = intend_copy_value(argv[0]);
+
+    res = intend_create_value(INTEND_TYPE_RES, mem, mem_cleanup, mem_get);
+    return res;
+}
+
 /*
  * Put character at offset in memory resource
  */
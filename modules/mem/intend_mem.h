@@ -40,9 +40,10 @@
  * Private wrapper structure for allocated memory
  */
 typedef struct {
-    int     size;
-    int     rw;
-    void    *data;
+    int             size;
+    int             rw;
+    void            *data;
+    intend_value    owner;  /* typed array holding data, or NULL */
 } memblock;
 
 /*
@@ -95,6 +96,11 @@ intend_value mem_is_null(intend_ctx ctx, unsigned int argc, intend_value *argv);
  */
 intend_value mem_cstring(intend_ctx ctx, unsigned int argc, intend_value *argv);
 
+/*
+ * Create read-only resource from typed array
+ */
+intend_value mem_array(intend_ctx ctx, unsigned int argc, intend_value *argv);
+
 /*
  * Put character at offset in memory resource
  */
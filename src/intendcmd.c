@@ -42,18 +42,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include <intend.h>
 
-#define MODE_NORMAL 0x0
-#define MODE_CHECK  0x1
-#define MODE_DUMP   0x2
+#define MODE_NORMAL     0x0
+#define MODE_CHECK      0x1
+#define MODE_DUMP       0x2
+#define MODE_COMPARE    0x3
 
 /*
  * Interpreter mode
  */
 static int mode = MODE_NORMAL;
 
+/*
+ * Print statistics after execution
+ */
+static int stats = 0;
+
 /*
  * First input file and position in command line
  */
@@ -77,11 +86,16 @@ static void usage(char *name)
            "\t-c, --check\t\t\tsyntax check only\n"
            "\t-d, --dump\t\t\tparse script and dump parse tree\n"
            "\t-s, --safe\t\t\trun script in safe mode\n"
+           "\t-e, --engine <engine>\t\tevaluation engine to use, `vm' (default) or `tree'\n"
+           "\t-C, --compare\t\t\trun script on both engines and compare the results\n"
+           "\t-t, --stats\t\t\tprint inline cache statistics to stderr after execution\n"
            "\t-p, --path-ro <name> <path>\tuse a read-only named <name> sandbox in <path> (multiple)\n"
            "\t-P, --path-rw <name> <path>\tuse a read-write named <name> sandbox in <path> (multiple)\n"
            "\t-l, --load-module <module>\tpre-load intend module <module> (multiple)\n"
            "\n"
            "The script is not executed when -c or -d are in effect.\n"
+           "With -C, the script runs twice with the same input and\n"
+           "the exit status is 3 if output or status differ.\n"
            "You can use the special option -- to terminate option\n"
            "processing; the next argument will then be used as the\n"
            "name of the script to execute.\n"
@@ -114,6 +128,23 @@ static void options(intend_ctx ctx, int argc, char **argv)
             } else if (strcmp(opt, "-s") == 0 || strcmp(opt, "--safe") == 0) {
                 intend_safe_mode_set(ctx, INTEND_SAFE_MODE_ON);
                 continue;
+            } else if (strcmp(opt, "-e") == 0 || strcmp(opt, "--engine") == 0) {
+                if (argv[i + 1] && strcmp(argv[i + 1], "vm") == 0) {
+                    intend_engine_set(ctx, INTEND_ENGINE_VM);
+                } else if (argv[i + 1] && strcmp(argv[i + 1], "tree") == 0) {
+                    intend_engine_set(ctx, INTEND_ENGINE_TREE);
+                } else {
+                    fprintf(stderr, "intend: -e,--engine need `vm' or `tree' as argument\n");
+                    exit(1);
+                }
+                i++;
+                continue;
+            } else if (strcmp(opt, "-C") == 0 || strcmp(opt, "--compare") == 0) {
+                mode = MODE_COMPARE;
+                continue;
+            } else if (strcmp(opt, "-t") == 0 || strcmp(opt, "--stats") == 0) {
+                stats = 1;
+                continue;
             } else if (strcmp(opt, "-p") == 0 || strcmp(opt, "--path-ro") == 0) {
                 if (argv[i + 1] && argv[i + 2]) {
                     intend_sandbox_add(ctx, argv[i + 1], argv[i + 2], INTEND_SANDBOX_RO);
@@ -157,6 +188,140 @@ static void options(intend_ctx ctx, int argc, char **argv)
     }
 }
 
+/*
+ * Result of a script run in compare mode
+ */
+typedef struct {
+    int     status;
+    char    *out;
+    long    outlen;
+    char    *err;
+    long    errlen;
+} run_result;
+
+/*
+ * Read the contents of a temporary file
+ */
+static char *slurp(FILE *file, long *len)
+{
+    char *buf;
+
+    fflush(file);
+    fseek(file, 0, SEEK_END);
+    *len = ftell(file);
+    rewind(file);
+
+    buf = malloc(*len + 1);
+    if (!buf) {
+        fprintf(stderr, "intend: out of memory\n");
+        exit(1);
+    }
+    if (fread(buf, 1, *len, file) != (size_t) *len) {
+        *len = 0;
+    }
+    buf[*len] = 0;
+    return buf;
+}
+
+/*
+ * Run the parsed script with the given engine in a child process,
+ * capturing its output streams
+ */
+static void run_engine(int engine, FILE *in, run_result *res)
+{
+    FILE *out, *err;
+    pid_t pid;
+    int status;
+
+    out = tmpfile();
+    err = tmpfile();
+    if (!out || !err) {
+        fprintf(stderr, "intend: could not create temporary files\n");
+        exit(1);
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "intend: could not fork\n");
+        exit(1);
+    } else if (pid == 0) {
+        if (in) {
+            rewind(in);
+            dup2(fileno(in), STDIN_FILENO);
+        }
+        dup2(fileno(out), STDOUT_FILENO);
+        dup2(fileno(err), STDERR_FILENO);
+        intend_engine_set(context, engine);
+        status = intend_execute_script(context);
+        exit((status >= 0) ? status : 1);
+    }
+
+    waitpid(pid, &status, 0);
+    res->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    res->out = slurp(out, &res->outlen);
+    res->err = slurp(err, &res->errlen);
+    fclose(out);
+    fclose(err);
+}
+
+/*
+ * Compare mode
+ *
+ * Runs the script on the tree-walking evaluator and on the bytecode
+ * engine, replays the output of the bytecode run and reports any
+ * difference in output or exit status. Standard input is buffered
+ * so that both runs read the same data.
+ */
+static int compare(void)
+{
+    run_result tree, vm;
+    FILE *in = NULL;
+    char buf[4096];
+    size_t len;
+    int status;
+
+    if (!isatty(STDIN_FILENO)) {
+        in = tmpfile();
+        if (!in) {
+            fprintf(stderr, "intend: could not create temporary files\n");
+            exit(1);
+        }
+        while ((len = fread(buf, 1, sizeof(buf), stdin)) > 0) {
+            fwrite(buf, 1, len, in);
+        }
+        fflush(in);
+    }
+
+    run_engine(INTEND_ENGINE_TREE, in, &tree);
+    run_engine(INTEND_ENGINE_VM, in, &vm);
+    if (in) fclose(in);
+
+    fwrite(vm.out, 1, vm.outlen, stdout);
+    fwrite(vm.err, 1, vm.errlen, stderr);
+
+    status = vm.status;
+    if (tree.status != vm.status) {
+        fprintf(stderr, "intend: engines differ in exit status (tree %i, vm %i)\n",
+                tree.status, vm.status);
+        status = 3;
+    }
+    if (tree.outlen != vm.outlen || memcmp(tree.out, vm.out, vm.outlen) != 0) {
+        fprintf(stderr, "intend: engines differ in standard output\n");
+        status = 3;
+    }
+    if (tree.errlen != vm.errlen || memcmp(tree.err, vm.err, vm.errlen) != 0) {
+        fprintf(stderr, "intend: engines differ in standard error\n");
+        status = 3;
+    }
+
+    free(tree.out);
+    free(tree.err);
+    free(vm.out);
+    free(vm.err);
+
+    return status;
+}
+
 /*
  * Memory cleanup at interpreter exit
  */
@@ -205,6 +370,15 @@ int main(int argc, char **argv)
     /* Execute script or dump it */
     if (mode == MODE_NORMAL) {
         status = intend_execute_script(context);
+        if (stats) {
+            unsigned long hits, misses;
+
+            intend_cache_stats(context, &hits, &misses);
+            fprintf(stderr, "intend: inline caches: %lu hits, %lu misses\n",
+                    hits, misses);
+        }
+    } else if (mode == MODE_COMPARE) {
+        return compare();
     } else if (mode == MODE_DUMP) {
         intend_dump_script(context);
     }
@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Run the engine regression scripts
+#
+# Every script in data/engine is run with `intend -C', which evaluates
+# it on the tree engine and on the VM and fails when the two disagree.
+# The output of the run, followed by its exit status, must match the
+# .out file next to the script. A script with a `# ulimit: <options>'
+# line is run with those resource limits, see ulimit in sh(1).
+#
+# When intend lives in a build tree, the library and the modules are
+# taken from that tree, so the scripts run before `make install'.
+#
+# usage: engine.sh path/to/intend [script...]
+#
+
+intend=$1
+shift
+case $intend in
+    /*) ;;
+    *) intend=`pwd`/$intend ;;
+esac
+
+top=`dirname $intend`/..
+if [ -d $top/modules ]; then
+    for dir in $top/libintend/.libs $top/modules/*/.libs; do
+        LD_LIBRARY_PATH=$dir${LD_LIBRARY_PATH:+:$LD_LIBRARY_PATH}
+    done
+    export LD_LIBRARY_PATH
+fi
+
+cd `dirname $0`/data/engine || exit 1
+
+if [ $# = 0 ]; then
+    set -- `ls | grep -v '\.out$'`
+fi
+
+pass=0
+fail=0
+for t in "$@"; do
+    limit=`sed -n 's/^# ulimit: //p' $t`
+    out=`test -z "$limit" || ulimit $limit; $intend -C $t 2>&1 < /dev/null; echo "exit $?"`
+    if [ "$out" = "`cat $t.out 2>/dev/null`" ]; then
+        pass=`expr $pass + 1`
+    else
+        fail=`expr $fail + 1`
+        echo "FAIL: $t"
+        echo "$out" | diff $t.out - | sed 's/^/    /'
+    fi
+done
+
+echo "engine: $pass passed, $fail failed"
+test $fail = 0